@@ -0,0 +1,93 @@
+#pragma once
+
+#include <charconv>
+#include <chrono>
+#include <ostream>
+#include <iomanip>
+#include <string>
+#include <system_error>
+#include <utility>
+
+namespace bench
+{
+
+struct Result
+{
+    std::string Name{};
+    size_t Rows{};
+    size_t Bytes{};
+    size_t Iterations{};
+    double Seconds{};
+};
+
+/**
+ * Run fn repeatedly until at least min_seconds have elapsed (and at least
+ * once), timing every iteration. Each iteration processes rows and bytes.
+ */
+template <typename Function>
+auto Measure(std::string name, size_t rows, size_t bytes, Function fn,
+    double min_seconds = 0.25) -> Result
+{
+    using Clock = std::chrono::steady_clock;
+    Result result{std::move(name), rows, bytes, 0, 0.0};
+    const auto start = Clock::now();
+    do {
+        fn();
+        result.Iterations += 1;
+        result.Seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    } while (result.Seconds < min_seconds);
+    return result;
+}
+
+inline void Report(std::ostream& ostr, const Result& result)
+{
+    const double per_iteration = result.Seconds / result.Iterations;
+    const double rows_per_s = result.Rows / per_iteration;
+    const double bytes_per_s = result.Bytes / per_iteration;
+
+    const auto old_flags = ostr.flags();
+    ostr << std::left << std::setw(40) << result.Name << std::right
+        << std::fixed << std::setprecision(3)
+        << std::setw(12) << per_iteration * 1e3 << " ms"
+        << std::setw(14) << std::setprecision(0) << rows_per_s << " rows/s"
+        << std::setw(10) << std::setprecision(1) << bytes_per_s / (1 << 20) << " MiB/s"
+        << "  (" << result.Iterations << " iter)" << std::endl;
+    ostr.flags(old_flags);
+}
+
+/**
+ * Discards everything written to a stream for as long as it is in scope,
+ * so that diagnostics printed by the stages under test are not measured.
+ */
+class ScopedSilence
+{
+public:
+    explicit ScopedSilence(std::ostream& ostr)
+        : m_Stream{ostr}
+        , m_Buffer{ostr.rdbuf(nullptr)}
+    {
+    }
+    ~ScopedSilence()
+    {
+        m_Stream.rdbuf(m_Buffer);
+        m_Stream.clear();
+    }
+
+private:
+    std::ostream& m_Stream;
+    std::streambuf* m_Buffer;
+};
+
+/**
+ * Parse the whole of a command line value as a number, false if it is not
+ * one.
+ */
+template <typename _Tp>
+auto ParseNumber(const std::string& str, _Tp& value) -> bool
+{
+    const char* end = str.data() + str.size();
+    const auto [ptr, ec] = std::from_chars(str.data(), end, value);
+    return ec == std::errc{} && ptr == end && !str.empty();
+}
+
+} // namespace bench
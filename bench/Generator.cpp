@@ -0,0 +1,273 @@
+#include "Generator.h"
+
+#include <sstream>
+#include <vector>
+#include <cctype>
+
+/******************************************************************************/
+/* Export layouts *************************************************************/
+namespace
+{
+    enum class Slot { Empty, FirstName, LastName, DisplayName, Email1, Email2,
+        Mobile, Home, Work, Normal, False, Unspecified, Type1, Type2 };
+
+    struct Column
+    {
+        const char* Name;
+        Slot Value;
+    };
+
+    const std::vector<Column> OutlookColumns {
+        {"Title", Slot::Empty}, {"First Name", Slot::FirstName},
+        {"Middle Name", Slot::Empty}, {"Last Name", Slot::LastName},
+        {"Suffix", Slot::Empty}, {"Company", Slot::Empty},
+        {"Department", Slot::Empty}, {"Job Title", Slot::Empty},
+        {"Business Street", Slot::Empty}, {"Business Street 2", Slot::Empty},
+        {"Business Street 3", Slot::Empty}, {"Business City", Slot::Empty},
+        {"Business State", Slot::Empty}, {"Business Postal Code", Slot::Empty},
+        {"Business Country/Region", Slot::Empty}, {"Home Street", Slot::Empty},
+        {"Home Street 2", Slot::Empty}, {"Home Street 3", Slot::Empty},
+        {"Home City", Slot::Empty}, {"Home State", Slot::Empty},
+        {"Home Postal Code", Slot::Empty}, {"Home Country/Region", Slot::Empty},
+        {"Other Street", Slot::Empty}, {"Other Street 2", Slot::Empty},
+        {"Other Street 3", Slot::Empty}, {"Other City", Slot::Empty},
+        {"Other State", Slot::Empty}, {"Other Postal Code", Slot::Empty},
+        {"Other Country/Region", Slot::Empty}, {"Assistant's Phone", Slot::Empty},
+        {"Business Fax", Slot::Empty}, {"Business Phone", Slot::Work},
+        {"Business Phone 2", Slot::Empty}, {"Callback", Slot::Empty},
+        {"Car Phone", Slot::Empty}, {"Company Main Phone", Slot::Empty},
+        {"Home Fax", Slot::Empty}, {"Home Phone", Slot::Home},
+        {"Home Phone 2", Slot::Empty}, {"ISDN", Slot::Empty},
+        {"Mobile Phone", Slot::Mobile}, {"Other Fax", Slot::Empty},
+        {"Other Phone", Slot::Empty}, {"Pager", Slot::Empty},
+        {"Primary Phone", Slot::Empty}, {"Radio Phone", Slot::Empty},
+        {"TTY/TDD Phone", Slot::Empty}, {"Telex", Slot::Empty},
+        {"Account", Slot::Empty}, {"Anniversary", Slot::Empty},
+        {"Assistant's Name", Slot::Empty}, {"Billing Information", Slot::Empty},
+        {"Birthday", Slot::Empty}, {"Business Address PO Box", Slot::Empty},
+        {"Categories", Slot::Empty}, {"Children", Slot::Empty},
+        {"Directory Server", Slot::Empty}, {"E-mail Address", Slot::Email1},
+        {"E-mail Type", Slot::Type1}, {"E-mail Display Name", Slot::DisplayName},
+        {"E-mail 2 Address", Slot::Email2}, {"E-mail 2 Type", Slot::Type2},
+        {"E-mail 2 Display Name", Slot::Empty}, {"E-mail 3 Address", Slot::Empty},
+        {"E-mail 3 Type", Slot::Empty}, {"E-mail 3 Display Name", Slot::Empty},
+        {"Gender", Slot::Unspecified}, {"Government ID Number", Slot::Empty},
+        {"Hobby", Slot::Empty}, {"Home Address PO Box", Slot::Empty},
+        {"Initials", Slot::Empty}, {"Internet Free Busy", Slot::Empty},
+        {"Keywords", Slot::Empty}, {"Language", Slot::Empty},
+        {"Location", Slot::Empty}, {"Manager's Name", Slot::Empty},
+        {"Mileage", Slot::Empty}, {"Notes", Slot::Empty},
+        {"Office Location", Slot::Empty}, {"Organizational ID Number", Slot::Empty},
+        {"Other Address PO Box", Slot::Empty}, {"Priority", Slot::Normal},
+        {"Private", Slot::False}, {"Profession", Slot::Empty},
+        {"Referred By", Slot::Empty}, {"Sensitivity", Slot::Normal},
+        {"Spouse", Slot::Empty}, {"User 1", Slot::Empty},
+        {"User 2", Slot::Empty}, {"User 3", Slot::Empty},
+        {"User 4", Slot::Empty}, {"Web Page", Slot::Empty},
+    };
+
+    const std::vector<Column> GoogleColumns {
+        {"Name", Slot::DisplayName}, {"Given Name", Slot::FirstName},
+        {"Additional Name", Slot::Empty}, {"Family Name", Slot::LastName},
+        {"Yomi Name", Slot::Empty}, {"Given Name Yomi", Slot::Empty},
+        {"Additional Name Yomi", Slot::Empty}, {"Family Name Yomi", Slot::Empty},
+        {"Name Prefix", Slot::Empty}, {"Name Suffix", Slot::Empty},
+        {"Initials", Slot::Empty}, {"Nickname", Slot::Empty},
+        {"Short Name", Slot::Empty}, {"Maiden Name", Slot::Empty},
+        {"Birthday", Slot::Empty}, {"Gender", Slot::Empty},
+        {"Location", Slot::Empty}, {"Billing Information", Slot::Empty},
+        {"Directory Server", Slot::Empty}, {"Mileage", Slot::Empty},
+        {"Occupation", Slot::Empty}, {"Hobby", Slot::Empty},
+        {"Sensitivity", Slot::Empty}, {"Priority", Slot::Empty},
+        {"Subject", Slot::Empty}, {"Notes", Slot::Empty},
+        {"Language", Slot::Empty}, {"Photo", Slot::Empty},
+        {"Group Membership", Slot::Empty}, {"E-mail 1 - Type", Slot::Type1},
+        {"E-mail 1 - Value", Slot::Email1}, {"E-mail 2 - Type", Slot::Type2},
+        {"E-mail 2 - Value", Slot::Email2}, {"Mobile Phone Number", Slot::Mobile},
+        {"Home Phone Number", Slot::Home}, {"Work Phone Number", Slot::Work},
+        {"Address 1 - Type", Slot::Empty}, {"Address 1 - Formatted", Slot::Empty},
+        {"Address 1 - Street", Slot::Empty}, {"Address 1 - City", Slot::Empty},
+        {"Address 1 - PO Box", Slot::Empty}, {"Address 1 - Region", Slot::Empty},
+        {"Address 1 - Postal Code", Slot::Empty}, {"Address 1 - Country", Slot::Empty},
+        {"Organization 1 - Type", Slot::Empty}, {"Organization 1 - Name", Slot::Empty},
+        {"Organization 1 - Title", Slot::Empty}, {"Website 1 - Type", Slot::Empty},
+        {"Website 1 - Value", Slot::Empty},
+    };
+
+    auto columns_for(bench::ContactGenerator::Style style) -> const std::vector<Column>&
+    {
+        return (style == bench::ContactGenerator::Style::Google) ? GoogleColumns : OutlookColumns;
+    }
+
+    const char* const AsciiFirstNames[] = {
+        "james", "mary", "robert", "patricia", "john", "jennifer", "michael",
+        "linda", "david", "elizabeth", "william", "barbara", "richard", "susan",
+        "joseph", "jessica", "thomas", "sarah", "charles", "karen", "olivia",
+        "noah", "amelia", "jack", "charlotte", "oliver", "isla", "leo", "mia" };
+    const char* const AsciiLastNames[] = {
+        "smith", "johnson", "williams", "brown", "jones", "garcia", "miller",
+        "davis", "rodriguez", "martinez", "hernandez", "lopez", "gonzalez",
+        "wilson", "anderson", "thomas", "taylor", "moore", "jackson", "martin",
+        "lee", "thompson", "white", "harris", "clark", "lewis", "walker" };
+    const char* const UnicodeFirstNames[] = {
+        "Zoë", "José", "François", "Björn", "Søren", "Łukasz", "Ægir", "Chloé",
+        "Дмитрий", "Αλέξανδρος", "Мария", "陽翔", "さくら", "지민", "Nguyễn" };
+    const char* const UnicodeLastNames[] = {
+        "Müller", "Åström", "Ó Briain", "Núñez", "Dvořák", "Kowalczyk", "Øster",
+        "Иванов", "Παπαδόπουλος", "山田", "佐藤", "김", "Trần", "Çelik" };
+    const char* const Domains[] = {
+        "gmail.com", "outlook.com", "yahoo.com", "hotmail.com", "icloud.com",
+        "example.org", "mail.example.com", "corp.example.net", "uni.example.edu" };
+    const char* const CallingCodes[] = { "+61", "+1", "+44", "+49", "+353", "+64", "" };
+}
+/******************************************************************************/
+
+/******************************************************************************/
+/* ContactGenerator ***********************************************************/
+bench::ContactGenerator::ContactGenerator(const Options& options)
+    : m_Options{options}
+    , m_State{options.Seed}
+{
+}
+
+auto bench::ContactGenerator::next() -> uint64_t
+{
+    // splitmix64
+    uint64_t z = (m_State += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+auto bench::ContactGenerator::chance(double probability) -> bool
+{
+    return (next() >> 11) * 0x1.0p-53 < probability;
+}
+
+template <typename _Tp, size_t N>
+auto bench::ContactGenerator::pick(const _Tp (&items)[N]) -> const _Tp&
+{
+    return items[next() % N];
+}
+
+auto bench::ContactGenerator::make_phone(bool mobile) -> std::string
+{
+    std::string phone = pick(CallingCodes);
+    phone += phone.empty() ? (mobile ? "04" : "02") : (mobile ? "4" : "2");
+    for (int i = 0; i < 8; ++i) {
+        phone.push_back(static_cast<char>('0' + next() % 10));
+    }
+    return phone;
+}
+
+auto bench::ContactGenerator::make_person(uint64_t id) -> Person
+{
+    Person person;
+    const bool unicode = chance(m_Options.UnicodeRate);
+    person.FirstName = unicode ? pick(UnicodeFirstNames) : pick(AsciiFirstNames);
+    person.LastName = unicode ? pick(UnicodeLastNames) : pick(AsciiLastNames);
+
+    const std::string local = std::string{pick(AsciiFirstNames)} + "."
+        + pick(AsciiLastNames) + std::to_string(id);
+    person.Email1 = local + "@" + pick(Domains);
+    if (chance(0.3)) person.Email2 = local + ".alt@" + pick(Domains);
+    if (chance(0.8)) person.Mobile = make_phone(true);
+    if (chance(0.3)) person.Home = make_phone(false);
+    if (chance(0.2)) person.Work = make_phone(false);
+    return person;
+}
+
+auto bench::ContactGenerator::field(const std::string& value) -> std::string
+{
+    const bool needs_quotes = value.find_first_of(",\"\n") != std::string::npos;
+    if (!needs_quotes && (value.empty() || !chance(m_Options.QuoteRate))) return value;
+
+    std::string quoted = "\"";
+    for (char c : value) {
+        if (c == '"') quoted.push_back('"');
+        quoted.push_back(c);
+    }
+    return quoted += '"';
+}
+
+void bench::ContactGenerator::write_header(std::ostream& ostr)
+{
+    const auto& columns = columns_for(m_Options.ExportStyle);
+    for (size_t j = 0; j < columns.size(); ++j) {
+        if (j) ostr << ',';
+        ostr << columns[j].Name;
+    }
+    ostr << '\n';
+}
+
+void bench::ContactGenerator::write_row(std::ostream& ostr, const Person& person)
+{
+    const auto& columns = columns_for(m_Options.ExportStyle);
+    for (size_t j = 0; j < columns.size(); ++j) {
+        if (j) ostr << ',';
+        switch (columns[j].Value) {
+            case Slot::Empty: break;
+            case Slot::FirstName: ostr << field(person.FirstName); break;
+            case Slot::LastName: ostr << field(person.LastName); break;
+            case Slot::DisplayName: ostr << field(person.FirstName + " " + person.LastName); break;
+            case Slot::Email1: ostr << field(person.Email1); break;
+            case Slot::Email2: ostr << field(person.Email2); break;
+            case Slot::Mobile: ostr << field(person.Mobile); break;
+            case Slot::Home: ostr << field(person.Home); break;
+            case Slot::Work: ostr << field(person.Work); break;
+            case Slot::Normal: ostr << "Normal"; break;
+            case Slot::False: ostr << "False"; break;
+            case Slot::Unspecified: ostr << "Unspecified"; break;
+            case Slot::Type1: ostr << (person.Email1.empty() ? "" : "SMTP"); break;
+            case Slot::Type2: ostr << (person.Email2.empty() ? "" : "SMTP"); break;
+        }
+    }
+    ostr << '\n';
+}
+
+auto bench::ContactGenerator::generate(std::ostream& ostr, size_t nrows) -> size_t
+{
+    const auto start = ostr.tellp();
+    write_header(ostr);
+
+    // duplicates are drawn from a window of recent contacts, and half of them
+    // differ in case or spacing so that they only collide once formatted
+    constexpr size_t window = 1024;
+    std::vector<Person> recent;
+    recent.reserve(window);
+    for (size_t i = 0; i < nrows; ++i) {
+        if (!recent.empty() && chance(m_Options.DuplicateRate)) {
+            Person person = recent[next() % recent.size()];
+            if (chance(0.5)) {
+                for (auto& c : person.FirstName) {
+                    c = static_cast<char>(toupper(static_cast<unsigned char>(c)));
+                }
+                person.LastName = "  " + person.LastName;
+            }
+            write_row(ostr, person);
+            continue;
+        }
+        Person person = make_person(i);
+        write_row(ostr, person);
+        if (recent.size() < window) recent.push_back(std::move(person));
+        else recent[i % window] = std::move(person);
+    }
+    const auto end = ostr.tellp();
+    return (start < 0 || end < 0) ? 0 : static_cast<size_t>(end - start);
+}
+
+auto bench::ContactGenerator::generate(size_t nrows) -> std::string
+{
+    std::ostringstream ostr;
+    generate(ostr, nrows);
+    return ostr.str();
+}
+
+auto bench::ContactGenerator::ParseStyle(const std::string& name, Style& style) -> bool
+{
+    if (name == "outlook") style = Style::Outlook;
+    else if (name == "google") style = Style::Google;
+    else return false;
+    return true;
+}
+/******************************************************************************/
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace bench
+{
+
+/**
+ * Deterministic generator of synthetic contact exports, shaped like the CSV
+ * files written by Outlook and Google Contacts. The same options (including
+ * the seed) always produce byte-identical output.
+ */
+class ContactGenerator
+{
+public:
+    enum class Style { Outlook, Google };
+
+    struct Options
+    {
+        Style ExportStyle{Style::Outlook};
+        uint64_t Seed{0x5eed};
+        // fraction of rows that repeat an earlier contact
+        double DuplicateRate{0.05};
+        // fraction of fields wrapped in double quotes
+        double QuoteRate{0.0};
+        // fraction of names drawn from non-ASCII pools
+        double UnicodeRate{0.1};
+    };
+
+    explicit ContactGenerator(const Options&);
+
+    // write the header row followed by nrows contact rows, returning the
+    // number of bytes written
+    auto generate(std::ostream&, size_t nrows) -> size_t;
+    auto generate(size_t nrows) -> std::string;
+
+    static auto ParseStyle(const std::string&, Style&) -> bool;
+
+private:
+    struct Person
+    {
+        std::string FirstName, LastName, Email1, Email2, Mobile, Home, Work;
+    };
+
+    auto next() -> uint64_t;
+    auto chance(double) -> bool;
+    template <typename _Tp, size_t N>
+    auto pick(const _Tp (&)[N]) -> const _Tp&;
+
+    auto make_person(uint64_t id) -> Person;
+    auto make_phone(bool mobile) -> std::string;
+    auto field(const std::string&) -> std::string;
+
+    void write_header(std::ostream&);
+    void write_row(std::ostream&, const Person&);
+
+    Options m_Options{};
+    uint64_t m_State{};
+};
+
+} // namespace bench
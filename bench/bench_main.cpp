@@ -0,0 +1,416 @@
+#include "Benchmark.h"
+#include "Generator.h"
+
+#include "fileio/CSV.h"
+#include "fileio/Arrow.h"
+#include "contacts/Contact.h"
+#include "contacts/ConcurrentAddressBook.h"
+#include "contacts/ContactStats.h"
+#include "contacts/PrefixIndex.h"
+#include "util/memory.h"
+#include "util/string.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <memory_resource>
+#include <fstream>
+#include <filesystem>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/******************************************************************************/
+/* Options ********************************************************************/
+namespace
+{
+    struct BenchOptions
+    {
+        size_t MicroRows{100000};
+        // the end-to-end runs hold the whole table in memory, so larger
+        // sizes are left to --macro
+        std::vector<size_t> MacroRows{1000, 100000};
+        std::string Filter{};
+        double MinSeconds{0.25};
+    };
+
+    auto parse_sizes(const std::string& list, std::vector<size_t>& sizes) -> bool
+    {
+        sizes.clear();
+        std::istringstream istr{list};
+        for (std::string item; std::getline(istr, item, ','); ) {
+            if (item.empty()) continue;
+            if (!bench::ParseNumber(item, sizes.emplace_back())) return false;
+        }
+        return true;
+    }
+
+    auto parse_options(int argc, char** argv, BenchOptions& options) -> bool
+    {
+        for (int i = 1; i < argc; ++i) {
+            const std::string arg = argv[i];
+            if (arg.rfind("--rows=", 0) == 0) {
+                if (!bench::ParseNumber(arg.substr(7), options.MicroRows)) return false;
+            } else if (arg.rfind("--macro=", 0) == 0) {
+                if (!parse_sizes(arg.substr(8), options.MacroRows)) return false;
+            } else if (arg.rfind("--filter=", 0) == 0) {
+                options.Filter = arg.substr(9);
+            } else if (arg.rfind("--min-time=", 0) == 0) {
+                if (!bench::ParseNumber(arg.substr(11), options.MinSeconds)) return false;
+                if (options.MinSeconds < 0) return false;
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void print_usage(const char* program)
+    {
+        std::cerr << "Usage: " << program << " [--rows=N] [--macro=N,N,...]"
+            << " [--filter=NAME] [--min-time=SECONDS]\n";
+    }
+}
+/******************************************************************************/
+
+/******************************************************************************/
+/* Microbenchmarks ************************************************************/
+namespace
+{
+    void run_micro(const BenchOptions& options)
+    {
+        const auto enabled = [&](const std::string& name) {
+            return options.Filter.empty() || name.find(options.Filter) != std::string::npos;
+        };
+        const auto run = [&](const std::string& name, size_t rows, size_t bytes, auto fn) {
+            if (!enabled(name)) return;
+            bench::Result result;
+            {
+                bench::ScopedSilence silence{std::cout};
+                result = bench::Measure(name, rows, bytes, fn, options.MinSeconds);
+            }
+            bench::Report(std::cout, result);
+        };
+
+        const size_t nrows = options.MicroRows;
+        const std::string input = bench::ContactGenerator{{}}.generate(nrows);
+        const size_t nbytes = input.size();
+
+        fileio::CSVTable table;
+        {
+            bench::ScopedSilence silence{std::cout};
+            table = fileio::CSVReader::ReadCSVTable(input, ',');
+        }
+        const auto& header = table.front();
+        size_t header_bytes = 0;
+        for (const auto& cell : header) header_bytes += cell.str().size() + 1;
+
+        std::cout << "== microbenchmarks (" << nrows << " rows, "
+            << nbytes << " bytes) ==" << std::endl;
+
+        run("ReadCSVTable", nrows, nbytes, [&]() {
+            auto result = fileio::CSVReader::ReadCSVTable(input, ',');
+            return result.size();
+        });
+
+        run("ContactCSVInputMap", 1, header_bytes, [&]() {
+            ContactCSVInputMap mapper{header};
+            return mapper.MapFirstName.FieldName.size();
+        });
+
+        std::unique_ptr<ContactCSVInputMap> mapper;
+        {
+            bench::ScopedSilence silence{std::cout};
+            mapper = std::make_unique<ContactCSVInputMap>(header);
+        }
+        // every column, then only the mapped columns, as the streaming
+        // readers read once the header is mapped
+        run("CSVStreamReader", nrows, nbytes, [&]() {
+            std::istringstream istr{input};
+            fileio::CSVStreamReader reader{istr, ','};
+            size_t rows = 0;
+            for (auto batch = reader.read(4096); !batch.empty(); batch = reader.read(4096)) {
+                rows += batch.size();
+            }
+            return rows;
+        });
+        run("CSVStreamReader projected", nrows, nbytes, [&]() {
+            std::istringstream istr{input};
+            fileio::CSVStreamReader reader{istr, ','};
+            reader.project(fileio::CSVProjection{mapper->columns()});
+            size_t rows = 0;
+            for (auto batch = reader.read(4096); !batch.empty(); batch = reader.read(4096)) {
+                rows += batch.size();
+            }
+            return rows;
+        });
+
+        std::vector<Contact> contacts;
+        contacts.reserve(nrows);
+        run("Contact construction", nrows, nbytes, [&]() {
+            contacts.clear();
+            for (size_t i = 1; i < table.size(); ++i) {
+                contacts.emplace_back(table[i], *mapper);
+            }
+        });
+
+        size_t field_bytes = 0;
+        for (const auto& contact : contacts) {
+            for (auto field : Contact::Fields) field_bytes += (contact.*field).size();
+        }
+
+        // each formats into one reused buffer, so that only formatting is timed
+        std::string buffer;
+        run("util::format_as_proper_noun", nrows, field_bytes, [&]() {
+            size_t total = 0;
+            for (const auto& contact : contacts) {
+                buffer.clear();
+                total += util::format_as_proper_noun(contact.FirstName, buffer);
+                total += util::format_as_proper_noun(contact.LastName, buffer);
+            }
+            return total;
+        });
+        run("util::format_as_1line_proper_noun", nrows, field_bytes, [&]() {
+            size_t total = 0;
+            for (const auto& contact : contacts) {
+                buffer.clear();
+                total += util::format_as_1line_proper_noun(contact.FirstName, buffer);
+                total += util::format_as_1line_proper_noun(contact.LastName, buffer);
+                total += util::format_as_1line_proper_noun(contact.DisplayName, buffer);
+            }
+            return total;
+        });
+        run("util::format_as_phone_number", nrows, field_bytes, [&]() {
+            size_t total = 0;
+            for (const auto& contact : contacts) {
+                buffer.clear();
+                total += util::format_as_phone_number(contact.MobilePhoneNumber, buffer);
+                total += util::format_as_phone_number(contact.HomePhoneNumber, buffer);
+                total += util::format_as_phone_number(contact.WorkPhoneNumber, buffer);
+            }
+            return total;
+        });
+
+        run("std::hash<Contact>", nrows, field_bytes, [&]() {
+            size_t seed = 0;
+            for (const auto& contact : contacts) seed ^= std::hash<Contact>{}(contact);
+            return seed;
+        });
+        run("ContactStats::add", nrows, field_bytes, [&]() {
+            ContactStats contact_stats;
+            for (const auto& contact : contacts) contact_stats.add(contact);
+            return contact_stats.contacts();
+        });
+
+        // deduplication alone, then from 1 to 32 threads at once, each copying
+        // in an interleaved slice of the contacts as ingest would hand them over
+        run("AddressBook::insert", nrows, field_bytes, [&]() {
+            AddressBook book;
+            for (const auto& contact : contacts) book.insert(Contact{contact});
+            return book.size();
+        });
+        for (const size_t nthreads : {1, 2, 4, 8, 16, 32}) {
+            run("ConcurrentAddressBook::insert (" + std::to_string(nthreads) + " thr)",
+                nrows, field_bytes, [&]() {
+                    ConcurrentAddressBook book{4 * nthreads};
+                    std::vector<std::thread> threads;
+                    for (size_t t = 0; t < nthreads; ++t) {
+                        threads.emplace_back([&, t]() {
+                            for (size_t i = t; i < contacts.size(); i += nthreads) {
+                                book.insert(Contact{contacts[i]}, i);
+                            }
+                        });
+                    }
+                    for (auto& thread : threads) thread.join();
+                    return book.size();
+                });
+        }
+        run("ConcurrentAddressBook::insert + merge", nrows, field_bytes, [&]() {
+            ConcurrentAddressBook book;
+            for (size_t i = 0; i < contacts.size(); ++i) book.insert(Contact{contacts[i]}, i);
+            return std::move(book).merge(ContactCSVInputMap{}).size();
+        });
+
+        std::unique_ptr<AddressBook> address_book;
+        {
+            bench::ScopedSilence silence{std::cout};
+            address_book = std::make_unique<AddressBook>(table);
+        }
+        run("AddressBook::format_all (with copy)", address_book->size(), field_bytes, [&]() {
+            AddressBook copy{*address_book};
+            copy.format_all();
+            return copy.size();
+        });
+
+        address_book->format_all();
+        run("AddressBook::build_index", address_book->size(), field_bytes, [&]() {
+            address_book->build_index();
+            return address_book->size();
+        });
+        std::vector<std::string> emails;
+        for (size_t i = 0; i < address_book->size(); ++i) {
+            const auto& email = (*address_book)[i].EmailAddress1;
+            if (!email.empty()) emails.emplace_back(email);
+        }
+        run("AddressBook::find_email", emails.size(), 0, [&]() {
+            size_t found = 0;
+            for (const auto& email : emails) found += (address_book->find_email(email) != nullptr);
+            return found;
+        });
+
+        PrefixIndex prefix_index;
+        run("PrefixIndex::Build", address_book->size(), field_bytes, [&]() {
+            prefix_index = PrefixIndex::Build(*address_book);
+            return prefix_index.size();
+        });
+        // typeahead queries of growing length, taken from the display names
+        std::vector<std::string> prefixes;
+        for (size_t i = 0; i < address_book->size(); i += 7) {
+            const auto& name = (*address_book)[i].DisplayName;
+            prefixes.emplace_back(name.substr(0, 1 + i % std::max<size_t>(name.size(), 1)));
+        }
+        run("PrefixIndex::complete (top 10)", prefixes.size(), 0, [&]() {
+            std::vector<uint32_t> rows;
+            for (const auto& prefix : prefixes) prefix_index.complete(prefix, 10, rows);
+            return rows.size();
+        });
+
+        const auto table_out = fileio::CSVTable{address_book->table_view()};
+        run("WriteCSVTable", table_out.nrows(), field_bytes, [&]() {
+            std::string output;
+            fileio::CSVWriter::WriteCSVTable(table_out, output);
+            return output.size();
+        });
+
+        std::vector<std::string> column_names;
+        for (const auto& cell : table_out.front()) column_names.emplace_back(cell.str());
+        run("ArrowFileWriter", address_book->size(), field_bytes, [&]() {
+            std::ostringstream output;
+            fileio::ArrowFileWriter writer{output, column_names};
+            std::array<std::string_view, Contact::Fields.size()> cells;
+            for (size_t i = 0; i < address_book->size(); ++i) {
+                for (size_t j = 0; j < cells.size(); ++j) cells[j] = (*address_book)[i].*Contact::Fields[j];
+                writer.write_row(cells);
+            }
+            writer.close();
+            return output.str().size();
+        });
+    }
+}
+/******************************************************************************/
+
+/******************************************************************************/
+/* Macrobenchmarks ************************************************************/
+namespace
+{
+    void run_macro(const BenchOptions& options)
+    {
+        namespace fs = std::filesystem;
+        if (options.MacroRows.empty()) return;
+        std::cout << "== end-to-end ==" << std::endl;
+
+        const fs::path dir = fs::temp_directory_path() / "contacts-bench";
+        fs::create_directories(dir);
+        for (const size_t nrows : options.MacroRows) {
+            const std::string name = "end-to-end " + std::to_string(nrows) + " rows";
+            if (!options.Filter.empty() && name.find(options.Filter) == std::string::npos) continue;
+
+            const fs::path src = dir / ("input-" + std::to_string(nrows) + ".csv");
+            const fs::path dst = dir / ("output-" + std::to_string(nrows) + ".csv");
+            size_t nbytes = 0;
+            {
+                std::ofstream file{src, std::ios::binary};
+                nbytes = bench::ContactGenerator{{}}.generate(file, nrows);
+            }
+
+            // The string data too long to be stored inline, in the input as
+            // it is read and in the contacts written, to count copies by
+            size_t read_bytes = 0;
+            size_t contact_bytes = 0;
+            {
+                bench::ScopedSilence silence{std::cout};
+                const size_t inline_capacity = std::pmr::string{}.capacity();
+                const auto long_bytes = [&](const std::pmr::string& str) -> size_t {
+                    return (str.size() > inline_capacity) ? str.size() + 1 : 0;
+                };
+                auto file_in = std::ifstream{src};
+                auto table_in = fileio::CSVReader::ReadCSVTable(file_in, ',');
+                for (const auto& row : table_in) {
+                    for (const auto& cell : row) read_bytes += long_bytes(cell.str());
+                }
+                auto address_book = AddressBook{std::move(table_in)};
+                address_book.format_all();
+                for (size_t i = 0; i < address_book.size(); ++i) {
+                    for (const auto field : Contact::Fields) contact_bytes += long_bytes(address_book[i].*field);
+                }
+            }
+
+            // the same stages main runs, with previews disabled: once copying
+            // the data between stages as it used to, and once moving it along
+            const auto measure = [&](const std::string& variant, auto fn) {
+                util::CountingResource counter;
+                bench::Result result;
+                {
+                    bench::ScopedSilence silence{std::cout};
+                    util::ScopedDefaultResource scope{&counter};
+                    result = bench::Measure(name + variant, nrows, nbytes, fn, 0.0);
+                }
+                bench::Report(std::cout, result);
+                const double copied = std::max(double(counter.byte_aligned_bytes()) / result.Iterations
+                    - double(read_bytes), 0.0);
+                std::cout << "    allocated " << counter.total_bytes() / result.Iterations / (1 << 20)
+                    << " MiB, " << std::fixed << std::setprecision(1)
+                    << double(counter.total_bytes()) / result.Iterations / nbytes
+                    << "x the input; " << copied / (1 << 20) << " MiB of long strings past reading, "
+                    << copied / std::max<size_t>(contact_bytes, 1) << "x those of the contacts"
+                    << std::defaultfloat << std::endl;
+            };
+            measure(" (copied)", [&]() {
+                auto file_in = std::ifstream{src};
+                auto table_in = fileio::CSVReader::ReadCSVTable(file_in, ',');
+                auto address_book = AddressBook{table_in};
+                // format_all as it was: copy each contact out, format it, copy
+                // it into a second set, and copy it back out of that set
+                auto formatted = [&]() {
+                    AddressBook copies{address_book.FieldMapper};
+                    for (size_t i = 0; i < address_book.size(); ++i) {
+                        auto contact = address_book[i];
+                        contact.format();
+                        copies.insert(Contact{contact});
+                    }
+                    AddressBook result{address_book.FieldMapper};
+                    for (size_t i = 0; i < copies.size(); ++i) result.insert(Contact{copies[i]});
+                    return result;
+                }();
+                auto file_out = std::ofstream{dst};
+                auto table_out = fileio::CSVTable{formatted.table_view()};
+                fileio::CSVWriter::WriteCSVTable(table_out, file_out);
+            });
+            measure(" (moved)", [&]() {
+                auto file_in = std::ifstream{src};
+                auto address_book = AddressBook{fileio::CSVReader::ReadCSVTable(file_in, ',')};
+                address_book.format_all();
+                auto file_out = std::ofstream{dst};
+                fileio::CSVWriter::WriteCSVTable(std::move(address_book).to_table(), file_out);
+            });
+
+            fs::remove(src);
+            fs::remove(dst);
+        }
+    }
+}
+/******************************************************************************/
+
+int main(int argc, char** argv)
+{
+    BenchOptions options;
+    if (!parse_options(argc, argv, options)) {
+        print_usage(argv[0]);
+        return -1;
+    }
+
+    run_micro(options);
+    run_macro(options);
+}
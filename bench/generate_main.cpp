@@ -0,0 +1,53 @@
+#include "Benchmark.h"
+#include "Generator.h"
+
+#include <iostream>
+#include <fstream>
+#include <string>
+
+int main(int argc, char** argv)
+{
+    bench::ContactGenerator::Options options;
+    size_t nrows = 1000;
+    std::string output;
+
+    const auto parse_rate = [](const std::string& str, double& rate) {
+        return bench::ParseNumber(str, rate) && rate >= 0.0 && rate <= 1.0;
+    };
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        bool valid = true;
+        if (arg.rfind("--rows=", 0) == 0) valid = bench::ParseNumber(arg.substr(7), nrows);
+        else if (arg.rfind("--seed=", 0) == 0) valid = bench::ParseNumber(arg.substr(7), options.Seed);
+        else if (arg.rfind("--duplicates=", 0) == 0) valid = parse_rate(arg.substr(13), options.DuplicateRate);
+        else if (arg.rfind("--quotes=", 0) == 0) valid = parse_rate(arg.substr(9), options.QuoteRate);
+        else if (arg.rfind("--unicode=", 0) == 0) valid = parse_rate(arg.substr(10), options.UnicodeRate);
+        else if (arg.rfind("--style=", 0) == 0) valid = bench::ContactGenerator::ParseStyle(arg.substr(8), options.ExportStyle);
+        else if (arg.rfind("--", 0) != 0 && output.empty()) output = arg;
+        else valid = false;
+
+        if (!valid) {
+            std::cerr << "Usage: " << argv[0] << " [--rows=N] [--seed=N]"
+                << " [--style=outlook|google] [--duplicates=RATE] [--quotes=RATE]"
+                << " [--unicode=RATE] [output.csv]\n";
+            return -1;
+        }
+    }
+
+    bench::ContactGenerator generator{options};
+    if (output.empty()) {
+        generator.generate(std::cout, nrows);
+    } else {
+        std::ofstream file{output, std::ios::binary};
+        if (!file) {
+            std::cerr << "Cannot open " << output << std::endl;
+            return -1;
+        }
+        generator.generate(file, nrows);
+        file.close();
+        if (!file) {
+            std::cerr << "Cannot write " << output << std::endl;
+            return -1;
+        }
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef CONTACTS_H
+#define CONTACTS_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * The C API of the contacts library, for translating contacts tables in
+ * process from memory buffers. A translator is fed the bytes of one CSV
+ * table, translates them when finished, and then hands out the translated
+ * table in pieces. Functions returning int return 0 on success and -1 on
+ * failure, with a message left in contacts_translator_error unless the
+ * translator itself is NULL.
+ *
+ *     contacts_translator* translator = contacts_translator_create(',');
+ *     contacts_translator_feed(translator, data, size);
+ *     contacts_translator_finish(translator);
+ *     while ((n = contacts_translator_pull(translator, buffer, sizeof buffer)) > 0) ...
+ *     contacts_translator_destroy(translator);
+ *
+ * A translator may be used from one thread at a time; separate translators
+ * are independent.
+ */
+
+typedef struct contacts_translator contacts_translator;
+
+typedef struct contacts_stats
+{
+    size_t rows_in;
+    size_t rows_out;
+    size_t bytes_in;
+    size_t bytes_out;
+} contacts_stats;
+
+/* Create a translator for input separated by delimiter, or NULL on failure. */
+contacts_translator* contacts_translator_create(char delimiter);
+void contacts_translator_destroy(contacts_translator* translator);
+
+/* Translate only the contacts selected by a filter expression, as --filter. */
+int contacts_translator_set_filter(contacts_translator* translator, const char* expression);
+/* Sort the output by keys such as "last,first,email", as --sort. */
+int contacts_translator_set_sort(contacts_translator* translator, const char* keys);
+
+/* Append size bytes of input; fails once the translator is finished. */
+int contacts_translator_feed(contacts_translator* translator, const char* data, size_t size);
+/* Translate all of the input fed so far. */
+int contacts_translator_finish(contacts_translator* translator);
+
+/*
+ * Copy up to capacity bytes of the translated table into buffer, returning
+ * the number of bytes copied, or 0 once all of it has been pulled.
+ */
+size_t contacts_translator_pull(contacts_translator* translator, char* buffer, size_t capacity);
+
+int contacts_translator_stats(const contacts_translator* translator, contacts_stats* stats);
+/* The message of the last failure, or an empty string. */
+const char* contacts_translator_error(const contacts_translator* translator);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CONTACTS_H */
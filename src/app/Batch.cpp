@@ -0,0 +1,196 @@
+#include "Batch.h"
+#include "Translate.h"
+#include "Profile.h"
+#include "util/thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+/******************************************************************************/
+/* Jobs ***********************************************************************/
+namespace
+{
+    struct BatchJob
+    {
+        fs::path Input{};
+        fs::path Output{};
+        size_t Size{};
+
+        app::TranslateStats Stats{};
+        double Seconds{};
+        bool Failed{false};
+    };
+
+    auto trim(const std::string& str) -> std::string
+    {
+        const auto first = str.find_first_not_of(" \t\r");
+        if (first == std::string::npos) return "";
+        const auto last = str.find_last_not_of(" \t\r");
+        return str.substr(first, last - first + 1);
+    }
+
+    // Manifest lines are "<input>\t<output>" or "<input> -> <output>"; blank
+    // lines and lines starting with '#' are skipped
+    auto read_manifest(const fs::path& manifest, std::vector<BatchJob>& jobs) -> bool
+    {
+        std::ifstream file{manifest};
+        if (!file) return false;
+
+        std::string line;
+        for (size_t number = 1; std::getline(file, line); ++number) {
+            if (trim(line).empty() || trim(line)[0] == '#') continue;
+            size_t split = line.find(" -> ");
+            size_t skip = 4;
+            if (split == std::string::npos) {
+                split = line.find('\t');
+                skip = 1;
+            }
+            if (split == std::string::npos) {
+                std::cerr << manifest.string() << ":" << number
+                    << ": expected \"<input> -> <output>\"" << std::endl;
+                return false;
+            }
+            jobs.push_back({trim(line.substr(0, split)), trim(line.substr(split + skip))});
+        }
+        return true;
+    }
+
+    auto read_directory(const fs::path& input_dir, const fs::path& output_dir,
+        const char* extension, std::vector<BatchJob>& jobs) -> bool
+    {
+        std::error_code error;
+        for (const auto& entry : fs::directory_iterator{input_dir, error}) {
+            if (!entry.is_regular_file() || entry.path().extension() != ".csv") continue;
+            auto output = output_dir / entry.path().filename();
+            jobs.push_back({entry.path(), output.replace_extension(extension)});
+        }
+        return !error;
+    }
+
+    auto read_file(const fs::path& path, std::string& data) -> bool
+    {
+        std::ifstream file{path, std::ios::binary};
+        if (!file) return false;
+        data.assign(std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{});
+        return true;
+    }
+
+    void print_throughput(std::ostream& ostr, size_t rows, size_t bytes, double seconds)
+    {
+        seconds = std::max(seconds, 1e-9);
+        ostr << std::fixed << std::setprecision(3) << seconds << " s, "
+            << std::setprecision(0) << rows / seconds << " rows/s, "
+            << std::setprecision(1) << bytes / seconds / (1 << 20) << " MiB/s";
+    }
+}
+/******************************************************************************/
+
+/******************************************************************************/
+/* Batch **********************************************************************/
+auto app::RunBatch(const Options& options) -> int
+{
+    using Clock = std::chrono::steady_clock;
+
+    std::vector<BatchJob> jobs;
+    const fs::path source = options.Source;
+    if (fs::is_directory(source)) {
+        if (options.Destination.empty()) {
+            std::cerr << "Batch over a directory needs an output directory" << std::endl;
+            return -1;
+        }
+        fs::create_directories(options.Destination);
+        const char* extension = options.ArrowOutput ? ".arrow" : ".csv";
+        if (!read_directory(source, options.Destination, extension, jobs)) {
+            std::cerr << "Cannot list " << source.string() << std::endl;
+            return -1;
+        }
+    } else if (!read_manifest(source, jobs)) {
+        std::cerr << "Cannot read manifest " << source.string() << std::endl;
+        return -1;
+    }
+
+    // Start the largest files first, so that their chunks are spread over the
+    // pool while the small files fill in around them
+    for (auto& job : jobs) {
+        std::error_code error;
+        job.Size = fs::file_size(job.Input, error);
+    }
+    std::stable_sort(jobs.begin(), jobs.end(),
+        [](const auto& a, const auto& b) { return a.Size > b.Size; });
+
+    const auto profiles = MakeProfileCache(options);
+    MappingCache mappings{profiles.get()};
+    TranslateOptions translate_options;
+    translate_options.Mappings = &mappings;
+    translate_options.Filter = options.Filter ? &*options.Filter : nullptr;
+    translate_options.Order = options.Order;
+    translate_options.MaxMemory = options.MaxMemory;
+    translate_options.SpillDir = options.SpillDir;
+    translate_options.ArrowOutput = options.ArrowOutput;
+
+    std::mutex report_mutex;
+    const auto start = Clock::now();
+    {
+        util::ThreadPool pool{options.Threads ? options.Threads : std::thread::hardware_concurrency()};
+        translate_options.Pool = &pool;
+        util::TaskGroup group;
+        for (auto& job : jobs) {
+            pool.submit(group, [&]() {
+                const auto job_start = Clock::now();
+                std::string data;
+                std::ofstream file_out;
+                std::string error;
+                if (read_file(job.Input, data)) file_out.open(job.Output, std::ios::binary);
+                if (!file_out) {
+                    job.Failed = true;
+                } else {
+                    // a file that throws fails on its own, leaving the others
+                    try {
+                        job.Stats = TranslateChunked(data, file_out, pool, options.ChunkSize,
+                            translate_options);
+                        file_out.close();
+                        job.Failed = !file_out;
+                    } catch (const std::exception& exception) {
+                        error = exception.what();
+                        job.Failed = true;
+                    }
+                }
+                job.Seconds = std::chrono::duration<double>(Clock::now() - job_start).count();
+
+                std::lock_guard lock{report_mutex};
+                std::cerr << job.Input.string() << " -> " << job.Output.string() << ": ";
+                if (job.Failed) {
+                    std::cerr << "FAILED" << (error.empty() ? "" : " (" + error + ")") << std::endl;
+                    return;
+                }
+                std::cerr << job.Stats.RowsIn << " rows in, " << job.Stats.RowsOut << " rows out, ";
+                print_throughput(std::cerr, job.Stats.RowsIn, job.Stats.BytesIn, job.Seconds);
+                std::cerr << std::endl;
+            });
+        }
+        pool.wait(group);
+    }
+    const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    size_t rows = 0, bytes = 0, failed = 0;
+    for (const auto& job : jobs) {
+        rows += job.Stats.RowsIn;
+        bytes += job.Stats.BytesIn;
+        failed += job.Failed ? 1 : 0;
+    }
+    std::cerr << "Batch: " << jobs.size() << " files (" << failed << " failed), "
+        << rows << " rows, " << bytes << " bytes, ";
+    print_throughput(std::cerr, rows, bytes, seconds);
+    std::cerr << std::endl;
+    return failed ? -1 : 0;
+}
+/******************************************************************************/
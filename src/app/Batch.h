@@ -0,0 +1,16 @@
+#pragma once
+
+#include "app/Options.h"
+
+namespace app
+{
+
+/**
+ * Translate every CSV file of a directory, or every input/output pair listed
+ * in a manifest, on one work-stealing pool. Large files are split into
+ * chunks that idle workers steal, so they do not hold up the other files.
+ * Reports per-file and aggregate throughput.
+ */
+auto RunBatch(const Options&) -> int;
+
+} // namespace app
@@ -0,0 +1,317 @@
+#include "Checkpoint.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+/******************************************************************************/
+/* Checkpoint *****************************************************************/
+void app::Checkpoint::write(std::ostream& ostr) const
+{
+    ostr << "# contacts translation checkpoint\n"
+        << "version = " << Version << "\n"
+        << "fingerprint = " << std::hex << Fingerprint << std::dec << "\n"
+        << "input-size = " << InputSize << "\n"
+        << "input-offset = " << InputOffset << "\n"
+        << "output-offset = " << OutputOffset << "\n"
+        << "rows-in = " << RowsIn << "\n"
+        << "rows-out = " << RowsOut << "\n";
+}
+
+auto app::Checkpoint::Read(std::istream& istr) -> std::optional<Checkpoint>
+{
+    Checkpoint checkpoint;
+    bool versioned = false;
+
+    std::string line;
+    while (std::getline(istr, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        const auto split = line.find(" = ");
+        if (split == std::string::npos) return std::nullopt;
+        const std::string key = line.substr(0, split);
+        const std::string value = line.substr(split + 3);
+
+        try {
+            if (key == "version") versioned = (std::stoi(value) == Version);
+            else if (key == "fingerprint") checkpoint.Fingerprint = std::stoull(value, nullptr, 16);
+            else if (key == "input-size") checkpoint.InputSize = std::stoull(value);
+            else if (key == "input-offset") checkpoint.InputOffset = std::stoull(value);
+            else if (key == "output-offset") checkpoint.OutputOffset = std::stoull(value);
+            else if (key == "rows-in") checkpoint.RowsIn = std::stoull(value);
+            else if (key == "rows-out") checkpoint.RowsOut = std::stoull(value);
+            else return std::nullopt;
+        } catch (const std::exception&) {
+            return std::nullopt;
+        }
+    }
+    if (!versioned) return std::nullopt;
+    return checkpoint;
+}
+/******************************************************************************/
+
+/******************************************************************************/
+/* TranslateCheckpointed ******************************************************/
+namespace
+{
+    namespace fs = std::filesystem;
+
+    /**
+     * The files a checkpointed translation keeps beside its destination.
+     */
+    struct CheckpointFiles
+    {
+        explicit CheckpointFiles(const std::string& destination)
+            : Partial{destination + ".partial"}
+            , Seen{destination + ".seen"}
+            , Checkpoint{destination + ".checkpoint"}
+        {}
+
+        std::string Partial;
+        std::string Seen;
+        std::string Checkpoint;
+    };
+
+    // a contact written to the partial output, as logged to the snapshot
+    struct SeenEntry
+    {
+        uint64_t Hash{};
+        // where its row starts in the partial output
+        uint64_t Offset{};
+    };
+
+    // flush a file's written data to the disk
+    auto sync_file(const std::string& path) -> bool
+    {
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        const bool synced = (::fsync(fd) == 0);
+        ::close(fd);
+        return synced;
+    }
+
+    // write a checkpoint to a temporary file and rename it over the last one,
+    // so that a crash leaves one or the other whole
+    auto commit_checkpoint(const app::Checkpoint& checkpoint, const std::string& path) -> bool
+    {
+        const auto temporary = path + ".tmp";
+        {
+            std::ofstream file{temporary};
+            checkpoint.write(file);
+            file.close();
+            if (!file) return false;
+        }
+        if (!sync_file(temporary)) return false;
+        std::error_code error;
+        fs::rename(temporary, path, error);
+        return !error;
+    }
+}
+
+auto app::TranslateCheckpointed(const std::string& source, const std::string& destination,
+    const CheckpointOptions& checkpoint_options, const TranslateOptions& options)
+    -> CheckpointStats
+{
+    CheckpointStats stats;
+    const CheckpointFiles files{destination};
+
+    std::ifstream input{source, std::ios::binary};
+    std::error_code error;
+    const auto input_size = static_cast<size_t>(fs::file_size(source, error));
+    if (!input || error) {
+        std::cerr << "Cannot open " << source << std::endl;
+        return stats;
+    }
+    stats.BytesIn = input_size;
+
+    fileio::CSVStreamReader header_reader{input, options.Delimiter};
+    const auto header = header_reader.read(1);
+    if (header.empty()) {
+        std::ofstream file{destination};
+        stats.Complete = static_cast<bool>(file);
+        return stats;
+    }
+    std::shared_ptr<const ContactCSVInputMap> mapper = options.Mappings
+        ? options.Mappings->get(header.front())
+        : std::make_shared<const ContactCSVInputMap>(header.front());
+    const auto filter = options.Filter
+        ? std::optional<ContactFilter>{options.Filter->bind(header.front())}
+        : std::nullopt;
+
+    // a checkpoint only applies to the same header, delimiter and filter
+    Checkpoint state;
+    state.Fingerprint = TranslateFingerprint(header.front(), options);
+    state.InputSize = input_size;
+    state.InputOffset = header_reader.bytes_read();
+
+    // Resume from the last checkpoint, cutting the partial output and the
+    // snapshot back to it
+    std::optional<Checkpoint> resumed;
+    if (checkpoint_options.Resume && fs::exists(files.Checkpoint)) {
+        std::ifstream file{files.Checkpoint};
+        resumed = Checkpoint::Read(file);
+        if (!resumed) {
+            std::cerr << "Cannot read checkpoint " << files.Checkpoint << std::endl;
+            return stats;
+        }
+        if (resumed->Fingerprint != state.Fingerprint || resumed->InputSize != state.InputSize) {
+            std::cerr << "Checkpoint " << files.Checkpoint
+                << " was taken with a different input or options" << std::endl;
+            return stats;
+        }
+        const auto partial_size = fs::file_size(files.Partial, error);
+        const auto seen_size = error ? 0 : fs::file_size(files.Seen, error);
+        if (error || partial_size < resumed->OutputOffset
+            || seen_size < resumed->RowsOut * sizeof(SeenEntry))
+        {
+            std::cerr << "Partial output for " << files.Checkpoint
+                << " is missing or shorter than its checkpoint" << std::endl;
+            return stats;
+        }
+        fs::resize_file(files.Partial, resumed->OutputOffset, error);
+        if (!error) fs::resize_file(files.Seen, resumed->RowsOut * sizeof(SeenEntry), error);
+        if (error) {
+            std::cerr << "Cannot truncate partial output " << files.Partial << std::endl;
+            return stats;
+        }
+        state = *resumed;
+        stats.ResumedAt = state.InputOffset;
+    }
+
+    // The contacts written so far, by their stable hash, to where they were
+    // written
+    std::unordered_multimap<uint64_t, uint64_t> seen;
+    const auto mode = resumed
+        ? std::ios::binary | std::ios::in | std::ios::out
+        : std::ios::binary | std::ios::out | std::ios::trunc;
+    std::fstream output{files.Partial, mode};
+    std::fstream seen_log{files.Seen, mode};
+    if (!output || !seen_log) {
+        std::cerr << "Cannot create partial output " << files.Partial << std::endl;
+        return stats;
+    }
+    if (resumed) {
+        seen.reserve(state.RowsOut);
+        for (size_t i = 0; i < state.RowsOut; ++i) {
+            SeenEntry entry;
+            seen_log.read(reinterpret_cast<char*>(&entry), sizeof(entry));
+            seen.emplace(entry.Hash, entry.Offset);
+        }
+        output.seekp(0, std::ios::end);
+        seen_log.seekp(0, std::ios::end);
+    }
+
+    if (!resumed) {
+        fileio::CSVStreamWriter writer{output};
+        WriteContactHeader(writer, *mapper);
+    }
+    // rows are separated by newlines, so each starts one past the end of
+    // the output before it
+    auto written = static_cast<uint64_t>(output.tellp());
+
+    // The hash only picks out the rows a contact may duplicate; those are
+    // read back from the partial output and compared with the contact's
+    // own row, so that a hash collision never drops a distinct contact
+    std::ostringstream row_stream;
+    const auto format_row = [&](const Contact& contact) {
+        row_stream.str({});
+        fileio::CSVStreamWriter row_writer{row_stream};
+        WriteContact(row_writer, contact);
+        return row_stream.str();
+    };
+    std::ifstream written_rows;
+    std::string stored;
+    const auto written_before = [&](uint64_t hash, const std::string& row) {
+        const auto [first, last] = seen.equal_range(hash);
+        if (first == last) return false;
+        output.flush();
+        if (!written_rows.is_open()) written_rows.open(files.Partial, std::ios::binary);
+        stored.resize(row.size() + 1);
+        for (auto itr = first; itr != last; ++itr) {
+            written_rows.clear();
+            written_rows.seekg(static_cast<std::streamoff>(itr->second));
+            written_rows.read(stored.data(), static_cast<std::streamsize>(stored.size()));
+            const auto count = static_cast<size_t>(written_rows.gcount());
+            if (count < row.size() || stored.compare(0, row.size(), row) != 0) continue;
+            if (count == row.size() || stored[row.size()] == '\n') return true;
+        }
+        return false;
+    };
+
+    const auto checkpoint = [&]() {
+        output.flush();
+        seen_log.flush();
+        if (!output || !seen_log) return false;
+        state.OutputOffset = static_cast<size_t>(output.tellp());
+        if (!sync_file(files.Partial) || !sync_file(files.Seen)) return false;
+        return commit_checkpoint(state, files.Checkpoint);
+    };
+
+    // Translate the rest of the input, in input order
+    input.clear();
+    input.seekg(static_cast<std::streamoff>(state.InputOffset));
+    const size_t base = state.InputOffset;
+    fileio::CSVStreamReader reader{input, options.Delimiter};
+    const ProjectedMapping projected{*mapper, filter ? &*filter : nullptr};
+    reader.project(projected.Projection);
+
+    const size_t batch_size = std::max<size_t>(checkpoint_options.BatchSize, 1);
+    const size_t interval = std::max<size_t>(checkpoint_options.Interval, 1);
+    size_t next_checkpoint = state.InputOffset + interval;
+    std::vector<Contact> contacts;
+    for (auto batch = reader.read(batch_size); !batch.empty(); batch = reader.read(batch_size)) {
+        contacts.clear();
+        MapContacts(batch.data(), batch.size(), projected.Mapper, projected.filter(), contacts);
+        for (const auto& contact : contacts) {
+            const SeenEntry entry{StableHash(contact), written + 1};
+            const auto row = format_row(contact);
+            if (written_before(entry.Hash, row)) {
+                if (options.Stats) options.Stats->add_duplicates();
+                continue;
+            }
+            if (options.Stats) options.Stats->add(contact);
+            output.put('\n');
+            output.write(row.data(), static_cast<std::streamsize>(row.size()));
+            written += 1 + row.size();
+            seen.emplace(entry.Hash, entry.Offset);
+            seen_log.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+            state.RowsOut += 1;
+        }
+        state.RowsIn += batch.size();
+        state.InputOffset = base + reader.bytes_read();
+
+        if (state.InputOffset >= next_checkpoint) {
+            if (!checkpoint()) {
+                std::cerr << "Cannot write checkpoint " << files.Checkpoint << std::endl;
+                return stats;
+            }
+            stats.Checkpoints += 1;
+            next_checkpoint = state.InputOffset + interval;
+        }
+    }
+    stats.RowsIn = state.RowsIn;
+    stats.RowsOut = state.RowsOut;
+
+    // Commit the output by renaming it over the destination
+    output.close();
+    seen_log.close();
+    if (!output || !sync_file(files.Partial)) {
+        std::cerr << "Cannot write partial output " << files.Partial << std::endl;
+        return stats;
+    }
+    fs::rename(files.Partial, destination, error);
+    if (error) {
+        std::cerr << "Cannot rename " << files.Partial << " to " << destination << std::endl;
+        return stats;
+    }
+    fs::remove(files.Checkpoint, error);
+    fs::remove(files.Seen, error);
+    stats.Complete = true;
+    return stats;
+}
+/******************************************************************************/
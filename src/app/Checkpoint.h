@@ -0,0 +1,71 @@
+#pragma once
+
+#include "app/Translate.h"
+
+#include <cstdint>
+#include <istream>
+#include <optional>
+#include <ostream>
+#include <string>
+
+namespace app
+{
+
+/**
+ * A consistent point of a checkpointed translation: the rows of the input
+ * before InputOffset have been translated into the first OutputOffset bytes
+ * of the partial output, and the first RowsOut entries of the dedup snapshot
+ * are those of the contacts written.
+ */
+struct Checkpoint
+{
+    static constexpr int Version = 2;
+
+    // the input and options the checkpoint was taken with
+    uint64_t Fingerprint{};
+    size_t InputSize{};
+
+    size_t InputOffset{};
+    size_t OutputOffset{};
+    size_t RowsIn{};
+    size_t RowsOut{};
+
+    void write(std::ostream&) const;
+    static auto Read(std::istream&) -> std::optional<Checkpoint>;
+};
+
+struct CheckpointOptions
+{
+    // bytes of input read between checkpoints
+    size_t Interval{size_t{64} << 20};
+    // continue from the checkpoint of an earlier run, if there is one
+    bool Resume{false};
+    // rows read at a time
+    size_t BatchSize{4096};
+};
+
+struct CheckpointStats : TranslateStats
+{
+    size_t Checkpoints{};
+    // the input offset the run resumed from, 0 if it started afresh
+    size_t ResumedAt{};
+    bool Complete{false};
+};
+
+/**
+ * Translate a contacts file, checkpointing as it goes so that a run which
+ * dies can be resumed rather than restarted. Contacts are written as they
+ * are read, in input order, to <destination>.partial, deduplicated against
+ * the rows already written: a contact whose StableHash matches one of theirs
+ * is compared with those rows, read back from the partial output. Each
+ * hash, with where its row was written, is also logged to <destination>.seen.
+ * Every Interval bytes of input, both files are synced and the checkpoint
+ * is written to <destination>.checkpoint through a rename. When the input
+ * is done the partial output is renamed over the destination and the
+ * other files are removed. Sorting is not supported, as it holds back the
+ * whole output until the end.
+ */
+auto TranslateCheckpointed(const std::string& source, const std::string& destination,
+    const CheckpointOptions& = {}, const TranslateOptions& = {}) -> CheckpointStats;
+
+} // namespace app
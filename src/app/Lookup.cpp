@@ -0,0 +1,177 @@
+#include "Lookup.h"
+#include "Profile.h"
+#include "Translate.h"
+#include "contacts/PrefixIndex.h"
+
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <ranges>
+#include <string>
+#include <string_view>
+
+/******************************************************************************/
+/* Lookup *********************************************************************/
+auto app::RunLookup(const Options& options) -> int
+{
+    std::ifstream source{options.Source};
+    std::ifstream queries{options.QueryFile};
+    if (!source || !queries) {
+        std::cerr << "Cannot read " << (source ? options.QueryFile : options.Source) << std::endl;
+        return -1;
+    }
+    std::ofstream file_out;
+    if (!options.Destination.empty()) {
+        file_out.open(options.Destination);
+        if (!file_out) {
+            std::cerr << "Cannot write " << options.Destination << std::endl;
+            return -1;
+        }
+    }
+    std::ostream& ostr = options.Destination.empty() ? std::cout : file_out;
+
+    // Load the address book, as a translation would
+    const auto profiles = MakeProfileCache(options);
+    MappingCache mappings{profiles.get()};
+    auto table = fileio::CSVReader::ReadCSVTable(source, ',');
+    if (table.empty()) {
+        std::cerr << "Cannot read the header of " << options.Source << std::endl;
+        return -1;
+    }
+    const auto mapper = mappings.get(table.front());
+    const auto filter = options.Filter
+        ? std::optional<ContactFilter>{options.Filter->bind(table.front())}
+        : std::nullopt;
+    std::vector<Contact> contacts;
+    MapContacts(table.data() + 1, table.size() - 1, *mapper, filter ? &*filter : nullptr, contacts);
+    AddressBook address_book{*mapper};
+    address_book.build_index();
+    for (auto& contact : contacts) address_book.insert(std::move(contact));
+    contacts = {};
+
+    // Answer each query with one row
+    fileio::CSVStreamWriter writer{ostr};
+    std::array<std::string_view, Contact::Fields.size() + 1> cells;
+    cells[0] = "Query";
+    for (size_t j = 0; j < Contact::Fields.size(); ++j) {
+        cells[j + 1] = (mapper.get()->*ContactCSVInputMap::Mappers[j]).FieldName;
+    }
+    writer.write_row(cells);
+
+    size_t count = 0;
+    size_t found = 0;
+    std::chrono::steady_clock::duration elapsed{};
+    for (std::string line; std::getline(queries, line); ) {
+        const size_t begin = line.find_first_not_of(" \t\r");
+        if (begin == std::string::npos || line[begin] == '#') continue;
+        const auto query = std::string_view{line}.substr(begin,
+            line.find_last_not_of(" \t\r") + 1 - begin);
+
+        const auto start = std::chrono::steady_clock::now();
+        const Contact* contact = (query.find('@') != std::string_view::npos)
+            ? address_book.find_email(query)
+            : address_book.find_phone(query);
+        elapsed += std::chrono::steady_clock::now() - start;
+
+        cells[0] = query;
+        for (size_t j = 0; j < Contact::Fields.size(); ++j) {
+            cells[j + 1] = contact ? std::string_view{contact->*Contact::Fields[j]} : std::string_view{};
+        }
+        writer.write_row(cells);
+        count += 1;
+        if (contact) found += 1;
+    }
+    ostr << std::endl;
+
+    if (options.ShowStats) {
+        const auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+        std::cerr << "lookup: " << address_book.size() << " contacts, " << count << " queries, "
+            << found << " found, " << (count ? nanoseconds / count : 0) << " ns per lookup"
+            << std::endl;
+    }
+    return 0;
+}
+
+namespace
+{
+    // a row of a translated table, whose columns are Contact::Fields
+    auto table_contact(const fileio::CSVRow& row) -> Contact
+    {
+        Contact contact;
+        for (size_t j = 0; j < Contact::Fields.size() && j < row.size(); ++j) {
+            contact.*Contact::Fields[j] = row[j].str();
+        }
+        return contact;
+    }
+}
+
+auto app::WritePrefixIndex(const std::string& table_path, const std::string& index_path) -> bool
+{
+    std::ifstream table{table_path};
+    if (!table) return false;
+    fileio::CSVStreamReader reader{table, ','};
+    reader.project(fileio::CSVProjection{{0, 1, 2, 3, 4}});
+    if (reader.read(1).empty()) return false;
+
+    PrefixIndex::Builder builder;
+    uint32_t row = 0;
+    for (auto batch = reader.read(4096); !batch.empty(); batch = reader.read(4096)) {
+        for (const auto& cells : batch) builder.add(table_contact(cells), row++);
+    }
+    const auto index = builder.finish();
+
+    // written beside the table, and renamed into place when whole
+    const auto temporary = index_path + ".tmp";
+    {
+        std::ofstream file{temporary, std::ios::binary};
+        index.write(file);
+        file.close();
+        if (!file) return false;
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, index_path, error);
+    return !error;
+}
+
+auto app::RunComplete(const Options& options) -> int
+{
+    const auto index_path = options.Source + ".prefix";
+    std::ifstream index_file{index_path, std::ios::binary};
+    const auto index = index_file ? PrefixIndex::Read(index_file) : std::nullopt;
+    if (!index) {
+        std::cerr << "Cannot read prefix index " << index_path
+            << "; translate with --prefix-index to write one" << std::endl;
+        return -1;
+    }
+    std::ifstream table_file{options.Source};
+    const auto table = fileio::CSVReader::ReadCSVTable(table_file, ',');
+    if (table.empty()) {
+        std::cerr << "Cannot read " << options.Source << std::endl;
+        return -1;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const auto rows = index->complete(options.Query, options.TopK);
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    fileio::CSVStreamWriter writer{std::cout};
+    writer.write_row(table.front() | std::views::transform(&fileio::CSVCell::str));
+    for (const uint32_t row : rows) {
+        if (row + 1 >= table.size()) {
+            std::cerr << "Prefix index " << index_path << " does not match its table" << std::endl;
+            return -1;
+        }
+        writer.write_row(table[row + 1] | std::views::transform(&fileio::CSVCell::str));
+    }
+    std::cout << std::endl;
+
+    if (options.ShowStats) {
+        std::cerr << "complete: " << index->size() << " keys, " << rows.size() << " rows in "
+            << std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() << " ns"
+            << std::endl;
+    }
+    return 0;
+}
+/******************************************************************************/
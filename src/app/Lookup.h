@@ -0,0 +1,30 @@
+#pragma once
+
+#include "app/Options.h"
+
+#include <string>
+
+namespace app
+{
+
+/**
+ * Load a contacts file into an indexed address book and look up each line
+ * of a query file in it: an email address if the line has an @, else a
+ * phone number. Writes the query and the matching contact, if any, as one
+ * CSV row per query.
+ */
+auto RunLookup(const Options&) -> int;
+
+/**
+ * Build the typeahead index of a translated contacts table, whose rows are
+ * in Contact::Fields order, and write it to index_path.
+ */
+auto WritePrefixIndex(const std::string& table_path, const std::string& index_path) -> bool;
+
+/**
+ * Complete a prefix against a translated table and the index written beside
+ * it as <table>.prefix, writing the first matching rows as CSV.
+ */
+auto RunComplete(const Options&) -> int;
+
+} // namespace app
@@ -0,0 +1,344 @@
+#include "Options.h"
+
+#include <string_view>
+#include <iostream>
+
+/******************************************************************************/
+/* Options ********************************************************************/
+namespace
+{
+    auto parse_count(std::string_view str) -> std::optional<size_t>
+    {
+        if (str.empty()) return std::nullopt;
+        size_t count = 0;
+        for (char c : str) {
+            if (c < '0' || c > '9') return std::nullopt;
+            count = count * 10 + (c - '0');
+        }
+        return count;
+    }
+
+    // a byte count, with an optional K, M or G suffix
+    auto parse_size(std::string_view str) -> std::optional<size_t>
+    {
+        size_t scale = 1;
+        if (!str.empty()) {
+            switch (str.back()) {
+                case 'K': case 'k': scale = size_t{1} << 10; break;
+                case 'M': case 'm': scale = size_t{1} << 20; break;
+                case 'G': case 'g': scale = size_t{1} << 30; break;
+            }
+            if (scale != 1) str.remove_suffix(1);
+        }
+        const auto count = parse_count(str);
+        if (!count) return std::nullopt;
+        return *count * scale;
+    }
+
+    auto parse_preview(std::string_view str) -> std::optional<bits::TablePreview>
+    {
+        using Mode = bits::TablePreview::Mode;
+        if (str == "all") return bits::TablePreview{Mode::All, 0};
+
+        Mode mode = Mode::Head;
+        if (const auto colon = str.find(':'); colon != std::string_view::npos) {
+            const auto name = str.substr(0, colon);
+            if (name == "head") mode = Mode::Head;
+            else if (name == "tail") mode = Mode::Tail;
+            else if (name == "sample") mode = Mode::Sample;
+            else return std::nullopt;
+            str.remove_prefix(colon + 1);
+        }
+        const auto count = parse_count(str);
+        if (!count) return std::nullopt;
+        return bits::TablePreview{mode, *count};
+    }
+}
+
+auto app::ParseOptions(int argc, char** argv) -> std::optional<Options>
+{
+    Options options;
+    std::vector<std::string> positional;
+    // MaxMemory has a default, so whether it was asked for is kept apart
+    bool max_memory_given = false;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        if (arg == "--preview=none") {
+            options.ShowPreview = false;
+        } else if (arg.rfind("--preview=", 0) == 0) {
+            const auto preview = parse_preview(arg.substr(10));
+            if (!preview) {
+                std::cerr << "Invalid preview \"" << arg.substr(10) << "\"" << std::endl;
+                return std::nullopt;
+            }
+            options.Preview = *preview;
+            options.ShowPreview = true;
+        } else if (arg == "--arena") {
+            options.UseArena = true;
+        } else if (arg == "--stats") {
+            options.ShowStats = true;
+        } else if (arg == "--verbose") {
+            options.Verbose = true;
+        } else if (arg.rfind("--threads=", 0) == 0) {
+            const auto threads = parse_count(arg.substr(10));
+            if (!threads) {
+                std::cerr << "Invalid thread count \"" << arg.substr(10) << "\"" << std::endl;
+                return std::nullopt;
+            }
+            options.Threads = *threads;
+        } else if (arg.rfind("--chunk-size=", 0) == 0) {
+            const auto chunk_size = parse_count(arg.substr(13));
+            if (!chunk_size || *chunk_size == 0) {
+                std::cerr << "Invalid chunk size \"" << arg.substr(13) << "\"" << std::endl;
+                return std::nullopt;
+            }
+            options.ChunkSize = *chunk_size;
+        } else if (arg.rfind("--filter=", 0) == 0) {
+            std::string error;
+            options.Filter = ContactFilter::Compile(arg.substr(9), error);
+            if (!options.Filter) {
+                std::cerr << "Invalid filter \"" << arg.substr(9) << "\": " << error << std::endl;
+                return std::nullopt;
+            }
+        } else if (arg == "--sort") {
+            options.Order = SortOrder{};
+        } else if (arg.rfind("--sort=", 0) == 0) {
+            options.Order = SortOrder::Parse(arg.substr(7));
+            if (!options.Order) {
+                std::cerr << "Invalid sort keys \"" << arg.substr(7) << "\"" << std::endl;
+                return std::nullopt;
+            }
+        } else if (arg.rfind("--max-memory=", 0) == 0) {
+            const auto max_memory = parse_size(arg.substr(13));
+            if (!max_memory) {
+                std::cerr << "Invalid memory size \"" << arg.substr(13) << "\"" << std::endl;
+                return std::nullopt;
+            }
+            options.MaxMemory = *max_memory;
+            max_memory_given = true;
+        } else if (arg.rfind("--spill-dir=", 0) == 0) {
+            options.SpillDir = arg.substr(12);
+        } else if (arg == "--out-of-core") {
+            options.OutOfCore = true;
+        } else if (arg.rfind("--partitions=", 0) == 0) {
+            const auto partitions = parse_count(arg.substr(13));
+            if (!partitions || *partitions == 0) {
+                std::cerr << "Invalid partition count \"" << arg.substr(13) << "\"" << std::endl;
+                return std::nullopt;
+            }
+            options.Partitions = *partitions;
+            options.OutOfCore = true;
+        } else if (arg == "--pipeline") {
+            options.UsePipeline = true;
+        } else if (arg.rfind("--batch-size=", 0) == 0) {
+            const auto batch_size = parse_count(arg.substr(13));
+            if (!batch_size || *batch_size == 0) {
+                std::cerr << "Invalid batch size \"" << arg.substr(13) << "\"" << std::endl;
+                return std::nullopt;
+            }
+            options.BatchSize = *batch_size;
+            options.UsePipeline = true;
+        } else if (arg == "--checkpoint") {
+            options.CheckpointInterval = size_t{64} << 20;
+        } else if (arg.rfind("--checkpoint=", 0) == 0) {
+            const auto interval = parse_size(arg.substr(13));
+            if (!interval || *interval == 0) {
+                std::cerr << "Invalid checkpoint interval \"" << arg.substr(13) << "\"" << std::endl;
+                return std::nullopt;
+            }
+            options.CheckpointInterval = *interval;
+        } else if (arg == "--resume") {
+            options.Resume = true;
+        } else if (arg.rfind("--shard=", 0) == 0) {
+            const auto shard = arg.substr(8);
+            const auto slash = shard.find('/');
+            const auto index = parse_count(shard.substr(0, slash));
+            const auto count = (slash == std::string_view::npos)
+                ? std::nullopt : parse_count(shard.substr(slash + 1));
+            if (!index || !count || *index >= *count) {
+                std::cerr << "Invalid shard \"" << shard << "\", expected i/N with i < N" << std::endl;
+                return std::nullopt;
+            }
+            options.ShardIndex = *index;
+            options.ShardCount = *count;
+        } else if (arg == "--prefix-index") {
+            options.WritePrefixIndex = true;
+        } else if (arg.rfind("--quality-report=", 0) == 0) {
+            options.QualityReport = arg.substr(17);
+            if (options.QualityReport.empty()) {
+                std::cerr << "Invalid quality report path" << std::endl;
+                return std::nullopt;
+            }
+        } else if (arg.rfind("--format=", 0) == 0) {
+            const auto format = arg.substr(9);
+            if (format != "csv" && format != "arrow") {
+                std::cerr << "Invalid output format \"" << format << "\", expected csv or arrow" << std::endl;
+                return std::nullopt;
+            }
+            options.ArrowOutput = (format == "arrow");
+        } else if (arg == "--no-profiles") {
+            options.UseProfiles = false;
+        } else if (arg.rfind("--profile-dir=", 0) == 0) {
+            options.ProfileDir = arg.substr(14);
+        } else if (arg == "--by-path") {
+            options.ByPath = true;
+        } else if (arg.rfind("--", 0) == 0) {
+            std::cerr << "Unknown option \"" << arg << "\"" << std::endl;
+            return std::nullopt;
+        } else {
+            positional.emplace_back(arg);
+        }
+    }
+
+    if (options.ArrowOutput && !positional.empty()
+        && (positional[0] == "serve" || positional[0] == "client")) {
+        std::cerr << "Arrow output cannot be served" << std::endl;
+        return std::nullopt;
+    }
+    if (!positional.empty() && positional[0] == "serve") {
+        if (positional.size() != 2) return std::nullopt;
+        options.Mode = Command::Serve;
+        options.SocketPath = positional[1];
+        return options;
+    }
+    if (!positional.empty() && positional[0] == "client") {
+        if (positional.size() != 4) return std::nullopt;
+        options.Mode = Command::Client;
+        options.SocketPath = positional[1];
+        options.Source = positional[2];
+        options.Destination = positional[3];
+        return options;
+    }
+    if (!positional.empty() && positional[0] == "batch") {
+        if (positional.size() != 2 && positional.size() != 3) return std::nullopt;
+        options.Mode = Command::Batch;
+        options.Source = positional[1];
+        if (positional.size() == 3) options.Destination = positional[2];
+        return options;
+    }
+
+    if (!positional.empty() && positional[0] == "lookup") {
+        if (positional.size() != 3 && positional.size() != 4) return std::nullopt;
+        options.Mode = Command::Lookup;
+        options.Source = positional[1];
+        options.QueryFile = positional[2];
+        if (positional.size() == 4) options.Destination = positional[3];
+        return options;
+    }
+
+    if (!positional.empty() && positional[0] == "complete") {
+        if (positional.size() != 3 && positional.size() != 4) return std::nullopt;
+        options.Mode = Command::Complete;
+        options.Source = positional[1];
+        options.Query = positional[2];
+        if (positional.size() == 4) {
+            const auto k = parse_count(positional[3]);
+            if (!k) return std::nullopt;
+            options.TopK = *k;
+        }
+        return options;
+    }
+
+    if (!positional.empty() && positional[0] == "merge") {
+        if (positional.size() < 3) return std::nullopt;
+        options.Mode = Command::Merge;
+        options.Destination = positional[1];
+        options.Partials.assign(positional.begin() + 2, positional.end());
+        return options;
+    }
+
+    if (!positional.empty() && positional[0] == "profile") {
+        if (positional.size() < 3) return std::nullopt;
+        options.Mode = Command::Profile;
+        options.ProfileAction = positional[1];
+        options.Source = positional[2];
+        options.ProfileEdits.assign(positional.begin() + 3, positional.end());
+        if (options.ProfileAction == "show" && options.ProfileEdits.empty()) return options;
+        if (options.ProfileAction == "pin" && !options.ProfileEdits.empty()) return options;
+        return std::nullopt;
+    }
+
+    if (options.Resume && options.CheckpointInterval == 0) {
+        options.CheckpointInterval = size_t{64} << 20;
+    }
+    if (options.CheckpointInterval != 0 && (options.Order || options.OutOfCore)) {
+        std::cerr << "Checkpoints cannot be combined with --sort or --out-of-core" << std::endl;
+        return std::nullopt;
+    }
+    if (options.ShardCount != 0 && (options.CheckpointInterval != 0 || options.OutOfCore)) {
+        std::cerr << "Shards cannot be combined with --checkpoint or --out-of-core" << std::endl;
+        return std::nullopt;
+    }
+
+    // the arena never frees, so it cannot keep to any bound on memory
+    if (options.UseArena && (max_memory_given || options.OutOfCore || options.CheckpointInterval != 0)) {
+        std::cerr << "--arena cannot be combined with --max-memory, --out-of-core or --checkpoint"
+            << std::endl;
+        return std::nullopt;
+    }
+
+    if (options.ArrowOutput && (options.CheckpointInterval != 0 || options.ShardCount != 0
+        || options.OutOfCore || options.WritePrefixIndex))
+    {
+        std::cerr << "Arrow output cannot be combined with --checkpoint, --shard, --out-of-core"
+            " or --prefix-index" << std::endl;
+        return std::nullopt;
+    }
+
+    if (positional.size() != 2) return std::nullopt;
+    options.Source = positional[0];
+    options.Destination = positional[1];
+    return options;
+}
+
+void app::PrintUsage(std::ostream& ostr, const char* program)
+{
+    ostr << "Usage: " << program << " [options] <source.csv> <destination.csv>\n"
+        << "       " << program << " [options] serve <socket>\n"
+        << "       " << program << " [options] client <socket> <source.csv> <destination.csv>\n"
+        << "       " << program << " [options] batch <directory|manifest> [output directory]\n"
+        << "       " << program << " [options] lookup <source.csv> <queries.txt> [results.csv]\n"
+        << "       " << program << " [options] complete <destination.csv> <prefix> [k]\n"
+        << "       " << program << " [options] merge <destination.csv> <partial.csv>...\n"
+        << "       " << program << " [options] profile show <source.csv>\n"
+        << "       " << program << " [options] profile pin <source.csv> <Field>=<column|none|compose>...\n"
+        << "\n"
+        << "Options:\n"
+        << "  --preview=N         show the first N rows of each table (default 20)\n"
+        << "  --preview=MODE:N    MODE is one of head, tail or sample\n"
+        << "  --preview=all|none  show every row, or no rows\n"
+        << "  --arena             allocate tables from one arena, released at exit; it never\n"
+        << "                      frees, so not with --max-memory, --out-of-core or --checkpoint\n"
+        << "  --stats             report allocation statistics to stderr\n"
+        << "  --verbose           report the columns matched to each field to stderr\n"
+        << "  --threads=N         worker threads for serve, batch and sorting (default: one per core)\n"
+        << "  --chunk-size=BYTES  split batch files into tasks of this size (default 4 MiB)\n"
+        << "  --filter=EXPR       translate only the contacts selected, for example\n"
+        << "                      'domain(email1, \"example.com\") and not empty(mobile)'\n"
+        << "  --sort[=KEYS]       sort contacts by keys among last, first, display and email\n"
+        << "                      (default last,first,email) instead of writing them as stored\n"
+        << "  --max-memory=BYTES  memory for sorting and out-of-core partitions (default 1G)\n"
+        << "  --spill-dir=DIR     where runs and partitions spill (default: the temporary directory)\n"
+        << "  --out-of-core       deduplicate inputs larger than memory through spilled partitions\n"
+        << "  --partitions=N      spill partitions for --out-of-core (default: enough to fit)\n"
+        << "  --pipeline          translate in overlapping read, map, format, dedup and write stages\n"
+        << "  --batch-size=ROWS   rows handed between pipeline stages at a time (default 4096)\n"
+        << "  --checkpoint[=BYTES] checkpoint every BYTES of input (default 64M), writing\n"
+        << "                      <destination>.partial until the translation is done\n"
+        << "  --resume            continue from the checkpoint of an earlier run, if any\n"
+        << "  --shard=I/N         translate only shard I of N, by contact hash, to a sorted\n"
+        << "                      partial output and <destination>.shard, for merge\n"
+        << "  --prefix-index      write a typeahead index of the output to <destination>.prefix\n"
+        << "  --quality-report=FILE write fill rates, validity, distinct counts and top email\n"
+        << "                      domains of the contacts written to FILE as JSON\n"
+        << "  --format=csv|arrow  write the destination as CSV (default) or as an Arrow IPC\n"
+        << "                      (Feather v2) file of string columns, for dataframe libraries\n"
+        << "  --by-path           client sends the source path instead of its bytes\n"
+        << "  --profile-dir=DIR   where header mapping profiles are cached\n"
+        << "  --no-profiles       always run the header heuristics, caching nothing\n"
+        << "\n"
+        << "Previews are only shown when stdout is a terminal, unless requested. Sorted\n"
+        << "output is never held whole, so its previews show the head of each table.\n";
+}
+/******************************************************************************/
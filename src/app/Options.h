@@ -0,0 +1,107 @@
+#pragma once
+
+#include "bits/table_view.h"
+#include "contacts/ContactSort.h"
+#include "contacts/ContactFilter.h"
+
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace app
+{
+
+enum class Command
+{
+    Translate,  // translate <source> <destination>
+    Serve,      // serve <socket>
+    Client,     // client <socket> <source> <destination>
+    Batch,      // batch <directory|manifest> [output directory]
+    Profile,    // profile show <source> | profile pin <source> <field>=<column>...
+    Lookup,     // lookup <source> <queries> [results]
+    Complete,   // complete <table> <prefix> [k]
+    Merge,      // merge <destination> <partial>...
+};
+
+struct Options
+{
+    Command Mode{Command::Translate};
+    std::string Source{};
+    std::string Destination{};
+    std::string SocketPath{};
+    // the email addresses and phone numbers to look up, one per line
+    std::string QueryFile{};
+    // the prefix to complete, and how many rows to complete it with
+    std::string Query{};
+    size_t TopK{10};
+    // the partial outputs of sharded translations to merge
+    std::vector<std::string> Partials{};
+
+    // console previews of the input and output tables; when unset, previews
+    // are only shown if stdout is a terminal
+    bits::TablePreview Preview{bits::TablePreview::Mode::Head, 20};
+    std::optional<bool> ShowPreview{};
+
+    // allocate the whole run from one monotonic arena, released at exit
+    bool UseArena{false};
+    // report run statistics to stderr
+    bool ShowStats{false};
+    // report the columns the header heuristics match to stderr
+    bool Verbose{false};
+
+    // worker threads, 0 for one per hardware thread
+    size_t Threads{0};
+    // send the client's source as a path rather than as inline bytes
+    bool ByPath{false};
+    // bytes of input per batch task when a file is split into chunks
+    size_t ChunkSize{4 << 20};
+
+    // translate only the contacts this selects
+    std::optional<ContactFilter> Filter{};
+
+    // write contacts sorted by these keys, sorting externally in runs of at
+    // most MaxMemory bytes spilled to SpillDir
+    std::optional<SortOrder> Order{};
+    size_t MaxMemory{size_t{1} << 30};
+    std::string SpillDir{};
+
+    // deduplicate through hash partitions spilled to SpillDir, holding only
+    // as many partitions in memory as fit in MaxMemory
+    bool OutOfCore{false};
+    size_t Partitions{0};
+
+    // translate as a pipeline of stage threads, handing rows on in batches
+    bool UsePipeline{false};
+    size_t BatchSize{4096};
+
+    // checkpoint every CheckpointInterval bytes of input, 0 for never, so
+    // that a run which dies can be resumed
+    size_t CheckpointInterval{0};
+    bool Resume{false};
+
+    // translate only shard ShardIndex of ShardCount, by contact hash, into a
+    // sorted partial output for a later merge; a ShardCount of 0 for no shards
+    size_t ShardIndex{0};
+    size_t ShardCount{0};
+
+    // write a typeahead index of the output beside it, as <destination>.prefix
+    bool WritePrefixIndex{false};
+
+    // write a JSON report of the quality of the contacts written to this path
+    std::string QualityReport{};
+
+    // write the destination as an Arrow IPC file rather than as CSV
+    bool ArrowOutput{false};
+
+    // cache header mappings on disk, in ProfileDir or the default directory
+    bool UseProfiles{true};
+    std::string ProfileDir{};
+    std::string ProfileAction{};
+    std::vector<std::string> ProfileEdits{};
+};
+
+auto ParseOptions(int argc, char** argv) -> std::optional<Options>;
+void PrintUsage(std::ostream&, const char* program);
+
+} // namespace app
@@ -0,0 +1,193 @@
+#include "OutOfCore.h"
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+/******************************************************************************/
+/* TranslateOutOfCore *********************************************************/
+namespace
+{
+    namespace fs = std::filesystem;
+
+    // a contact in memory takes about this many times its spilled size,
+    // counting the hash set that deduplicates it
+    constexpr size_t MemoryPerSpilledByte = 3;
+    constexpr size_t MaxPartitions = 4096;
+    // file descriptors left for the input, the output and the rest of the
+    // process while every partition is open
+    constexpr size_t ReservedFiles = 64;
+
+    // every partition is open at once, so there can be no more of them than
+    // the process may open files
+    auto max_partitions() -> size_t
+    {
+        rlimit limit{};
+        if (getrlimit(RLIMIT_NOFILE, &limit) != 0 || limit.rlim_cur == RLIM_INFINITY) {
+            return MaxPartitions;
+        }
+        const auto files = static_cast<size_t>(limit.rlim_cur);
+        const size_t reserved = std::min(ReservedFiles, files / 2);
+        return std::clamp<size_t>(files - reserved, 1, MaxPartitions);
+    }
+
+    auto choose_partitions(const app::OutOfCoreOptions& options, size_t max_memory,
+        size_t workers) -> size_t
+    {
+        const size_t limit = max_partitions();
+        if (options.Partitions != 0) return std::min(options.Partitions, limit);
+        if (max_memory == 0) return std::min(workers, limit);
+        if (options.InputBytes == 0) return std::min(std::max<size_t>(workers, 64), limit);
+        const size_t needed = options.InputBytes * MemoryPerSpilledByte * workers;
+        return std::min(std::max((needed + max_memory - 1) / max_memory, workers), limit);
+    }
+
+    /**
+     * The spill files of one run, removed when it ends.
+     */
+    class SpillFiles
+    {
+    public:
+        SpillFiles(const std::string& dir, size_t count)
+        {
+            static std::atomic<size_t> s_NextRun{0};
+            const fs::path base = dir.empty() ? fs::temp_directory_path() : fs::path{dir};
+            const auto prefix = "contacts-part-" + std::to_string(getpid())
+                + "-" + std::to_string(s_NextRun++) + "-";
+            for (size_t k = 0; k < count; ++k) {
+                m_Paths.push_back((base / (prefix + std::to_string(k) + ".part")).string());
+                m_Paths.push_back((base / (prefix + std::to_string(k) + ".out")).string());
+            }
+        }
+        ~SpillFiles()
+        {
+            std::error_code error;
+            for (const auto& path : m_Paths) fs::remove(path, error);
+        }
+
+        inline auto& partition(size_t k) const { return m_Paths[2 * k]; }
+        inline auto& result(size_t k) const { return m_Paths[2 * k + 1]; }
+
+    private:
+        std::vector<std::string> m_Paths{};
+    };
+}
+
+auto app::TranslateOutOfCore(std::istream& istr, std::ostream& ostr, util::ThreadPool& pool,
+    const OutOfCoreOptions& out_of_core, const TranslateOptions& options) -> OutOfCoreStats
+{
+    OutOfCoreStats stats;
+
+    fileio::CSVStreamReader reader{istr, options.Delimiter};
+    const auto header = reader.read(1);
+    if (header.empty()) return stats;
+
+    std::shared_ptr<const ContactCSVInputMap> mapper = options.Mappings
+        ? options.Mappings->get(header.front())
+        : std::make_shared<const ContactCSVInputMap>(header.front());
+
+    // the calling thread helps run the partition tasks
+    const size_t workers = pool.size() + 1;
+    stats.Partitions = choose_partitions(out_of_core, options.MaxMemory, workers);
+    const SpillFiles files{options.SpillDir, stats.Partitions};
+
+    // Partition every contact by its hash, in one pass over the input
+    size_t mapped = 0;
+    {
+        std::vector<std::ofstream> partitions(stats.Partitions);
+        for (size_t k = 0; k < stats.Partitions; ++k) {
+            partitions[k].open(files.partition(k), std::ios::binary);
+            if (!partitions[k]) {
+                std::cerr << "Cannot create spill file " << files.partition(k) << std::endl;
+                // closed before they are removed with the rest of the run
+                for (size_t i = 0; i < k; ++i) partitions[i].close();
+                return stats;
+            }
+        }
+        const auto filter = options.Filter
+            ? std::optional<ContactFilter>{options.Filter->bind(header.front())}
+            : std::nullopt;
+        const ProjectedMapping projected{*mapper, filter ? &*filter : nullptr};
+        reader.project(projected.Projection);
+        const size_t batch_size = std::max<size_t>(out_of_core.BatchSize, 1);
+        std::vector<Contact> contacts;
+        for (auto batch = reader.read(batch_size); !batch.empty(); batch = reader.read(batch_size)) {
+            contacts.clear();
+            MapContacts(batch.data(), batch.size(), projected.Mapper, projected.filter(), contacts);
+            for (const auto& contact : contacts) {
+                auto& partition = partitions[StableHash(contact) % stats.Partitions];
+                WriteContactRecord(partition, contact);
+            }
+            mapped += contacts.size();
+        }
+        for (auto& partition : partitions) {
+            stats.SpilledBytes += static_cast<size_t>(partition.tellp());
+            partition.close();
+            if (!partition) {
+                std::cerr << "Cannot write spill files to " << options.SpillDir << std::endl;
+                return stats;
+            }
+        }
+    }
+    stats.RowsIn = reader.rows_read() - 1;
+
+    // Deduplicate each partition on its own, spilling the unique contacts
+    std::vector<size_t> unique(stats.Partitions);
+    std::atomic<bool> failed{false};
+    util::TaskGroup group;
+    for (size_t k = 0; k < stats.Partitions; ++k) {
+        pool.submit(group, [&, k]() {
+            std::ifstream partition{files.partition(k), std::ios::binary};
+            AddressBook address_book{*mapper};
+            for (Contact contact; ReadContactRecord(partition, contact); contact = Contact{}) {
+                address_book.insert(std::move(contact));
+            }
+            partition.close();
+            std::error_code error;
+            fs::remove(files.partition(k), error);
+
+            std::ofstream result{files.result(k), std::ios::binary};
+            for (size_t i = 0; i < address_book.size(); ++i) {
+                WriteContactRecord(result, address_book[i]);
+            }
+            result.close();
+            if (!result) failed = true;
+            unique[k] = address_book.size();
+        });
+    }
+    pool.wait(group);
+    if (failed) {
+        std::cerr << "Cannot write spill files to " << options.SpillDir << std::endl;
+        return stats;
+    }
+
+    // Concatenate the partitions, or merge them into sorted order
+    fileio::CSVStreamWriter writer{ostr};
+    WriteContactHeader(writer, *mapper);
+    std::unique_ptr<ContactSorter> sorter;
+    if (options.Order) {
+        sorter = std::make_unique<ContactSorter>(*options.Order, options.MaxMemory,
+            options.SpillDir, &pool);
+    }
+    for (size_t k = 0; k < stats.Partitions; ++k) {
+        std::ifstream result{files.result(k), std::ios::binary};
+        for (Contact contact; ReadContactRecord(result, contact); ) {
+            if (options.Stats) options.Stats->add(contact);
+            if (sorter) sorter->add(std::move(contact));
+            else WriteContact(writer, contact);
+        }
+        stats.RowsOut += unique[k];
+    }
+    if (sorter) sorter->merge([&](const Contact& contact) { WriteContact(writer, contact); });
+    if (options.Stats) options.Stats->add_duplicates(mapped - stats.RowsOut);
+    return stats;
+}
+/******************************************************************************/
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "app/Translate.h"
+#include "util/thread_pool.h"
+
+#include <istream>
+#include <ostream>
+
+namespace app
+{
+
+struct OutOfCoreOptions
+{
+    // spill partitions, or 0 to choose enough to fit MaxMemory; either way
+    // no more than the process may have open files
+    size_t Partitions{0};
+    // the size of the input, when known, for choosing the partition count
+    size_t InputBytes{0};
+    // rows read at a time
+    size_t BatchSize{4096};
+};
+
+struct OutOfCoreStats : TranslateStats
+{
+    size_t Partitions{};
+    size_t SpilledBytes{};
+};
+
+/**
+ * Translate a contacts table that may not fit in memory. One streaming pass
+ * maps and formats each row and appends the contact to one of N spill files
+ * chosen by its hash, so that duplicates always share a partition. The
+ * partitions are then deduplicated independently as tasks on the pool and
+ * concatenated, so only as many partitions as the pool has workers are ever
+ * held in memory. The spill files go in the options' SpillDir.
+ */
+auto TranslateOutOfCore(std::istream&, std::ostream&, util::ThreadPool&,
+    const OutOfCoreOptions& = {}, const TranslateOptions& = {}) -> OutOfCoreStats;
+
+} // namespace app
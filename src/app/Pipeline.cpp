@@ -0,0 +1,194 @@
+#include "Pipeline.h"
+
+#include "util/bounded_queue.h"
+
+#include <array>
+#include <iomanip>
+#include <thread>
+
+/******************************************************************************/
+/* TranslatePipelined *********************************************************/
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    // Pops batches until the input queue is closed and drained, pushing the
+    // transformed batches on, then closes the output queue behind them
+    template <typename In, typename Out, typename Transform>
+    void run_stage(app::StageMetrics& metrics, util::BoundedQueue<In>& in,
+        util::BoundedQueue<Out>& out, Transform transform)
+    {
+        const auto start = Clock::now();
+        while (auto batch = in.pop()) {
+            metrics.Batches += 1;
+            metrics.Items += batch->size();
+            if (!out.push(transform(std::move(*batch)))) break;
+        }
+        out.close();
+        metrics.Starved = in.pop_wait();
+        metrics.Blocked = out.push_wait();
+        metrics.MaxQueueDepth = out.max_depth();
+        metrics.Busy = Clock::now() - start - metrics.Starved - metrics.Blocked;
+    }
+}
+
+auto app::TranslatePipelined(std::istream& istr, std::ostream& ostr,
+    const PipelineOptions& pipeline, const TranslateOptions& options) -> PipelineStats
+{
+    PipelineStats stats;
+    const auto start = Clock::now();
+
+    fileio::CSVStreamReader reader{istr, options.Delimiter};
+    const auto header = reader.read(1);
+    if (header.empty()) return stats;
+
+    std::shared_ptr<const ContactCSVInputMap> mapper = options.Mappings
+        ? options.Mappings->get(header.front())
+        : std::make_shared<const ContactCSVInputMap>(header.front());
+    AddressBook address_book{*mapper};
+    // sorted output is deduplicated as it is merged, so the dedup stage
+    // sorts instead of building the book, within MaxMemory as in Translate
+    std::optional<ContactSorter> sorter;
+    if (options.Order) sorter.emplace(*options.Order, options.MaxMemory, options.SpillDir, options.Pool);
+    size_t mapped = 0;
+
+    // A raw filter selects rows as they are mapped; any other filter needs
+    // formatted contacts, so then the map stage formats and selects as well
+    const auto filter = options.Filter
+        ? std::optional<ContactFilter>{options.Filter->bind(header.front())}
+        : std::nullopt;
+    const bool map_formats = filter && !filter->raw_only();
+    const ProjectedMapping projected{*mapper, filter ? &*filter : nullptr};
+    reader.project(projected.Projection);
+
+    const size_t batch_size = std::max<size_t>(pipeline.BatchSize, 1);
+    util::BoundedQueue<fileio::CSVTable> read_queue{pipeline.QueueCapacity};
+    util::BoundedQueue<std::vector<Contact>> map_queue{pipeline.QueueCapacity};
+    util::BoundedQueue<std::vector<Contact>> format_queue{pipeline.QueueCapacity};
+    util::BoundedQueue<std::vector<const Contact*>> dedup_queue{pipeline.QueueCapacity};
+
+    for (const char* name : {"read", "map", "format", "dedup", "write"}) {
+        stats.Stages.push_back(StageMetrics{name});
+    }
+    auto& read = stats.Stages[0];
+    auto& map = stats.Stages[1];
+    auto& format = stats.Stages[2];
+    auto& dedup = stats.Stages[3];
+    auto& write = stats.Stages[4];
+
+    std::array<std::thread, 5> threads;
+    threads[0] = std::thread{[&]() {
+        const auto begin = Clock::now();
+        for (auto batch = reader.read(batch_size); !batch.empty(); batch = reader.read(batch_size)) {
+            read.Batches += 1;
+            read.Items += batch.size();
+            if (!read_queue.push(std::move(batch))) break;
+        }
+        read_queue.close();
+        read.Blocked = read_queue.push_wait();
+        read.MaxQueueDepth = read_queue.max_depth();
+        read.Busy = Clock::now() - begin - read.Blocked;
+    }};
+    threads[1] = std::thread{[&]() {
+        run_stage(map, read_queue, map_queue, [&](fileio::CSVTable table) {
+            std::vector<Contact> contacts;
+            if (map_formats) {
+                MapContacts(table.data(), table.size(), projected.Mapper, projected.filter(), contacts);
+                return contacts;
+            }
+            const auto selection = projected.Filter
+                ? projected.Filter->select(table.data(), table.size())
+                : Selection{table.size(), true};
+            contacts.reserve(selection.count());
+            for (size_t i = 0; i < table.size(); ++i) {
+                if (selection.test(i)) contacts.emplace_back(std::move(table[i]), projected.Mapper);
+            }
+            return contacts;
+        });
+    }};
+    threads[2] = std::thread{[&]() {
+        run_stage(format, map_queue, format_queue, [&](std::vector<Contact> contacts) {
+            if (!map_formats) for (auto& contact : contacts) contact.format();
+            return contacts;
+        });
+    }};
+    threads[3] = std::thread{[&]() {
+        // contacts are stable once inserted, so the writer may read them
+        // while later batches are still being deduplicated
+        run_stage(dedup, format_queue, dedup_queue, [&](std::vector<Contact> contacts) {
+            std::vector<const Contact*> inserted;
+            if (sorter) {
+                for (auto& contact : contacts) sorter->add(std::move(contact));
+                mapped += contacts.size();
+                return inserted;
+            }
+            for (auto& contact : contacts) {
+                if (address_book.insert(std::move(contact))) {
+                    inserted.push_back(&address_book[address_book.size() - 1]);
+                    if (options.Stats) options.Stats->add(*inserted.back());
+                } else if (options.Stats) {
+                    options.Stats->add_duplicates();
+                }
+            }
+            return inserted;
+        });
+    }};
+    threads[4] = std::thread{[&]() {
+        const auto begin = Clock::now();
+        // sorted output has to wait for the last contact
+        if (sorter) {
+            while (auto batch = dedup_queue.pop()) write.Batches += 1;
+            write.Starved = dedup_queue.pop_wait();
+            write.Items = WriteSorted(*sorter, *mapper, ostr, options, mapped);
+            write.Busy = Clock::now() - begin - write.Starved;
+            return;
+        }
+        fileio::CSVStreamWriter writer{ostr};
+        std::optional<fileio::ArrowFileWriter> arrow_writer;
+        if (options.ArrowOutput) arrow_writer.emplace(ostr, ContactColumnNames(*mapper));
+        else WriteContactHeader(writer, *mapper);
+        while (auto batch = dedup_queue.pop()) {
+            write.Batches += 1;
+            write.Items += batch->size();
+            for (const Contact* contact : *batch) {
+                if (arrow_writer) WriteContact(*arrow_writer, *contact);
+                else WriteContact(writer, *contact);
+            }
+        }
+        write.Starved = dedup_queue.pop_wait();
+        if (arrow_writer) arrow_writer->close();
+        write.Busy = Clock::now() - begin - write.Starved;
+    }};
+    for (auto& thread : threads) thread.join();
+
+    stats.RowsIn = reader.rows_read() - 1;
+    stats.RowsOut = sorter ? write.Items : address_book.size();
+    stats.Elapsed = Clock::now() - start;
+    // sorted output is previewed as it is written
+    if (options.PreviewStream && !sorter) {
+        address_book.print(*options.PreviewStream, options.Preview);
+        *options.PreviewStream << std::endl;
+    }
+    return stats;
+}
+
+void app::PrintPipelineStats(std::ostream& ostr, const PipelineStats& stats)
+{
+    const auto ms = [](Clock::duration duration) {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    };
+    ostr << "pipeline: " << stats.RowsIn << " rows in, " << stats.RowsOut << " rows out, "
+        << std::fixed << std::setprecision(1) << ms(stats.Elapsed) << " ms\n";
+    for (const auto& stage : stats.Stages) {
+        ostr << "  " << std::left << std::setw(7) << stage.Name << std::right
+            << " batches " << std::setw(6) << stage.Batches
+            << "  items " << std::setw(9) << stage.Items
+            << "  busy " << std::setw(9) << ms(stage.Busy) << " ms"
+            << "  starved " << std::setw(9) << ms(stage.Starved) << " ms"
+            << "  blocked " << std::setw(9) << ms(stage.Blocked) << " ms";
+        if (&stage != &stats.Stages.back()) ostr << "  queue peak " << stage.MaxQueueDepth;
+        ostr << "\n";
+    }
+    ostr << std::defaultfloat;
+}
+/******************************************************************************/
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "app/Translate.h"
+
+#include <chrono>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace app
+{
+
+struct PipelineOptions
+{
+    // rows handed between stages at a time
+    size_t BatchSize{4096};
+    // batches each queue between two stages may hold before its producer waits
+    size_t QueueCapacity{4};
+};
+
+/**
+ * How one stage of the pipeline spent its time. A stage is starved while it
+ * waits on an empty input queue, and blocked while it waits on a full output
+ * queue; a stage that is often blocked is running ahead of the next one.
+ */
+struct StageMetrics
+{
+    std::string Name{};
+    size_t Batches{};
+    size_t Items{};
+    std::chrono::steady_clock::duration Busy{};
+    std::chrono::steady_clock::duration Starved{};
+    std::chrono::steady_clock::duration Blocked{};
+    // the deepest the stage's output queue got, in batches
+    size_t MaxQueueDepth{};
+};
+
+struct PipelineStats : TranslateStats
+{
+    std::vector<StageMetrics> Stages{};
+    std::chrono::steady_clock::duration Elapsed{};
+};
+
+/**
+ * Translate one contacts table as a pipeline of read, map, format, dedup and
+ * write stages, each on its own thread and connected by bounded queues, so
+ * that reading, transforming and writing overlap and memory stays bounded by
+ * the batches in flight plus the deduplicated contacts. Contacts are written
+ * in the order they were first seen; sorted output is sorted externally
+ * within MaxMemory instead, as by Translate.
+ */
+auto TranslatePipelined(std::istream&, std::ostream&, const PipelineOptions& = {},
+    const TranslateOptions& = {}) -> PipelineStats;
+
+void PrintPipelineStats(std::ostream&, const PipelineStats&);
+
+} // namespace app
@@ -0,0 +1,58 @@
+#include "Profile.h"
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+/******************************************************************************/
+/* Profile ********************************************************************/
+auto app::MakeProfileCache(const Options& options) -> std::unique_ptr<ProfileCache>
+{
+    if (!options.UseProfiles) return nullptr;
+    return std::make_unique<ProfileCache>(options.ProfileDir.empty()
+        ? ProfileCache::DefaultDirectory() : std::filesystem::path{options.ProfileDir});
+}
+
+auto app::RunProfile(const Options& options) -> int
+{
+    auto profiles = MakeProfileCache(options);
+    if (!profiles) {
+        std::cerr << "Profiles are disabled" << std::endl;
+        return -1;
+    }
+
+    // read as a translation reads it, so that a CRLF or quoted multi-line
+    // header has the same fingerprint here as there
+    std::ifstream file{options.Source};
+    const auto header_table = file
+        ? fileio::CSVStreamReader{file, ','}.read(1)
+        : fileio::CSVTable{};
+    if (header_table.empty()) {
+        std::cerr << "Cannot read the header of " << options.Source << std::endl;
+        return -1;
+    }
+    const auto& header = header_table.front();
+    auto profile = profiles->resolve(header);
+
+    if (options.ProfileAction == "pin") {
+        for (const auto& edit : options.ProfileEdits) {
+            const auto equals = edit.find('=');
+            if (equals == std::string::npos
+                || !profile.set_field(edit.substr(0, equals), edit.substr(equals + 1)))
+            {
+                std::cerr << "Cannot apply \"" << edit << "\"; expected <Field>=<column>" << std::endl;
+                return -1;
+            }
+        }
+        profile.Pinned = true;
+        if (!profiles->store(profile)) {
+            std::cerr << "Cannot write " << profiles->path(profile.HeaderFingerprint).string() << std::endl;
+            return -1;
+        }
+    }
+
+    std::cout << "# " << profiles->path(profile.HeaderFingerprint).string() << "\n";
+    profile.write(std::cout);
+    return 0;
+}
+/******************************************************************************/
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "app/Options.h"
+#include "contacts/MappingProfile.h"
+
+#include <memory>
+
+namespace app
+{
+
+/**
+ * The profile cache selected by the options, or nullptr with --no-profiles.
+ */
+auto MakeProfileCache(const Options&) -> std::unique_ptr<ProfileCache>;
+
+/**
+ * Show the mapping profile for a file's header layout, or pin fields of it.
+ */
+auto RunProfile(const Options&) -> int;
+
+} // namespace app
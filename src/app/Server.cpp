@@ -0,0 +1,441 @@
+#include "Server.h"
+#include "Translate.h"
+#include "Profile.h"
+#include "util/thread_pool.h"
+
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <unordered_map>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/******************************************************************************/
+/* Socket I/O *****************************************************************/
+namespace
+{
+    std::atomic<bool> g_Stopping{false};
+
+    void handle_stop_signal(int)
+    {
+        g_Stopping = true;
+    }
+
+    auto make_address(const std::string& path, sockaddr_un& address) -> bool
+    {
+        std::memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path)) return false;
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        return true;
+    }
+
+    auto write_all(int fd, const char* data, size_t size) -> bool
+    {
+        while (size > 0) {
+            const ssize_t written = ::send(fd, data, size, MSG_NOSIGNAL);
+            if (written < 0 && errno == EINTR) continue;
+            if (written <= 0) return false;
+            data += written;
+            size -= static_cast<size_t>(written);
+        }
+        return true;
+    }
+
+    auto write_all(int fd, const std::string& str) -> bool
+    {
+        return write_all(fd, str.data(), str.size());
+    }
+
+    /**
+     * Buffered reads of lines and fixed-size blocks from a socket. Given an
+     * idle timeout, a read fails once no data has arrived for that long, or
+     * as soon as the server is stopping and no data is waiting.
+     */
+    class SocketReader
+    {
+    public:
+        explicit SocketReader(int fd, std::chrono::milliseconds idle_timeout = {})
+            : m_Fd{fd}
+            , m_IdleTimeout{idle_timeout}
+        {
+        }
+
+        auto read_line(std::string& line) -> bool
+        {
+            for (;;) {
+                const auto newline = m_Buffer.find('\n', m_Offset);
+                if (newline != std::string::npos) {
+                    line.assign(m_Buffer, m_Offset, newline - m_Offset);
+                    m_Offset = newline + 1;
+                    return true;
+                }
+                if (!fill()) return false;
+            }
+        }
+
+        auto read_bytes(std::string& bytes, size_t size) -> bool
+        {
+            while (m_Buffer.size() - m_Offset < size) {
+                if (!fill()) return false;
+            }
+            bytes.assign(m_Buffer, m_Offset, size);
+            m_Offset += size;
+            return true;
+        }
+
+    private:
+        auto fill() -> bool
+        {
+            m_Buffer.erase(0, m_Offset);
+            m_Offset = 0;
+            if (m_IdleTimeout.count() > 0 && !wait_readable()) return false;
+            char chunk[1 << 16];
+            for (;;) {
+                const ssize_t count = ::recv(m_Fd, chunk, sizeof(chunk), 0);
+                if (count < 0 && errno == EINTR) continue;
+                if (count <= 0) return false;
+                m_Buffer.append(chunk, static_cast<size_t>(count));
+                return true;
+            }
+        }
+
+        // wait in short slices, so that stopping is noticed promptly
+        auto wait_readable() const -> bool
+        {
+            constexpr std::chrono::milliseconds Slice{200};
+            const auto deadline = std::chrono::steady_clock::now() + m_IdleTimeout;
+            for (;;) {
+                pollfd poll_fd{m_Fd, POLLIN, 0};
+                const int ready = ::poll(&poll_fd, 1, static_cast<int>(Slice.count()));
+                if (ready > 0) return true;
+                if (ready < 0 && errno != EINTR) return false;
+                if (g_Stopping || std::chrono::steady_clock::now() >= deadline) return false;
+            }
+        }
+
+        int m_Fd;
+        std::chrono::milliseconds m_IdleTimeout;
+        std::string m_Buffer{};
+        size_t m_Offset{};
+    };
+
+    /**
+     * An output stream buffer that frames everything written to it as
+     * length-prefixed chunks on a socket.
+     */
+    class ChunkedSocketBuf : public std::streambuf
+    {
+    public:
+        explicit ChunkedSocketBuf(int fd)
+            : m_Fd{fd}
+            , m_Buffer(1 << 16)
+        {
+            setp(m_Buffer.data(), m_Buffer.data() + m_Buffer.size());
+        }
+
+        inline auto ok() const { return m_Ok; }
+
+    protected:
+        int_type overflow(int_type c) override
+        {
+            if (!flush_chunk()) return traits_type::eof();
+            if (!traits_type::eq_int_type(c, traits_type::eof())) {
+                *pptr() = traits_type::to_char_type(c);
+                pbump(1);
+            }
+            return traits_type::not_eof(c);
+        }
+
+        int sync() override
+        {
+            return flush_chunk() ? 0 : -1;
+        }
+
+    private:
+        auto flush_chunk() -> bool
+        {
+            const size_t size = static_cast<size_t>(pptr() - pbase());
+            if (size == 0) return m_Ok;
+            m_Ok = m_Ok && write_all(m_Fd, std::to_string(size) + "\n")
+                && write_all(m_Fd, pbase(), size);
+            setp(m_Buffer.data(), m_Buffer.data() + m_Buffer.size());
+            return m_Ok;
+        }
+
+        int m_Fd;
+        std::vector<char> m_Buffer;
+        bool m_Ok{true};
+    };
+
+    // the largest inline input a job may send, and the largest chunk a client
+    // accepts, so that a bad length cannot exhaust memory
+    constexpr size_t MaxContentLength = size_t{1} << 30;
+    constexpr size_t MaxChunkSize = size_t{1} << 24;
+    // how long the server waits on a client that sends nothing, so that an
+    // idle connection cannot hold a worker forever
+    constexpr std::chrono::milliseconds IdleTimeout{std::chrono::seconds{30}};
+
+    auto parse_length(std::string_view value, size_t max, size_t& length) -> bool
+    {
+        const char* end = value.data() + value.size();
+        const auto [last, error] = std::from_chars(value.data(), end, length);
+        return !value.empty() && error == std::errc{} && last == end && length <= max;
+    }
+
+    auto parse_delimiter(const std::string& value, char& delimiter) -> bool
+    {
+        if (value == "tab") delimiter = '\t';
+        else if (value.size() == 1) delimiter = value[0];
+        else return false;
+        return true;
+    }
+}
+/******************************************************************************/
+
+/******************************************************************************/
+/* Server *********************************************************************/
+namespace
+{
+    void handle_job(int fd, const app::TranslateOptions& defaults)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        SocketReader reader{fd, IdleTimeout};
+        const auto fail = [fd](const std::string& message) {
+            write_all(fd, "ERROR " + message + "\n");
+        };
+
+        std::string line;
+        if (!reader.read_line(line)) return;
+        if (line == "PING") {
+            write_all(fd, "PONG\n");
+            return;
+        }
+        if (line != "TRANSLATE") return fail("unknown request \"" + line + "\"");
+
+        // headers, up to an empty line
+        std::unordered_map<std::string, std::string> headers;
+        while (reader.read_line(line) && !line.empty()) {
+            const auto colon = line.find(':');
+            if (colon == std::string::npos) return fail("malformed header \"" + line + "\"");
+            const auto value_start = line.find_first_not_of(' ', colon + 1);
+            headers[line.substr(0, colon)] = (value_start == std::string::npos)
+                ? std::string{} : line.substr(value_start);
+        }
+
+        app::TranslateOptions options = defaults;
+        if (headers.count("Delimiter") && !parse_delimiter(headers["Delimiter"], options.Delimiter)) {
+            return fail("invalid delimiter \"" + headers["Delimiter"] + "\"");
+        }
+        std::optional<ContactFilter> filter;
+        if (headers.count("Filter")) {
+            std::string error;
+            filter = ContactFilter::Compile(headers["Filter"], error);
+            if (!filter) return fail("invalid filter: " + error);
+            options.Filter = &*filter;
+        }
+        if (headers.count("Sort")) {
+            options.Order = SortOrder::Parse(headers["Sort"]);
+            if (!options.Order) return fail("invalid sort keys \"" + headers["Sort"] + "\"");
+        }
+
+        const std::string input = headers.count("Input") ? headers["Input"] : "inline";
+        const std::string output = headers.count("Output") ? headers["Output"] : "inline";
+
+        std::unique_ptr<std::istream> istr;
+        if (input == "inline") {
+            if (!headers.count("Content-Length")) return fail("inline input needs a Content-Length");
+            size_t length = 0;
+            if (!parse_length(headers["Content-Length"], MaxContentLength, length)) {
+                return fail("invalid Content-Length");
+            }
+            std::string body;
+            if (!reader.read_bytes(body, length)) return;
+            istr = std::make_unique<std::istringstream>(std::move(body));
+        } else {
+            istr = std::make_unique<std::ifstream>(input);
+            if (!*istr) return fail("cannot open input \"" + input + "\"");
+        }
+
+        std::unique_ptr<std::ofstream> file_out;
+        if (output != "inline") {
+            file_out = std::make_unique<std::ofstream>(output);
+            if (!*file_out) return fail("cannot open output \"" + output + "\"");
+        }
+
+        if (!write_all(fd, "OK\n")) return;
+        ChunkedSocketBuf chunks{fd};
+        std::ostream chunk_stream{&chunks};
+        app::TranslateStats stats;
+        try {
+            stats = app::Translate(*istr, file_out ? *file_out : chunk_stream, options);
+        } catch (const std::exception& error) {
+            // the missing end chunk tells the client the job failed
+            std::cerr << "Job failed: " << error.what() << std::endl;
+            return;
+        }
+        chunk_stream.flush();
+        if (file_out) file_out->close();
+        if (!chunks.ok()) return;
+
+        const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        std::ostringstream trailer;
+        trailer << "0\n"
+            << "Rows-In: " << stats.RowsIn << "\n"
+            << "Rows-Out: " << stats.RowsOut << "\n"
+            << "Elapsed-Us: " << elapsed << "\n"
+            << "\n";
+        write_all(fd, trailer.str());
+    }
+}
+
+auto app::RunServer(const Options& options) -> int
+{
+    sockaddr_un address;
+    if (!make_address(options.SocketPath, address)) {
+        std::cerr << "Socket path too long: " << options.SocketPath << std::endl;
+        return -1;
+    }
+
+    const int listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        std::cerr << "socket: " << std::strerror(errno) << std::endl;
+        return -1;
+    }
+    ::unlink(options.SocketPath.c_str());
+    if (::bind(listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0
+        || ::listen(listen_fd, SOMAXCONN) < 0)
+    {
+        std::cerr << "bind: " << std::strerror(errno) << std::endl;
+        ::close(listen_fd);
+        return -1;
+    }
+
+    std::signal(SIGINT, handle_stop_signal);
+    std::signal(SIGTERM, handle_stop_signal);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    const auto profiles = MakeProfileCache(options);
+    MappingCache mappings{profiles.get()};
+    {
+        util::ThreadPool pool{options.Threads ? options.Threads : std::thread::hardware_concurrency()};
+        std::cerr << "Serving on " << options.SocketPath << " with "
+            << pool.size() << " workers" << std::endl;
+
+        TranslateOptions defaults;
+        defaults.Mappings = &mappings;
+        defaults.Filter = options.Filter ? &*options.Filter : nullptr;
+        defaults.Order = options.Order;
+        defaults.MaxMemory = options.MaxMemory;
+        defaults.SpillDir = options.SpillDir;
+        defaults.Pool = &pool;
+
+        while (!g_Stopping) {
+            pollfd poll_fd{listen_fd, POLLIN, 0};
+            if (::poll(&poll_fd, 1, 200) <= 0) continue;
+            const int fd = ::accept(listen_fd, nullptr, nullptr);
+            if (fd < 0) continue;
+            pool.submit([fd, &defaults]() {
+                // a job that throws must not take the server down with it
+                try {
+                    handle_job(fd, defaults);
+                } catch (const std::exception& error) {
+                    std::cerr << "Job failed: " << error.what() << std::endl;
+                }
+                ::close(fd);
+            });
+        }
+        // the pool finishes the jobs already accepted; those still waiting on
+        // their clients give up
+    }
+
+    ::close(listen_fd);
+    ::unlink(options.SocketPath.c_str());
+    std::cerr << "Stopped (" << mappings.size() << " cached header mappings)" << std::endl;
+    return 0;
+}
+/******************************************************************************/
+
+/******************************************************************************/
+/* Client *********************************************************************/
+auto app::RunClient(const Options& options) -> int
+{
+    sockaddr_un address;
+    if (!make_address(options.SocketPath, address)) {
+        std::cerr << "Socket path too long: " << options.SocketPath << std::endl;
+        return -1;
+    }
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        std::cerr << "connect: " << std::strerror(errno) << std::endl;
+        if (fd >= 0) ::close(fd);
+        return -1;
+    }
+
+    std::ostringstream request;
+    request << "TRANSLATE\n";
+    std::string body;
+    if (options.ByPath) {
+        request << "Input: " << options.Source << "\n";
+    }
+    if (options.Filter) request << "Filter: " << options.Filter->expression() << "\n";
+    if (options.Order) request << "Sort: " << options.Order->str() << "\n";
+    if (!options.ByPath) {
+        std::ifstream file{options.Source, std::ios::binary};
+        if (!file) {
+            std::cerr << "Cannot open " << options.Source << std::endl;
+            ::close(fd);
+            return -1;
+        }
+        body.assign(std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{});
+        request << "Content-Length: " << body.size() << "\n";
+    }
+    request << "\n" << body;
+    if (!write_all(fd, request.str())) {
+        std::cerr << "Failed to send the request" << std::endl;
+        ::close(fd);
+        return -1;
+    }
+
+    SocketReader reader{fd};
+    std::string line;
+    if (!reader.read_line(line) || line != "OK") {
+        std::cerr << "Server: " << (line.empty() ? "no response" : line) << std::endl;
+        ::close(fd);
+        return -1;
+    }
+
+    std::ofstream file_out{options.Destination, std::ios::binary};
+    std::string chunk;
+    for (;;) {
+        // a malformed chunk size or a chunk cut short means the job failed
+        size_t size = 0;
+        if (!reader.read_line(line) || !parse_length(line, MaxChunkSize, size)
+            || (size != 0 && !reader.read_bytes(chunk, size)))
+        {
+            std::cerr << "Server closed the connection before the job finished" << std::endl;
+            ::close(fd);
+            return -1;
+        }
+        if (size == 0) break;
+        file_out.write(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+    }
+    while (reader.read_line(line) && !line.empty()) {
+        if (options.ShowStats) std::cerr << line << std::endl;
+    }
+    ::close(fd);
+    return 0;
+}
+/******************************************************************************/
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "app/Options.h"
+
+namespace app
+{
+
+/**
+ * Serve translation jobs on a Unix domain socket until SIGINT or SIGTERM.
+ * Header mappings and worker threads stay warm between jobs. The protocol is
+ * described in docs/PROTOCOL.md.
+ */
+auto RunServer(const Options&) -> int;
+
+/**
+ * Submit one translation job to a server and write its output.
+ */
+auto RunClient(const Options&) -> int;
+
+} // namespace app
@@ -0,0 +1,332 @@
+#include "Shard.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <queue>
+#include <tuple>
+
+/******************************************************************************/
+/* ShardManifest **************************************************************/
+void app::ShardManifest::write(std::ostream& ostr) const
+{
+    ostr << "# contacts translation shard\n"
+        << "version = " << Version << "\n"
+        << "shard = " << Index << "/" << Count << "\n"
+        << "fingerprint = " << std::hex << Fingerprint << std::dec << "\n"
+        << "input-size = " << InputSize << "\n"
+        << "order = " << Order << "\n"
+        << "rows-in = " << RowsIn << "\n"
+        << "rows-out = " << RowsOut << "\n";
+}
+
+auto app::ShardManifest::Read(std::istream& istr) -> std::optional<ShardManifest>
+{
+    ShardManifest manifest;
+    bool versioned = false;
+
+    std::string line;
+    while (std::getline(istr, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        const auto split = line.find(" = ");
+        if (split == std::string::npos) return std::nullopt;
+        const std::string key = line.substr(0, split);
+        const std::string value = line.substr(split + 3);
+
+        try {
+            if (key == "version") versioned = (std::stoi(value) == Version);
+            else if (key == "shard") {
+                const auto slash = value.find('/');
+                if (slash == std::string::npos) return std::nullopt;
+                manifest.Index = std::stoull(value.substr(0, slash));
+                manifest.Count = std::stoull(value.substr(slash + 1));
+            }
+            else if (key == "fingerprint") manifest.Fingerprint = std::stoull(value, nullptr, 16);
+            else if (key == "input-size") manifest.InputSize = std::stoull(value);
+            else if (key == "order") manifest.Order = value;
+            else if (key == "rows-in") manifest.RowsIn = std::stoull(value);
+            else if (key == "rows-out") manifest.RowsOut = std::stoull(value);
+            else return std::nullopt;
+        } catch (const std::exception&) {
+            return std::nullopt;
+        }
+    }
+    if (!versioned || manifest.Count == 0 || manifest.Index >= manifest.Count) return std::nullopt;
+    return manifest;
+}
+/******************************************************************************/
+
+/******************************************************************************/
+/* TranslateShard *************************************************************/
+namespace
+{
+    namespace fs = std::filesystem;
+
+    // write a file through a temporary beside it, renamed into place when whole
+    template <typename _Writer>
+    auto commit_file(const std::string& path, _Writer&& write) -> bool
+    {
+        const auto temporary = path + ".tmp";
+        {
+            std::ofstream file{temporary, std::ios::binary};
+            write(file);
+            file.close();
+            if (!file) return false;
+        }
+        std::error_code error;
+        fs::rename(temporary, path, error);
+        return !error;
+    }
+}
+
+auto app::TranslateShard(const std::string& source, const std::string& destination,
+    const ShardOptions& shard, const TranslateOptions& options) -> ShardStats
+{
+    ShardStats stats;
+    const auto manifest_path = destination + ".shard";
+
+    std::ifstream input{source, std::ios::binary};
+    std::error_code error;
+    const auto input_size = static_cast<size_t>(fs::file_size(source, error));
+    if (!input || error) {
+        std::cerr << "Cannot open " << source << std::endl;
+        return stats;
+    }
+    stats.BytesIn = input_size;
+
+    // a manifest left by an earlier run no longer describes the partial
+    fs::remove(manifest_path, error);
+
+    fileio::CSVStreamReader reader{input, options.Delimiter};
+    const auto header = reader.read(1);
+    if (header.empty()) {
+        std::cerr << "Cannot read the header of " << source << std::endl;
+        return stats;
+    }
+    std::shared_ptr<const ContactCSVInputMap> mapper = options.Mappings
+        ? options.Mappings->get(header.front())
+        : std::make_shared<const ContactCSVInputMap>(header.front());
+    const auto filter = options.Filter
+        ? std::optional<ContactFilter>{options.Filter->bind(header.front())}
+        : std::nullopt;
+
+    // Keep the contacts that hash to this shard
+    const ProjectedMapping projected{*mapper, filter ? &*filter : nullptr};
+    reader.project(projected.Projection);
+    AddressBook address_book{*mapper};
+    const size_t batch_size = std::max<size_t>(shard.BatchSize, 1);
+    std::vector<Contact> contacts;
+    size_t mapped = 0;
+    for (auto batch = reader.read(batch_size); !batch.empty(); batch = reader.read(batch_size)) {
+        contacts.clear();
+        MapContacts(batch.data(), batch.size(), projected.Mapper, projected.filter(), contacts);
+        for (auto& contact : contacts) {
+            if (StableHash(contact) % shard.Count != shard.Index) continue;
+            address_book.insert(std::move(contact));
+            mapped += 1;
+        }
+    }
+    stats.RowsIn = reader.rows_read() - 1;
+    stats.RowsOut = address_book.size();
+    if (options.Stats) AddContactStats(*options.Stats, address_book, mapped);
+
+    // Write the partial sorted, so that merging shards is a single pass
+    auto sorted = options;
+    sorted.Order = options.Order.value_or(SortOrder{});
+    if (!commit_file(destination, [&](std::ostream& ostr) {
+        WriteAddressBook(address_book, ostr, sorted);
+    })) {
+        std::cerr << "Cannot write partial output " << destination << std::endl;
+        return stats;
+    }
+
+    ShardManifest manifest;
+    manifest.Index = shard.Index;
+    manifest.Count = shard.Count;
+    manifest.Fingerprint = TranslateFingerprint(header.front(), options);
+    manifest.InputSize = input_size;
+    manifest.Order = sorted.Order->str();
+    manifest.RowsIn = stats.RowsIn;
+    manifest.RowsOut = stats.RowsOut;
+    if (!commit_file(manifest_path, [&](std::ostream& ostr) { manifest.write(ostr); })) {
+        std::cerr << "Cannot write shard manifest " << manifest_path << std::endl;
+        return stats;
+    }
+    stats.Complete = true;
+    return stats;
+}
+/******************************************************************************/
+
+/******************************************************************************/
+/* MergeShards ****************************************************************/
+namespace
+{
+    constexpr size_t MergeBatchRows = 1024;
+
+    /**
+     * A partial output being merged: its stream, the rows read ahead from it,
+     * and the contact at its head with that contact's sort key.
+     */
+    struct PartialReader
+    {
+        explicit PartialReader(const std::string& path)
+            : Stream{path, std::ios::binary}
+            , Reader{Stream, ','}
+        {}
+
+        // read the next contact into Current and Key, false at the end
+        auto advance(const SortOrder& order) -> bool
+        {
+            if (Next == Batch.size()) {
+                Batch = Reader.read(MergeBatchRows);
+                Next = 0;
+                if (Batch.empty()) return false;
+            }
+            auto& row = Batch[Next++];
+            for (size_t j = 0; j < Contact::Fields.size(); ++j) {
+                Current.*Contact::Fields[j] = (j < row.size()) ? row[j].take() : std::pmr::string{};
+            }
+            Key = order.key(Current);
+            return true;
+        }
+
+        std::ifstream Stream;
+        fileio::CSVStreamReader Reader;
+        fileio::CSVTable Batch{};
+        size_t Next{};
+        Contact Current{};
+        std::string Key{};
+    };
+
+    // check that the manifests agree on an order, and that no translation
+    // is missing a shard
+    auto check_manifests(const std::vector<std::string>& partials,
+        const std::vector<app::ShardManifest>& manifests) -> bool
+    {
+        std::map<std::tuple<uint64_t, size_t, size_t>, std::vector<bool>> translations;
+        for (size_t k = 0; k < manifests.size(); ++k) {
+            const auto& manifest = manifests[k];
+            if (manifest.Order != manifests.front().Order) {
+                std::cerr << partials[k] << " is sorted by " << manifest.Order << " but "
+                    << partials.front() << " is sorted by " << manifests.front().Order << std::endl;
+                return false;
+            }
+            auto& shards = translations[{manifest.Fingerprint, manifest.InputSize, manifest.Count}];
+            shards.resize(manifest.Count);
+            shards[manifest.Index] = true;
+        }
+        for (const auto& [translation, shards] : translations) {
+            const auto missing = std::find(shards.begin(), shards.end(), false);
+            if (missing == shards.end()) continue;
+            const auto k = std::find_if(manifests.begin(), manifests.end(), [&](const auto& manifest) {
+                return std::tie(manifest.Fingerprint, manifest.InputSize, manifest.Count) == translation;
+            }) - manifests.begin();
+            std::cerr << "Shard " << (missing - shards.begin()) << "/" << shards.size()
+                << " of the same input as " << partials[k] << " is missing" << std::endl;
+            return false;
+        }
+        return true;
+    }
+}
+
+auto app::MergeShards(const std::vector<std::string>& partials, std::ostream& ostr) -> MergeStats
+{
+    MergeStats stats;
+    if (partials.empty()) return stats;
+
+    std::vector<ShardManifest> manifests;
+    for (const auto& partial : partials) {
+        std::ifstream file{partial + ".shard"};
+        auto manifest = file ? ShardManifest::Read(file) : std::nullopt;
+        if (!manifest) {
+            std::cerr << "Cannot read shard manifest " << partial << ".shard" << std::endl;
+            return stats;
+        }
+        manifests.push_back(std::move(*manifest));
+    }
+    if (!check_manifests(partials, manifests)) return stats;
+    const auto order = SortOrder::Parse(manifests.front().Order);
+    if (!order) {
+        std::cerr << "Invalid sort keys \"" << manifests.front().Order << "\" in "
+            << partials.front() << ".shard" << std::endl;
+        return stats;
+    }
+
+    // The header of the first partial names the columns of the output
+    std::vector<std::unique_ptr<PartialReader>> readers;
+    fileio::CSVStreamWriter writer{ostr};
+    for (const auto& partial : partials) {
+        readers.push_back(std::make_unique<PartialReader>(partial));
+        const auto header = readers.back()->Stream.is_open()
+            ? readers.back()->Reader.read(1) : fileio::CSVTable{};
+        if (header.empty()) {
+            std::cerr << "Cannot read the header of " << partial << std::endl;
+            return stats;
+        }
+        if (readers.size() == 1) {
+            std::vector<std::string_view> cells;
+            for (const auto& cell : header.front()) cells.push_back(cell.str());
+            writer.write_row(cells);
+        }
+    }
+    stats.Partials = readers.size();
+
+    // A k-way merge on the sort keys, which order by every field last, so
+    // that a contact in several partials comes up from each in turn
+    const auto greater = [&](size_t a, size_t b) {
+        return std::tie(readers[a]->Key, a) > std::tie(readers[b]->Key, b);
+    };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(greater)> heap{greater};
+    const auto advance = [&](size_t k) {
+        if (!readers[k]->advance(*order)) return;
+        stats.RowsIn += 1;
+        heap.push(k);
+    };
+    for (size_t k = 0; k < readers.size(); ++k) advance(k);
+
+    std::string last;
+    bool first = true;
+    while (!heap.empty()) {
+        const size_t k = heap.top();
+        heap.pop();
+        if (first || readers[k]->Key != last) {
+            WriteContact(writer, readers[k]->Current);
+            last = readers[k]->Key;
+            first = false;
+            stats.RowsOut += 1;
+        }
+        advance(k);
+    }
+    stats.Complete = static_cast<bool>(ostr);
+    return stats;
+}
+
+auto app::RunMerge(const Options& options) -> int
+{
+    // merged beside the destination, and renamed over it only when whole
+    const auto temporary = options.Destination + ".tmp";
+    MergeStats stats;
+    {
+        std::ofstream file{temporary, std::ios::binary};
+        if (file) stats = MergeShards(options.Partials, file);
+        file.close();
+        stats.Complete = stats.Complete && file;
+    }
+    std::error_code error;
+    if (stats.Complete) fs::rename(temporary, options.Destination, error);
+    if (!stats.Complete || error) {
+        fs::remove(temporary, error);
+        std::cerr << "Cannot merge shards into " << options.Destination << std::endl;
+        return -1;
+    }
+
+    if (options.ShowStats) {
+        std::cerr << "merge: " << stats.Partials << " partials, " << stats.RowsIn << " rows in, "
+            << stats.RowsOut << " rows out" << std::endl;
+    }
+    return 0;
+}
+/******************************************************************************/
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "app/Options.h"
+#include "app/Translate.h"
+
+#include <cstdint>
+#include <istream>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace app
+{
+
+/**
+ * What a shard of a translation was taken of, written beside its partial
+ * output as <partial>.shard once the partial is whole: shard Index of Count,
+ * of an input of InputSize bytes read with options that hash to Fingerprint,
+ * its rows sorted by Order.
+ */
+struct ShardManifest
+{
+    static constexpr int Version = 1;
+
+    size_t Index{};
+    size_t Count{1};
+    uint64_t Fingerprint{};
+    size_t InputSize{};
+    std::string Order{};
+
+    size_t RowsIn{};
+    size_t RowsOut{};
+
+    void write(std::ostream&) const;
+    static auto Read(std::istream&) -> std::optional<ShardManifest>;
+};
+
+struct ShardOptions
+{
+    size_t Index{0};
+    size_t Count{1};
+    // rows read at a time
+    size_t BatchSize{4096};
+};
+
+struct ShardStats : TranslateStats
+{
+    bool Complete{false};
+};
+
+/**
+ * Translate the shard of a contacts file that falls to one of Count
+ * processes. Every process reads the whole input, but keeps only the
+ * contacts whose StableHash is Index modulo Count, so duplicates always
+ * fall to the same shard and each process holds a Count-th of the output.
+ * The shard is deduplicated, sorted by the options' Order (or the default
+ * order) and written to destination, and then its manifest is written to
+ * <destination>.shard, both through a rename.
+ */
+auto TranslateShard(const std::string& source, const std::string& destination,
+    const ShardOptions&, const TranslateOptions& = {}) -> ShardStats;
+
+struct MergeStats
+{
+    size_t Partials{};
+    size_t RowsIn{};
+    size_t RowsOut{};
+    bool Complete{false};
+};
+
+/**
+ * Merge the partial outputs of sharded translations into one sorted table,
+ * in a single k-way pass holding one row of each partial in memory. Every
+ * partial must have been sorted in the same order, and every shard of a
+ * translation must be present. Contacts that appear in more than one
+ * partial, such as those of overlapping inputs, are written once.
+ */
+auto MergeShards(const std::vector<std::string>& partials, std::ostream&) -> MergeStats;
+
+/**
+ * The merge subcommand: merge the partials of the options into their
+ * destination, through a rename.
+ */
+auto RunMerge(const Options&) -> int;
+
+} // namespace app
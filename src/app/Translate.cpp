@@ -0,0 +1,423 @@
+#include "Translate.h"
+
+#include <algorithm>
+#include <array>
+#include <string_view>
+#include <vector>
+
+/******************************************************************************/
+/* MappingCache ***************************************************************/
+app::MappingCache::MappingCache(const ProfileCache* profiles)
+    : m_Profiles{profiles}
+{
+}
+
+auto app::MappingCache::get(const fileio::CSVRow& header)
+    -> std::shared_ptr<const ContactCSVInputMap>
+{
+    const auto fingerprint = MappingProfile::Fingerprint(header);
+
+    std::lock_guard lock{m_Mutex};
+    if (const auto itr = m_Mappings.find(fingerprint); itr != m_Mappings.end()) {
+        if (itr->second.Profile.matches(header)) return itr->second.Mapper;
+        // a fingerprint collision, so resolve this header without caching it
+        return std::make_shared<const ContactCSVInputMap>(header);
+    }
+
+    Entry entry;
+    entry.Profile = m_Profiles
+        ? m_Profiles->resolve(header)
+        : MappingProfile{header, ContactCSVInputMap{header}};
+    entry.Mapper = std::make_shared<const ContactCSVInputMap>(entry.Profile.mapper());
+    return m_Mappings.emplace(fingerprint, std::move(entry)).first->second.Mapper;
+}
+
+auto app::MappingCache::size() const -> size_t
+{
+    std::lock_guard lock{m_Mutex};
+    return m_Mappings.size();
+}
+
+auto app::TranslateFingerprint(const fileio::CSVRow& header, const TranslateOptions& options)
+    -> uint64_t
+{
+    auto fingerprint = MappingProfile::Fingerprint(header);
+    fingerprint = util::fnv1a_64(std::string_view{&options.Delimiter, 1}, fingerprint);
+    if (options.Filter) fingerprint = util::fnv1a_64(options.Filter->expression(), fingerprint);
+    return fingerprint;
+}
+/******************************************************************************/
+
+/******************************************************************************/
+/* Translate ******************************************************************/
+namespace
+{
+    constexpr size_t SortBatchSize = 4096;
+
+    // Translate the rest of a table through a ContactSorter instead of an
+    // address book, so that at most MaxMemory bytes of contacts are held at
+    // once; duplicates are dropped as the sorted runs are merged
+    auto translate_sorted(fileio::CSVStreamReader& reader, fileio::CSVTable& table_in,
+        std::ostream& ostr, const app::ProjectedMapping& projected,
+        const app::TranslateOptions& options) -> app::TranslateStats
+    {
+        app::TranslateStats stats;
+        ContactSorter sorter{*options.Order, options.MaxMemory, options.SpillDir, options.Pool};
+        const auto preview = app::SortedPreview(options.Preview);
+
+        size_t mapped = 0;
+        std::vector<Contact> contacts;
+        const auto add_batch = [&](fileio::CSVTable& batch) {
+            contacts.clear();
+            app::MapContacts(batch.data(), batch.size(), projected.Mapper, projected.filter(), contacts);
+            for (auto& contact : contacts) sorter.add(std::move(contact));
+            mapped += contacts.size();
+        };
+
+        // the input preview shows the first rows read
+        if (options.PreviewStream) {
+            auto head = reader.read(std::max(SortBatchSize, preview.NumRows));
+            for (size_t i = 0; i < std::min(preview.NumRows, head.size()); ++i) {
+                table_in.push_back(head[i]);
+            }
+            table_in.print(*options.PreviewStream, preview);
+            *options.PreviewStream << std::endl;
+            add_batch(head);
+        }
+        for (auto batch = reader.read(SortBatchSize); !batch.empty(); batch = reader.read(SortBatchSize)) {
+            add_batch(batch);
+        }
+        stats.RowsIn = reader.rows_read() - 1;
+        stats.RowsOut = app::WriteSorted(sorter, projected.Mapper, ostr, options, mapped);
+        return stats;
+    }
+}
+
+auto app::Translate(std::istream& istr, std::ostream& ostr, const TranslateOptions& options)
+    -> TranslateStats
+{
+    TranslateStats stats;
+
+    fileio::CSVStreamReader reader{istr, options.Delimiter};
+    auto table_in = reader.read(1);
+    if (table_in.empty()) return stats;
+    std::shared_ptr<const ContactCSVInputMap> mapper = options.Mappings
+        ? options.Mappings->get(table_in.front())
+        : std::make_shared<const ContactCSVInputMap>(table_in.front());
+    const auto filter = options.Filter
+        ? std::optional<ContactFilter>{options.Filter->bind(table_in.front())}
+        : std::nullopt;
+
+    // only the columns mapped or filtered on are read, and previewed
+    const ProjectedMapping projected{*mapper, filter ? &*filter : nullptr};
+    reader.project(projected.Projection);
+    table_in.front() = projected.Projection.apply(table_in.front());
+
+    // sorted output never builds the book, so it stays within MaxMemory
+    if (options.Order) return translate_sorted(reader, table_in, ostr, projected, options);
+
+    for (auto& row : reader.read(static_cast<size_t>(-1))) table_in.push_back(std::move(row));
+    stats.RowsIn = table_in.nrows() - 1;
+    if (options.PreviewStream) {
+        table_in.print(*options.PreviewStream, options.Preview);
+        *options.PreviewStream << std::endl;
+    }
+
+    // every row makes a contact, unless the filter drops it
+    size_t mapped = stats.RowsIn;
+    const auto make_address_book = [&]() {
+        if (!projected.Filter) {
+            auto address_book = AddressBook{std::move(table_in), projected.Mapper};
+            address_book.format_all();
+            return address_book;
+        }
+        std::vector<Contact> contacts;
+        MapContacts(table_in.data() + 1, table_in.size() - 1, projected.Mapper, projected.filter(),
+            contacts);
+        mapped = contacts.size();
+        AddressBook address_book{projected.Mapper};
+        for (auto& contact : contacts) address_book.insert(std::move(contact));
+        return address_book;
+    };
+    auto address_book = make_address_book();
+    stats.RowsOut = address_book.size();
+    if (options.Stats) AddContactStats(*options.Stats, address_book, mapped);
+
+    // written first, so that the preview shows the order of the output
+    WriteAddressBook(address_book, ostr, options);
+    if (options.PreviewStream) {
+        address_book.print(*options.PreviewStream, options.Preview);
+        *options.PreviewStream << std::endl;
+    }
+    return stats;
+}
+
+auto app::TranslateChunked(const std::string& input, std::ostream& ostr,
+    util::ThreadPool& pool, size_t chunk_size, const TranslateOptions& options)
+    -> TranslateStats
+{
+    TranslateStats stats;
+    stats.BytesIn = input.size();
+
+    // the ranges read exclude the '\n' that ends them, so the line ending is
+    // taken from the header once, for the header and every chunk alike
+    const size_t header_end = fileio::CSVReader::FindRecordEnd(input, 0);
+    fileio::CSVFormat format{options.Delimiter};
+    format.CRLF = header_end > 0 && header_end < input.size() && input[header_end - 1] == '\r';
+    const auto header_table = fileio::CSVReader::ReadCSVTable(
+        std::string_view{input}.substr(0, header_end), format);
+    if (header_table.empty()) return stats;
+
+    std::shared_ptr<const ContactCSVInputMap> mapper = options.Mappings
+        ? options.Mappings->get(header_table.front())
+        : std::make_shared<const ContactCSVInputMap>(header_table.front());
+    const auto filter = options.Filter
+        ? std::optional<ContactFilter>{options.Filter->bind(header_table.front())}
+        : std::nullopt;
+    const ProjectedMapping projected{*mapper, filter ? &*filter : nullptr};
+
+    // Split the body on record boundaries; an odd number of quotes since the
+    // last boundary means the split point is inside a quoted field
+    std::vector<std::pair<size_t, size_t>> ranges;
+    for (size_t begin = header_end + 1; begin < input.size(); ) {
+        size_t end = std::min(begin + std::max<size_t>(chunk_size, 1), input.size());
+        const bool quoted = std::count(input.begin() + begin, input.begin() + end, '"') % 2;
+        end = fileio::CSVReader::FindRecordEnd(input, end, quoted);
+        ranges.emplace_back(begin, end);
+        begin = end + 1;
+    }
+
+    std::vector<size_t> chunk_rows(ranges.size());
+    const auto read_chunk = [&](size_t k, std::vector<Contact>& chunk) {
+        const auto [begin, end] = ranges[k];
+        auto table = fileio::CSVReader::ReadCSVTable(
+            std::string_view{input}.substr(begin, end - begin), format, projected.Projection);
+        chunk_rows[k] = table.size();
+        MapContacts(table.data(), table.size(), projected.Mapper, projected.filter(), chunk);
+    };
+
+    // Sorted output goes through a ContactSorter as in Translate, a window of
+    // chunks at a time, so that besides the input only the window's contacts
+    // and MaxMemory of sorted ones are held
+    if (options.Order) {
+        ContactSorter sorter{*options.Order, options.MaxMemory, options.SpillDir, options.Pool};
+        const size_t window = 2 * pool.size();
+        std::vector<std::vector<Contact>> chunks(window);
+        size_t mapped = 0;
+        for (size_t first = 0; first < ranges.size(); first += window) {
+            const size_t last = std::min(first + window, ranges.size());
+            util::TaskGroup group;
+            for (size_t k = first; k < last; ++k) {
+                pool.submit(group, [&, k]() { read_chunk(k, chunks[k - first]); });
+            }
+            pool.wait(group);
+            for (size_t k = first; k < last; ++k) {
+                auto& chunk = chunks[k - first];
+                for (auto& contact : chunk) sorter.add(std::move(contact));
+                mapped += chunk.size();
+                chunk.clear();
+                stats.RowsIn += chunk_rows[k];
+            }
+        }
+        stats.RowsOut = WriteSorted(sorter, *mapper, ostr, options, mapped);
+        return stats;
+    }
+
+    // Read, map, format and deduplicate each chunk as its own task; a
+    // contact's sequence is its chunk and its place in the chunk, so that
+    // the merged book keeps the first of each contact in input order
+    ConcurrentAddressBook contacts{4 * pool.size()};
+    std::vector<size_t> chunk_mapped(ranges.size());
+    util::TaskGroup group;
+    for (size_t k = 0; k < ranges.size(); ++k) {
+        pool.submit(group, [&, k]() {
+            std::vector<Contact> chunk;
+            read_chunk(k, chunk);
+            chunk_mapped[k] = chunk.size();
+            for (size_t i = 0; i < chunk.size(); ++i) {
+                contacts.insert(std::move(chunk[i]), (uint64_t{k} << 32) | i);
+            }
+        });
+    }
+    pool.wait(group);
+
+    AddressBook address_book = std::move(contacts).merge(*mapper);
+    size_t mapped = 0;
+    for (size_t k = 0; k < ranges.size(); ++k) {
+        stats.RowsIn += chunk_rows[k];
+        mapped += chunk_mapped[k];
+    }
+    stats.RowsOut = address_book.size();
+    if (options.Stats) AddContactStats(*options.Stats, address_book, mapped);
+
+    WriteAddressBook(address_book, ostr, options);
+    return stats;
+}
+/******************************************************************************/
+
+/******************************************************************************/
+/* MapContacts ****************************************************************/
+auto app::ProjectColumns(const ContactCSVInputMap& mapper, const ContactFilter* filter)
+    -> fileio::CSVProjection
+{
+    auto columns = mapper.columns();
+    if (filter) {
+        const auto filter_columns = filter->columns();
+        columns.insert(columns.end(), filter_columns.begin(), filter_columns.end());
+    }
+    return fileio::CSVProjection{columns};
+}
+
+app::ProjectedMapping::ProjectedMapping(const ContactCSVInputMap& mapper,
+    const ContactFilter* filter)
+    : Projection{ProjectColumns(mapper, filter)}
+    , Mapper{mapper.project(Projection)}
+    , Filter{filter ? std::optional<ContactFilter>{filter->project(Projection)} : std::nullopt}
+{
+}
+
+void app::MapContacts(fileio::CSVRow* rows, size_t count, const ContactCSVInputMap& mapper,
+    const ContactFilter* filter, std::vector<Contact>& contacts)
+{
+    if (filter && filter->raw_only()) {
+        const auto selection = filter->select(rows, count);
+        contacts.reserve(contacts.size() + selection.count());
+        for (size_t i = 0; i < count; ++i) {
+            if (!selection.test(i)) continue;
+            contacts.emplace_back(std::move(rows[i]), mapper);
+            contacts.back().format();
+        }
+        return;
+    }
+
+    // a filter that reads raw columns as well as contacts selects after the
+    // contacts are made, so then the cells it reads have to stay whole
+    const bool keep_rows = filter && !filter->columns().empty();
+    const size_t first = contacts.size();
+    contacts.reserve(first + count);
+    for (size_t i = 0; i < count; ++i) {
+        if (keep_rows) contacts.emplace_back(rows[i], mapper);
+        else contacts.emplace_back(std::move(rows[i]), mapper);
+        contacts.back().format();
+    }
+    if (!filter) return;
+
+    // compact the selected contacts to the front, in order
+    const auto selection = filter->select(rows, count, contacts.data() + first);
+    size_t kept = first;
+    for (size_t i = 0; i < count; ++i) {
+        if (!selection.test(i)) continue;
+        if (kept != first + i) contacts[kept] = std::move(contacts[first + i]);
+        kept += 1;
+    }
+    contacts.erase(contacts.begin() + kept, contacts.end());
+}
+/******************************************************************************/
+
+/******************************************************************************/
+/* WriteAddressBook ***********************************************************/
+void app::WriteContactHeader(fileio::CSVStreamWriter& writer, const ContactCSVInputMap& mapper)
+{
+    std::array<std::string_view, Contact::Fields.size()> cells;
+    for (size_t j = 0; j < cells.size(); ++j) {
+        cells[j] = (mapper.*ContactCSVInputMap::Mappers[j]).FieldName;
+    }
+    writer.write_row(cells);
+}
+
+void app::WriteContact(fileio::CSVStreamWriter& writer, const Contact& contact)
+{
+    std::array<std::string_view, Contact::Fields.size()> cells;
+    for (size_t j = 0; j < cells.size(); ++j) cells[j] = contact.*Contact::Fields[j];
+    writer.write_row(cells);
+}
+
+auto app::ContactColumnNames(const ContactCSVInputMap& mapper) -> std::vector<std::string>
+{
+    std::vector<std::string> names;
+    for (const auto field : ContactCSVInputMap::Mappers) {
+        names.emplace_back((mapper.*field).FieldName);
+    }
+    return names;
+}
+
+void app::WriteContact(fileio::ArrowFileWriter& writer, const Contact& contact)
+{
+    std::array<std::string_view, Contact::Fields.size()> cells;
+    for (size_t j = 0; j < cells.size(); ++j) cells[j] = contact.*Contact::Fields[j];
+    writer.write_row(cells);
+}
+
+void app::AddContactStats(ContactStats& contact_stats, const AddressBook& address_book,
+    size_t mapped)
+{
+    for (size_t i = 0; i < address_book.size(); ++i) contact_stats.add(address_book[i]);
+    contact_stats.add_duplicates(mapped - address_book.size());
+}
+
+namespace
+{
+    // hand each contact of the book to write, in the order the options ask for
+    template <typename _Write>
+    void write_ordered(AddressBook& address_book, const app::TranslateOptions& options,
+        _Write&& write)
+    {
+        if (options.Order) address_book.sort(*options.Order, options.Pool);
+        for (size_t i = 0; i < address_book.size(); ++i) write(address_book[i]);
+    }
+}
+
+void app::WriteAddressBook(AddressBook& address_book, std::ostream& ostr,
+    const TranslateOptions& options)
+{
+    if (options.ArrowOutput) {
+        fileio::ArrowFileWriter writer{ostr, ContactColumnNames(address_book.FieldMapper)};
+        write_ordered(address_book, options, [&](const Contact& contact) { WriteContact(writer, contact); });
+        writer.close();
+        return;
+    }
+
+    fileio::CSVStreamWriter writer{ostr};
+    WriteContactHeader(writer, address_book.FieldMapper);
+    write_ordered(address_book, options, [&](const Contact& contact) { WriteContact(writer, contact); });
+}
+
+auto app::SortedPreview(const bits::TablePreview& preview) -> bits::TablePreview
+{
+    using Mode = bits::TablePreview::Mode;
+    const size_t rows = preview.PreviewMode == Mode::All ? SortBatchSize : preview.NumRows;
+    return bits::TablePreview{Mode::Head, rows, preview.WidthSampleSize};
+}
+
+auto app::WriteSorted(ContactSorter& sorter, const ContactCSVInputMap& mapper, std::ostream& ostr,
+    const TranslateOptions& options, size_t mapped) -> size_t
+{
+    const auto preview = SortedPreview(options.Preview);
+    AddressBook head{mapper};
+    size_t written = 0;
+    const auto write = [&](auto& writer) {
+        sorter.merge([&](const Contact& contact) {
+            if (options.Stats) options.Stats->add(contact);
+            WriteContact(writer, contact);
+            if (options.PreviewStream && head.size() < preview.NumRows) head.insert(Contact{contact});
+            written += 1;
+        }, true);
+    };
+    if (options.ArrowOutput) {
+        fileio::ArrowFileWriter writer{ostr, ContactColumnNames(mapper)};
+        write(writer);
+        writer.close();
+    } else {
+        fileio::CSVStreamWriter writer{ostr};
+        WriteContactHeader(writer, mapper);
+        write(writer);
+    }
+    if (options.Stats) options.Stats->add_duplicates(mapped - written);
+
+    if (options.PreviewStream) {
+        head.print(*options.PreviewStream, preview);
+        *options.PreviewStream << std::endl;
+    }
+    return written;
+}
+/******************************************************************************/
@@ -0,0 +1,184 @@
+#pragma once
+
+#include "fileio/CSV.h"
+#include "fileio/Arrow.h"
+#include "contacts/Contact.h"
+#include "contacts/ConcurrentAddressBook.h"
+#include "contacts/MappingProfile.h"
+#include "contacts/ContactSort.h"
+#include "contacts/ContactFilter.h"
+#include "contacts/ContactStats.h"
+#include "bits/table_view.h"
+#include "util/thread_pool.h"
+
+#include <istream>
+#include <ostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace app
+{
+
+/**
+ * Remembers the ContactCSVInputMap resolved for each distinct header row, so
+ * that the heuristics only run once per layout. When given a ProfileCache,
+ * mappings are also loaded from and stored to disk. Safe to share across
+ * threads.
+ */
+class MappingCache
+{
+public:
+    explicit MappingCache(const ProfileCache* profiles = nullptr);
+
+    auto get(const fileio::CSVRow& header) -> std::shared_ptr<const ContactCSVInputMap>;
+    auto size() const -> size_t;
+
+private:
+    struct Entry
+    {
+        MappingProfile Profile{};
+        std::shared_ptr<const ContactCSVInputMap> Mapper{};
+    };
+
+    const ProfileCache* m_Profiles;
+    mutable std::mutex m_Mutex{};
+    std::unordered_map<uint64_t, Entry> m_Mappings{};
+};
+
+struct TranslateOptions
+{
+    char Delimiter{','};
+    // when set, header mappings are looked up here instead of being resolved
+    MappingCache* Mappings{nullptr};
+    // when set, the input and output tables are previewed to this stream
+    std::ostream* PreviewStream{nullptr};
+    bits::TablePreview Preview{};
+
+    // when set, only the contacts it selects are translated
+    const ContactFilter* Filter{nullptr};
+
+    // when set, contacts are written in this order instead of as stored
+    std::optional<SortOrder> Order{};
+    // bytes of contacts that are sorted in memory before runs are spilled to
+    // SpillDir, 0 for no limit
+    size_t MaxMemory{};
+    std::string SpillDir{};
+    // when set, sorting runs in parallel on this pool
+    util::ThreadPool* Pool{nullptr};
+
+    // when set, every contact written and every duplicate dropped is counted
+    // here, from the thread that deduplicates
+    ContactStats* Stats{nullptr};
+
+    // write address books as an Arrow IPC file rather than as CSV
+    bool ArrowOutput{false};
+};
+
+/**
+ * A fingerprint of a header row and of the options that change what is made
+ * of its rows, so that runs over the same input can tell if they agree.
+ */
+auto TranslateFingerprint(const fileio::CSVRow& header, const TranslateOptions&) -> uint64_t;
+
+struct TranslateStats
+{
+    size_t RowsIn{};
+    size_t RowsOut{};
+    size_t BytesIn{};
+};
+
+/**
+ * Translate one contacts table: read, map, format, deduplicate and write.
+ * Unsorted contacts are written in the order of the address book's set, or
+ * in the order they were first seen when filtered. Sorted output is sorted
+ * externally within MaxMemory instead, with the duplicates dropped as the
+ * sorted runs are merged.
+ */
+auto Translate(std::istream&, std::ostream&, const TranslateOptions& = {}) -> TranslateStats;
+
+/**
+ * Translate one contacts table held in memory, splitting the rows after the
+ * header into chunks of about chunk_size bytes that are read, mapped,
+ * formatted and deduplicated as tasks on the pool. Unsorted contacts are
+ * written in the order they were first seen, which is not the order of an
+ * unfiltered Translate; sorted output is the same as by Translate.
+ */
+auto TranslateChunked(const std::string& input, std::ostream&, util::ThreadPool&,
+    size_t chunk_size, const TranslateOptions& = {}) -> TranslateStats;
+
+/**
+ * The columns of an input that a mapper and a bound filter read, so that the
+ * reader can skip over the rest.
+ */
+auto ProjectColumns(const ContactCSVInputMap&, const ContactFilter* = nullptr)
+    -> fileio::CSVProjection;
+
+/**
+ * A mapper and a bound filter rewritten to read the rows of their projection,
+ * which hold only the columns they read.
+ */
+struct ProjectedMapping
+{
+    explicit ProjectedMapping(const ContactCSVInputMap&, const ContactFilter* = nullptr);
+
+    inline auto filter() const -> const ContactFilter* { return Filter ? &*Filter : nullptr; }
+
+    fileio::CSVProjection Projection;
+    ContactCSVInputMap Mapper;
+    std::optional<ContactFilter> Filter{};
+};
+
+/**
+ * Make formatted contacts from rows[0, count), appending those the filter
+ * selects, if given one. A filter that only reads raw columns selects rows
+ * before any contact is made from them. The contacts steal the cells they
+ * are made from, so the rows are left with empty cells.
+ */
+void MapContacts(fileio::CSVRow* rows, size_t count, const ContactCSVInputMap&,
+    const ContactFilter*, std::vector<Contact>& contacts);
+
+/**
+ * Write a contacts table a row at a time: the header named by a mapper, then
+ * each contact.
+ */
+void WriteContactHeader(fileio::CSVStreamWriter&, const ContactCSVInputMap&);
+void WriteContact(fileio::CSVStreamWriter&, const Contact&);
+
+/**
+ * The same for an Arrow IPC file, whose columns are named by a mapper.
+ */
+auto ContactColumnNames(const ContactCSVInputMap&) -> std::vector<std::string>;
+void WriteContact(fileio::ArrowFileWriter&, const Contact&);
+
+/**
+ * Count the contacts of an address book, deduplicated from mapped contacts,
+ * in a quality report.
+ */
+void AddContactStats(ContactStats&, const AddressBook&, size_t mapped);
+
+/**
+ * Write an address book as a contacts table, sorted in memory when the
+ * options ask for it, as CSV or as an Arrow IPC file.
+ */
+void WriteAddressBook(AddressBook&, std::ostream&, const TranslateOptions& = {});
+
+/**
+ * Write the contacts of a sorter as a contacts table, dropping duplicates as
+ * its runs are merged, and count them in the options' stats as deduplicated
+ * from mapped contacts. Returns the number of contacts written.
+ */
+auto WriteSorted(ContactSorter&, const ContactCSVInputMap&, std::ostream&,
+    const TranslateOptions&, size_t mapped) -> size_t;
+
+/**
+ * How sorted output is previewed: a sorted translation never holds a whole
+ * table, so it shows the head of its input and of its output, and at most a
+ * batch of rows for every row.
+ */
+auto SortedPreview(const bits::TablePreview&) -> bits::TablePreview;
+
+} // namespace app
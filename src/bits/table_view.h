@@ -1,52 +1,74 @@
-
 #pragma once
 
 #include <vector>
-#include <initializer_list>
 #include <functional>
 #include <string>
 #include <sstream>
 #include <algorithm>
+#include <ostream>
+#include <string_view>
+#include <type_traits>
 
 #include "util/string.h"
+#include "util/unicode.h"
 
 /******************************************************************************/
 
 namespace bits
 {
 
+    /**
+     * Which body rows of a table to render. The header row is always shown.
+     */
+    struct TablePreview
+    {
+        enum class Mode { All, Head, Tail, Sample };
+
+        Mode PreviewMode{Mode::All};
+        size_t NumRows{};
+
+        // widths are measured over at most this many rows when printing
+        size_t WidthSampleSize{1024};
+    };
+
+    /**
+     * A non-owning view over a two-dimensional table. Cells are resolved on
+     * demand through an accessor, offset and strided by the view's row and
+     * column strides, so creating a view or slicing one is O(1). The accessor
+     * may return nullptr for cells that do not exist (ragged rows).
+     */
     template <typename _Tp>
     class TableView
     {
     public:
-        explicit TableView() = default;
-
-        template <typename ForwardIterator>
-        TableView(size_t nrows, size_t ncols, ForwardIterator itr);
+        using Accessor = std::function<const _Tp*(size_t row, size_t col)>;
 
-        TableView(size_t nrows, size_t ncols, const std::vector<_Tp>&);
-        TableView(size_t nrows, size_t ncols, const std::vector<_Tp*>&);
-        TableView(const std::vector<std::vector<_Tp>>&);
-        TableView(const std::vector<std::vector<_Tp*>>&);
-
-        TableView(const TableView&);
-        TableView(TableView&&);
-        TableView& operator=(const TableView&);
-        TableView& operator=(TableView&&);
+        explicit TableView() = default;
+        TableView(size_t nrows, size_t ncols, Accessor accessor);
+        TableView(size_t nrows, size_t ncols, const _Tp* base,
+            size_t row_stride, size_t col_stride = 1);
 
-        inline const auto table() const { return m_TableView; }
         inline auto nrows() const { return m_NumRows; }
         inline auto ncols() const { return m_NumCols; }
+        auto at(size_t i, size_t j) const -> const _Tp*;
+
+        auto slice_rows(size_t first, size_t last, size_t step = 1) const -> TableView;
+        auto slice_cols(size_t first, size_t last, size_t step = 1) const -> TableView;
+
+        template <typename ToString>
+        void print(std::ostream&, ToString to_string, const TablePreview& = {}) const;
 
         template <typename ToString>
         auto str(ToString to_string) const -> std::string;
 
     protected:
-        void recache();
-
-        std::vector<std::vector<const _Tp*>> m_TableView{};
+        Accessor m_Accessor{};
         size_t m_NumRows{};
         size_t m_NumCols{};
+        size_t m_RowOffset{};
+        size_t m_RowStride{1};
+        size_t m_ColOffset{};
+        size_t m_ColStride{1};
     };
 
 }
@@ -54,185 +76,170 @@ namespace bits
 /******************************************************************************/
 
 template <typename _Tp>
-template <typename ForwardIterator2D>
-bits::TableView<_Tp>::TableView(size_t nrows, size_t ncols, ForwardIterator2D row_itr)
-    : m_TableView{}
+bits::TableView<_Tp>::TableView(size_t nrows, size_t ncols, Accessor accessor)
+    : m_Accessor{std::move(accessor)}
     , m_NumRows{nrows}
     , m_NumCols{ncols}
 {
-    m_TableView.resize(m_NumRows);
-    for (size_t i = 0; i < m_NumRows; ++i) {
-        m_TableView[i].resize(m_NumCols);
-        auto cell_itr = row_itr++;
-        for (size_t j = 0; j < m_NumCols; ++j) {
-            m_TableView[i][j] = &*cell_itr++;
-        }
-    }
 }
 
 template <typename _Tp>
-bits::TableView<_Tp>::TableView(size_t nrows, size_t ncols, const std::vector<_Tp>& vec)
-    : m_TableView{}
+bits::TableView<_Tp>::TableView(size_t nrows, size_t ncols, const _Tp* base,
+    size_t row_stride, size_t col_stride)
+    : m_Accessor{[=](size_t i, size_t j) { return base + i * row_stride + j * col_stride; }}
     , m_NumRows{nrows}
     , m_NumCols{ncols}
 {
-    static_assert(vec.size() >= nrows*ncols);
-    m_TableView.resize(m_NumRows);
-    for (size_t i = 0; i < m_NumRows; ++i) {
-        m_TableView[i].resize(m_NumCols);
-        for (size_t j = 0; j < m_NumCols; ++j) {
-            m_TableView[i][j] = &vec[i * m_NumCols + j];
-        }
-    }
-}
-
-template <typename _Tp>
-bits::TableView<_Tp>::TableView(size_t nrows, size_t ncols, const std::vector<_Tp*>& vec)
-    : m_TableView{}
-    , m_NumRows{nrows}
-    , m_NumCols{ncols}
-{
-    static_assert(vec.size() >= nrows*ncols);
-    m_TableView.resize(m_NumRows);
-    for (size_t i = 0; i < m_NumRows; ++i) {
-        m_TableView[i].resize(m_NumCols);
-        for (size_t j = 0; j < m_NumCols; ++j) {
-            m_TableView[i][j] = vec[i * m_NumCols + j];
-        }
-    }
-}
-
-template <typename _Tp>
-bits::TableView<_Tp>::TableView(const std::vector<std::vector<_Tp>>& vec)
-    : m_TableView{}
-    , m_NumRows{vec.size()}
-    , m_NumCols{vec.empty() ? 0 : vec[0].size()}
-{
-    m_TableView.resize(m_NumRows);
-    for (size_t i = 0; i < m_NumRows; ++i) {
-        m_TableView[i].resize(m_NumCols);
-        for (size_t j = 0; j < m_NumCols; ++j) {
-            m_TableView[i][j] = &vec[i][j];
-        }
-    }
-}
-
-template <typename _Tp>
-bits::TableView<_Tp>::TableView(const std::vector<std::vector<_Tp*>>& vec)
-    : m_TableView{vec}
-    , m_NumRows{vec.size()}
-    , m_NumCols{vec.empty() ? 0 : vec[0].size()}
-{
-}
-
-template <typename _Tp>
-bits::TableView<_Tp>::TableView(const TableView& other)
-    : m_TableView{other.m_TableView}
-    , m_NumRows{other.m_NumRows}
-    , m_NumCols{other.m_NumCols}
-{
-}
-
-template <typename _Tp>
-bits::TableView<_Tp>::TableView(TableView&& other)
-    : m_TableView{std::move(other.m_TableView)}
-{
-    recache();
 }
 
 template <typename _Tp>
-bits::TableView<_Tp>& bits::TableView<_Tp>::operator=(const TableView& other)
+auto bits::TableView<_Tp>::at(size_t i, size_t j) const -> const _Tp*
 {
-    m_TableView = other.m_TableView;
-    m_NumRows = other.m_NumRows;
-    m_NumCols = other.m_NumCols;
+    if (i >= m_NumRows || j >= m_NumCols) return nullptr;
+    return m_Accessor(m_RowOffset + i * m_RowStride, m_ColOffset + j * m_ColStride);
 }
 
 template <typename _Tp>
-bits::TableView<_Tp>& bits::TableView<_Tp>::operator=(TableView&& other)
+auto bits::TableView<_Tp>::slice_rows(size_t first, size_t last, size_t step) const
+    -> TableView
 {
-    m_TableView = std::move(other.m_TableView);
-    recache();
+    last = std::min(last, m_NumRows);
+    first = std::min(first, last);
+    step = std::max<size_t>(step, 1);
+
+    TableView view{*this};
+    view.m_NumRows = (last - first + step - 1) / step;
+    view.m_RowOffset = m_RowOffset + first * m_RowStride;
+    view.m_RowStride = m_RowStride * step;
+    return view;
 }
 
 template <typename _Tp>
-void bits::TableView<_Tp>::recache()
+auto bits::TableView<_Tp>::slice_cols(size_t first, size_t last, size_t step) const
+    -> TableView
 {
-    m_NumRows = m_TableView.size();
-    m_NumCols = std::max_element(m_TableView.cbegin(), m_TableView.cend(),
-        [](const auto& a, const auto& b) { return a.size() < b.size(); } )->size();
-
-    std::for_each(m_TableView.begin(), m_TableView.end(), [this](auto& row) {
-        row.resize(m_NumCols);
-    });
+    last = std::min(last, m_NumCols);
+    first = std::min(first, last);
+    step = std::max<size_t>(step, 1);
+
+    TableView view{*this};
+    view.m_NumCols = (last - first + step - 1) / step;
+    view.m_ColOffset = m_ColOffset + first * m_ColStride;
+    view.m_ColStride = m_ColStride * step;
+    return view;
 }
 
 template <typename _Tp>
 template <typename ToString>
-auto bits::TableView<_Tp>::str(ToString to_string) const -> std::string
+void bits::TableView<_Tp>::print(std::ostream& os, ToString to_string,
+    const TablePreview& preview) const
 {
-    if (m_NumRows == 0) return "╭───╮\n╰───╯";
+    if (m_NumRows == 0 || m_NumCols == 0) {
+        os << "╭───╮\n╰───╯";
+        return;
+    }
 
-    const auto make_string = [&](const auto* item) -> std::string {
-        return (item == nullptr) ? "" : to_string(*item);
+    // Select the body rows to render, as strided slices of this view
+    const auto body = slice_rows(1, m_NumRows);
+    const size_t count = std::min(preview.NumRows, body.nrows());
+    TableView shown = body;
+    switch (preview.PreviewMode) {
+        case TablePreview::Mode::All:
+            break;
+        case TablePreview::Mode::Head:
+            shown = body.slice_rows(0, count);
+            break;
+        case TablePreview::Mode::Tail:
+            shown = body.slice_rows(body.nrows() - count, body.nrows());
+            break;
+        case TablePreview::Mode::Sample:
+            if (count == 0) shown = body.slice_rows(0, 0);
+            else shown = body.slice_rows(0, body.nrows(), (body.nrows() + count - 1) / count);
+            break;
+    }
+    const size_t omitted = body.nrows() - shown.nrows();
+
+    // to_string may return a view into the item, or a string of its own
+    using String = std::decay_t<std::invoke_result_t<ToString, const _Tp&>>;
+    const auto make_string = [&](const TableView& view, size_t i, size_t j) -> String {
+        const auto* item = view.at(i, j);
+        return (item == nullptr) ? String{} : to_string(*item);
     };
 
-    // Calculate table of strings to print
-    std::vector<std::vector<std::string>> string_table;
-    string_table.reserve(m_NumRows);
-    for (size_t i = 0; i < m_NumRows; ++i) {
-        std::vector<std::string> st_row;
-        st_row.reserve(m_NumCols);
-        for (size_t j = 0; j < m_NumCols; ++j) {
-            auto string = make_string(m_TableView[i][j]);
-            st_row.push_back(std::move(string));
+    // Measure column widths in one pass over the header and a strided sample
+    const size_t sample_size = std::max<size_t>(preview.WidthSampleSize, 1);
+    const auto sample = shown.slice_rows(0, shown.nrows(),
+        (shown.nrows() + sample_size - 1) / sample_size);
+    std::vector<size_t> widths(m_NumCols, 1);
+    for (size_t j = 0; j < m_NumCols; ++j) {
+        widths[j] = std::max(widths[j], util::display_width(make_string(*this, 0, j)));
+        for (size_t i = 0; i < sample.nrows(); ++i) {
+            widths[j] = std::max(widths[j], util::display_width(make_string(sample, i, j)));
         }
-        string_table.push_back(std::move(st_row));
     }
 
-    // Calculate the widths of each column
-    std::vector<size_t> widths(m_NumCols);
-    for (size_t j = 0; j < m_NumCols; ++j) {
-        size_t width_max = 0;
-        for (size_t i = 0; i < m_NumRows; ++i) {
-            width_max = std::max(width_max, string_table[i][j].size());
+    // Each line is built in one reused buffer and written whole, so that
+    // rendering a cell does not allocate. Cells wider than their sampled
+    // column width are cut short
+    std::string line;
+    const auto write_cell = [&](std::string_view str, size_t width) {
+        const size_t str_width = util::display_width(str);
+        if (str_width <= width) {
+            util::pad_string(str, str.size() + width - str_width, line);
+        } else {
+            const size_t prefix = util::display_prefix(str, width - 1);
+            line.append(str.data(), prefix);
+            line += "…";
+            line.append(width - 1 - util::display_width(str.substr(0, prefix)), ' ');
         }
-        widths[j] = width_max;
-    }
+    };
+    const auto write_row = [&](const TableView& view, size_t i) {
+        line.assign("│ ");
+        write_cell(make_string(view, i, 0), widths[0]);
+        for (size_t j = 1; j < m_NumCols; ++j) {
+            line += " ┊ ";
+            write_cell(make_string(view, i, j), widths[j]);
+        }
+        line += " │\n";
+        os << line;
+    };
+    const auto write_rule = [&](const char* left, const char* fill, const char* sep,
+        const char* right)
+    {
+        line.assign(left);
+        util::repeat_string(fill, widths[0], line);
+        for (size_t j = 1; j < m_NumCols; ++j) {
+            line += sep;
+            util::repeat_string(fill, widths[j], line);
+        }
+        line += right;
+        os << line;
+    };
 
-    std::ostringstream ss;
     // top border
-    ss << "╭─" << util::repeat_string("─", widths[0]);
-    for (size_t j = 1; j < m_NumCols; ++j) {
-        ss << "───" << util::repeat_string("─", widths[j]);
-    }
-    ss << "─╮" << std::endl;
+    write_rule("╭─", "─", "───", "─╮\n");
     // header items
-    ss << "│ " << util::pad_string_inplace(string_table[0][0], widths[0]);
-    for (size_t j = 1; j < m_NumCols; ++j) {
-        ss << " ┊ " << util::pad_string_inplace(string_table[0][j], widths[j]);
-    }
-    ss <<  " │" << std::endl;
+    write_row(*this, 0);
     // header divider
-    ss << "│ " << util::repeat_string("┄", widths[0]);
-    for (size_t j = 1; j < m_NumCols; ++j) {
-        ss << "┄┼┄" << util::repeat_string("┄", widths[j]);
-    }
-    ss << " │" << std::endl;
-    // table entries
-    for (size_t i = 1; i < m_NumRows; ++i) {
-        ss << "│ " << util::pad_string_inplace(string_table[i][0], widths[0]);
-        for (size_t j = 1; j < m_NumCols; ++j) {
-            ss << " ┊ " << util::pad_string_inplace(string_table[i][j], widths[j]);
-        }
-        ss << " │" << std::endl;
+    write_rule("│ ", "┄", "┄┼┄", " │\n");
+    // table entries, marking where rows were left out of the preview
+    const auto write_omitted = [&]() {
+        if (omitted) os << "│ ⋮ " << omitted << " more rows\n";
+    };
+    if (preview.PreviewMode == TablePreview::Mode::Tail) write_omitted();
+    for (size_t i = 0; i < shown.nrows(); ++i) {
+        write_row(shown, i);
     }
+    if (preview.PreviewMode != TablePreview::Mode::Tail) write_omitted();
     // bottom border
-    ss << "╰─" << util::repeat_string("─", widths[0]);
-    for (size_t j = 1; j < m_NumCols; ++j) {
-        ss << "───" << util::repeat_string("─", widths[j]);
-    }
-    ss << "─╯";
+    write_rule("╰─", "─", "───", "─╯");
+}
 
+template <typename _Tp>
+template <typename ToString>
+auto bits::TableView<_Tp>::str(ToString to_string) const -> std::string
+{
+    std::ostringstream ss;
+    print(ss, to_string);
     return ss.str();
 }
@@ -0,0 +1,159 @@
+#include "contacts.h"
+
+#include "app/Translate.h"
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <optional>
+#include <sstream>
+#include <string>
+
+/******************************************************************************/
+/* contacts_translator ********************************************************/
+struct contacts_translator
+{
+    char Delimiter{','};
+    std::optional<ContactFilter> Filter{};
+    std::optional<SortOrder> Order{};
+
+    std::string Input{};
+    std::string Output{};
+    size_t Pulled{};
+    bool Finished{false};
+
+    app::MappingCache Mappings{};
+    app::TranslateStats Stats{};
+    size_t BytesOut{};
+    // const functions fail with a message too
+    mutable std::string Error{};
+};
+
+namespace
+{
+    auto fail(const contacts_translator* translator, std::string message) -> int
+    {
+        translator->Error = std::move(message);
+        return -1;
+    }
+}
+
+extern "C" contacts_translator* contacts_translator_create(char delimiter)
+{
+    try {
+        auto* translator = new contacts_translator{};
+        translator->Delimiter = delimiter;
+        return translator;
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+extern "C" void contacts_translator_destroy(contacts_translator* translator)
+{
+    delete translator;
+}
+
+extern "C" int contacts_translator_set_filter(contacts_translator* translator,
+    const char* expression)
+{
+    if (!translator) return -1;
+    if (!expression) return fail(translator, "no filter expression");
+    try {
+        std::string error;
+        auto filter = ContactFilter::Compile(expression, error);
+        if (!filter) return fail(translator, "invalid filter: " + error);
+        translator->Filter = std::move(filter);
+    } catch (const std::exception& error) {
+        return fail(translator, error.what());
+    }
+    return 0;
+}
+
+extern "C" int contacts_translator_set_sort(contacts_translator* translator, const char* keys)
+{
+    if (!translator) return -1;
+    if (!keys) return fail(translator, "no sort keys");
+    try {
+        auto order = SortOrder::Parse(keys);
+        if (!order) return fail(translator, std::string{"invalid sort keys \""} + keys + "\"");
+        translator->Order = std::move(order);
+    } catch (const std::exception& error) {
+        return fail(translator, error.what());
+    }
+    return 0;
+}
+
+extern "C" int contacts_translator_feed(contacts_translator* translator,
+    const char* data, size_t size)
+{
+    if (!translator) return -1;
+    if (!data && size != 0) return fail(translator, "no input data");
+    if (translator->Finished) return fail(translator, "the translator is already finished");
+    try {
+        translator->Input.append(data, size);
+    } catch (const std::exception& error) {
+        return fail(translator, error.what());
+    }
+    return 0;
+}
+
+extern "C" int contacts_translator_finish(contacts_translator* translator)
+{
+    if (!translator) return -1;
+    if (translator->Finished) return fail(translator, "the translator is already finished");
+    translator->Finished = true;
+
+    try {
+        app::TranslateOptions options;
+        options.Delimiter = translator->Delimiter;
+        options.Mappings = &translator->Mappings;
+        options.Filter = translator->Filter ? &*translator->Filter : nullptr;
+        options.Order = translator->Order;
+
+        const size_t bytes_in = translator->Input.size();
+        std::istringstream istr{std::move(translator->Input)};
+        std::ostringstream ostr;
+        translator->Stats = app::Translate(istr, ostr, options);
+        translator->Stats.BytesIn = bytes_in;
+        translator->Input = {};
+        translator->Output = std::move(ostr).str();
+        translator->BytesOut = translator->Output.size();
+    } catch (const std::exception& error) {
+        return fail(translator, error.what());
+    }
+    return 0;
+}
+
+extern "C" size_t contacts_translator_pull(contacts_translator* translator,
+    char* buffer, size_t capacity)
+{
+    if (!translator || !buffer || !translator->Finished) return 0;
+    const size_t count = std::min(capacity, translator->Output.size() - translator->Pulled);
+    std::memcpy(buffer, translator->Output.data() + translator->Pulled, count);
+    translator->Pulled += count;
+    if (translator->Pulled == translator->Output.size()) {
+        // release the output once it has all been pulled
+        translator->Output = {};
+        translator->Pulled = 0;
+    }
+    return count;
+}
+
+extern "C" int contacts_translator_stats(const contacts_translator* translator,
+    contacts_stats* stats)
+{
+    if (!translator) return -1;
+    if (!stats) return fail(translator, "no stats to fill in");
+    stats->rows_in = translator->Stats.RowsIn;
+    stats->rows_out = translator->Stats.RowsOut;
+    stats->bytes_in = translator->Finished ? translator->Stats.BytesIn : translator->Input.size();
+    stats->bytes_out = translator->BytesOut;
+    return 0;
+}
+
+extern "C" const char* contacts_translator_error(const contacts_translator* translator)
+{
+    return translator ? translator->Error.c_str() : "";
+}
+/******************************************************************************/
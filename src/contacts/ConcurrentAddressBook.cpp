@@ -0,0 +1,58 @@
+#include "ConcurrentAddressBook.h"
+
+#include <algorithm>
+#include <bit>
+#include <utility>
+#include <vector>
+
+/******************************************************************************/
+/* ConcurrentAddressBook ******************************************************/
+ConcurrentAddressBook::ConcurrentAddressBook(size_t shards)
+    : m_ShardCount{std::bit_ceil(std::max<size_t>(shards, 1))}
+    , m_ShardShift{64 - std::countr_zero(m_ShardCount)}
+    , m_Shards{std::make_unique<Shard[]>(m_ShardCount)}
+{
+}
+
+auto ConcurrentAddressBook::insert(Contact&& contact, uint64_t sequence) -> bool
+{
+    const size_t hash = std::hash<Contact>{}(contact);
+    // the top bits of a Fibonacci hash pick the shard, leaving the sets to
+    // pick their buckets from the hash itself
+    const size_t k = (m_ShardCount == 1) ? 0
+        : static_cast<size_t>((hash * 0x9e3779b97f4a7c15ull) >> m_ShardShift);
+    auto& shard = m_Shards[k];
+
+    std::lock_guard lock{shard.Mutex};
+    const auto [itr, inserted] = shard.Entries.insert(Entry{hash, std::move(contact), sequence});
+    if (inserted) {
+        m_Size.fetch_add(1, std::memory_order_relaxed);
+    } else if (sequence < itr->Sequence) {
+        itr->Sequence = sequence;
+    }
+    return inserted;
+}
+
+auto ConcurrentAddressBook::merge(const ContactCSVInputMap& mapper) && -> AddressBook
+{
+    using Node = std::unordered_set<Entry, EntryHash>::node_type;
+    std::vector<Node> nodes;
+    nodes.reserve(size());
+    for (size_t k = 0; k < m_ShardCount; ++k) {
+        auto& entries = m_Shards[k].Entries;
+        while (!entries.empty()) nodes.push_back(entries.extract(entries.begin()));
+    }
+    std::sort(nodes.begin(), nodes.end(), [](const Node& node1, const Node& node2) {
+        return node1.value().Sequence < node2.value().Sequence;
+    });
+
+    AddressBook address_book{mapper};
+    address_book.reserve(nodes.size());
+    for (auto& node : nodes) {
+        address_book.insert(std::move(node.value().Value));
+        node = {};
+    }
+    m_Size = 0;
+    return address_book;
+}
+/******************************************************************************/
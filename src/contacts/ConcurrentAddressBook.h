@@ -0,0 +1,66 @@
+#pragma once
+
+#include "contacts/Contact.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+
+/**
+ * An insert-only set of contacts that many threads may deduplicate into at
+ * once. Contacts are spread over hash-sharded sub-tables, each behind its own
+ * lock, so that threads only contend when they insert into the same shard.
+ * Each contact is inserted with a sequence that orders it as a sequential
+ * insertion would, and merging gives the AddressBook that inserting the
+ * contacts in that order would have made.
+ */
+class ConcurrentAddressBook
+{
+public:
+    // the shard count is rounded up to a power of two
+    explicit ConcurrentAddressBook(size_t shards = 64);
+
+    // insert a contact, or lower the sequence of the equal contact already
+    // inserted; true if the contact was new. Safe from any thread
+    auto insert(Contact&& contact, uint64_t sequence) -> bool;
+    // the contacts inserted so far, without locking
+    inline auto size() const { return m_Size.load(std::memory_order_relaxed); }
+    inline auto shards() const { return m_ShardCount; }
+
+    // consume the set as an address book, its rows in sequence order; not
+    // safe while contacts are still being inserted
+    auto merge(const ContactCSVInputMap& mapper) && -> AddressBook;
+
+private:
+    struct Entry
+    {
+        size_t Hash{};
+        Contact Value{};
+        // equal contacts share a slot, so the lowest sequence may still change
+        mutable uint64_t Sequence{};
+
+        friend bool operator==(const Entry& entry1, const Entry& entry2)
+        {
+            return entry1.Hash == entry2.Hash && entry1.Value == entry2.Value;
+        }
+    };
+    struct EntryHash
+    {
+        inline auto operator()(const Entry& entry) const noexcept -> size_t { return entry.Hash; }
+    };
+
+    // a cache line each, so that threads locking neighbouring shards do not
+    // contend for the same line
+    struct alignas(64) Shard
+    {
+        std::mutex Mutex{};
+        std::unordered_set<Entry, EntryHash> Entries{};
+    };
+
+    size_t m_ShardCount;
+    int m_ShardShift;
+    std::unique_ptr<Shard[]> m_Shards;
+    std::atomic<size_t> m_Size{};
+};
@@ -1,5 +1,6 @@
 
 #include "Contact.h"
+#include "ContactSort.h"
 #include "util/string.h"
 
 #include <vector>
@@ -37,9 +38,10 @@ ContactCSVInputMap::ContactCSVInputMap(const fileio::CSVRow& header)
         return bestmatch;
     };
 
-    constexpr auto print_cell_match = [](const auto& field, const auto& cell)
+    const auto print_cell_match = [log = MatchLog.load()](const auto& field, const auto& cell)
     {
-        std::cout << "Matched \"" << cell.str() << "\" at index " << cell.col()
+        if (!log) return;
+        *log << "Matched \"" << cell.str() << "\" at index " << cell.col()
             << " as field for \"" << field << "\"" << std::endl;
     };
 
@@ -50,17 +52,11 @@ ContactCSVInputMap::ContactCSVInputMap(const fileio::CSVRow& header)
 
         if (email_address_list.size() >= 1) {
             print_cell_match(MapEmailAddress1.FieldName, email_address_list[0]);
-            const auto index = email_address_list[0].col();
-            MapEmailAddress1.MappingFunction = [=](const auto& row) {
-                return row[index].str();
-            };
+            MapEmailAddress1.Index = email_address_list[0].col();
         }
         if (email_address_list.size() >= 2) {
             print_cell_match(MapEmailAddress2.FieldName, email_address_list[1]);
-            const auto index = email_address_list[1].col();
-            MapEmailAddress2.MappingFunction = [=](const auto& row) {
-                return row[index].str();
-            };
+            MapEmailAddress2.Index = email_address_list[1].col();
         }
     }
 
@@ -70,30 +66,21 @@ ContactCSVInputMap::ContactCSVInputMap(const fileio::CSVRow& header)
             std::regex{"mob(ile)?\\s?(phone)?\\s?n(o|um(ber)?)?", std::regex::icase} );
         if (bestmatch_mobile_number) {
             print_cell_match(MapMobilePhoneNumber.FieldName, *bestmatch_mobile_number);
-            const auto index = bestmatch_mobile_number->col();
-            MapMobilePhoneNumber.MappingFunction = [=](const auto& row) {
-                return row[index].str();
-            };
+            MapMobilePhoneNumber.Index = bestmatch_mobile_number->col();
         }
 
         const auto bestmatch_home_number = find_field_bestmatch(header,
             std::regex{"home\\s?(phone)?\\s?n(o|um(ber)?)?", std::regex::icase} );
         if (bestmatch_home_number) {
             print_cell_match(MapHomePhoneNumber.FieldName, *bestmatch_home_number);
-            const auto index = bestmatch_home_number->col();
-            MapHomePhoneNumber.MappingFunction = [=](const auto& row) {
-                return row[index].str();
-            };
+            MapHomePhoneNumber.Index = bestmatch_home_number->col();
         }
 
         const auto bestmatch_work_number = find_field_bestmatch(header,
-            std::regex{"home\\s?(phone)?\\s?n(o|um(ber)?)?", std::regex::icase} );
+            std::regex{"(work|business)\\s?(phone)?\\s?n(o|um(ber)?)?", std::regex::icase} );
         if (bestmatch_work_number) {
             print_cell_match(MapWorkPhoneNumber.FieldName, *bestmatch_work_number);
-            const auto index = bestmatch_work_number->col();
-            MapWorkPhoneNumber.MappingFunction = [=](const auto& row) {
-                return row[index].str();
-            };
+            MapWorkPhoneNumber.Index = bestmatch_work_number->col();
         }
     }
 
@@ -103,75 +90,121 @@ ContactCSVInputMap::ContactCSVInputMap(const fileio::CSVRow& header)
             std::regex{"f(i?r)?(st)?\\s[\\s\\w]*name", std::regex::icase} );
         if (bestmatch_firstname) {
             print_cell_match(MapFirstName.FieldName, *bestmatch_firstname);
-            const auto index = bestmatch_firstname->col();
-            MapFirstName.MappingFunction = [=](const auto& row) {
-                return row[index].str();
-            };
+            MapFirstName.Index = bestmatch_firstname->col();
         }
 
         const auto bestmatch_lastname = find_field_bestmatch(header,
             std::regex{"la?(st)?\\s[\\s\\w]*name", std::regex::icase} );
         if (bestmatch_lastname) {
             print_cell_match(MapLastName.FieldName, *bestmatch_lastname);
-            const auto index = bestmatch_lastname->col();
-            MapLastName.MappingFunction = [=](const auto& row) {
-                return row[index].str();
-            };
+            MapLastName.Index = bestmatch_lastname->col();
         }
 
         const auto bestmatch_displayname = find_field_bestmatch(header,
             std::regex{"display\\s[\\s\\w]*name", std::regex::icase} );
         if (bestmatch_displayname) {
             print_cell_match(MapDisplayName.FieldName, *bestmatch_displayname);
-            const auto index = bestmatch_displayname->col();
-            MapDisplayName.MappingFunction = [=](const auto& row) {
-                return row[index].str();
-            };
+            MapDisplayName.Index = bestmatch_displayname->col();
         } else {
-            MapDisplayName.MappingFunction = [&](const auto& row) {
-                { // try constructing from names
-                    std::ostringstream display_from_names;
-                    const std::string first_name = MapFirstName.MappingFunction(row);
-                    if (!std::regex_match(first_name, std::regex{"\\s*"})) {
-                        display_from_names << first_name << " ";
-                    }
-                    const std::string last_name = MapLastName.MappingFunction(row);
-                    if (!std::regex_match(last_name, std::regex{"\\s*"})) {
-                        display_from_names << last_name << " ";
-                    }
-                    if (display_from_names.tellp()) {
-                        return display_from_names.str();
-                    }
-                }
-                { // try constructing from email addresses
-                    const std::string email_address1 = MapEmailAddress1.MappingFunction(row);
-                    if (!std::regex_match(email_address1, std::regex{"\\s*"})) {
-                        return email_address1;
-                    }
-                    const std::string email_address2 = MapEmailAddress2.MappingFunction(row);
-                    if (!std::regex_match(email_address2, std::regex{"\\s*"})) {
-                        return email_address2;
-                    }
-                }
-                { // try constructing from phone numbers
-                    const std::string mobile_phone_number = MapMobilePhoneNumber.MappingFunction(row);
-                    if (!std::regex_match(mobile_phone_number, std::regex{"\\s*"})) {
-                        return mobile_phone_number;
-                    }
-                    const std::string home_phone_number = MapHomePhoneNumber.MappingFunction(row);
-                    if (!std::regex_match(home_phone_number, std::regex{"\\s*"})) {
-                        return home_phone_number;
-                    }
-                    const std::string work_phone_number = MapWorkPhoneNumber.MappingFunction(row);
-                    if (!std::regex_match(work_phone_number, std::regex{"\\s*"})) {
-                        return work_phone_number;
-                    }
-                }
-                // No match found, so return an empty string.
-                return std::string();
+            ComposeDisplayName = true;
+        }
+    }
+
+    resolve();
+}
+
+void ContactCSVInputMap::resolve()
+{
+    for (auto mapper : Mappers) {
+        auto& field = this->*mapper;
+        if (field.Index) {
+            const size_t index = *field.Index;
+            field.MappingFunction = [=](const fileio::CSVRow& row) {
+                return (index < row.size()) ? row[index].str() : std::pmr::string{};
             };
+        } else {
+            field.MappingFunction = CSVMapper::DefaultCSVMappingFunction;
+        }
+    }
+    if (MapDisplayName.Index || !ComposeDisplayName) return;
+
+    // capture the other mappings by value, so that copies of this map stay
+    // valid on their own
+    static const std::regex blank_regex{"\\s*"};
+    MapDisplayName.MappingFunction = [
+        map_first_name = MapFirstName.MappingFunction,
+        map_last_name = MapLastName.MappingFunction,
+        map_email_address1 = MapEmailAddress1.MappingFunction,
+        map_email_address2 = MapEmailAddress2.MappingFunction,
+        map_mobile_phone_number = MapMobilePhoneNumber.MappingFunction,
+        map_home_phone_number = MapHomePhoneNumber.MappingFunction,
+        map_work_phone_number = MapWorkPhoneNumber.MappingFunction
+    ](const auto& row) {
+        { // try constructing from names
+            std::ostringstream display_from_names;
+            const std::pmr::string first_name = map_first_name(row);
+            if (!std::regex_match(first_name, blank_regex)) {
+                display_from_names << first_name << " ";
+            }
+            const std::pmr::string last_name = map_last_name(row);
+            if (!std::regex_match(last_name, blank_regex)) {
+                display_from_names << last_name << " ";
+            }
+            if (display_from_names.tellp()) {
+                return std::pmr::string{display_from_names.str()};
+            }
+        }
+        { // try constructing from email addresses
+            const std::pmr::string email_address1 = map_email_address1(row);
+            if (!std::regex_match(email_address1, blank_regex)) {
+                return email_address1;
+            }
+            const std::pmr::string email_address2 = map_email_address2(row);
+            if (!std::regex_match(email_address2, blank_regex)) {
+                return email_address2;
+            }
         }
+        { // try constructing from phone numbers
+            const std::pmr::string mobile_phone_number = map_mobile_phone_number(row);
+            if (!std::regex_match(mobile_phone_number, blank_regex)) {
+                return mobile_phone_number;
+            }
+            const std::pmr::string home_phone_number = map_home_phone_number(row);
+            if (!std::regex_match(home_phone_number, blank_regex)) {
+                return home_phone_number;
+            }
+            const std::pmr::string work_phone_number = map_work_phone_number(row);
+            if (!std::regex_match(work_phone_number, blank_regex)) {
+                return work_phone_number;
+            }
+        }
+        // No match found, so return an empty string.
+        return std::pmr::string{};
+    };
+}
+
+auto ContactCSVInputMap::columns() const -> std::vector<size_t>
+{
+    std::vector<size_t> columns;
+    for (const auto mapper : Mappers) {
+        if ((this->*mapper).Index) columns.push_back(*(this->*mapper).Index);
+    }
+    return columns;
+}
+
+auto ContactCSVInputMap::project(const fileio::CSVProjection& projection) const
+    -> ContactCSVInputMap
+{
+    ContactCSVInputMap projected{*this};
+    for (const auto mapper : Mappers) {
+        auto& index = (projected.*mapper).Index;
+        if (!index) continue;
+        const size_t slot = projection.slot(*index);
+        if (slot != fileio::CSVProjection::npos) index = slot;
+        else index.reset();
     }
+    projected.resolve();
+    return projected;
 }
 /******************************************************************************/
 
@@ -189,6 +222,25 @@ Contact::Contact(const fileio::CSVRow& entry, const ContactCSVInputMap& mapper)
 {
 }
 
+Contact::Contact(fileio::CSVRow&& entry, const ContactCSVInputMap& mapper)
+{
+    // fields without a column of their own, such as a composed display name,
+    // are mapped first, while every cell is still whole
+    for (size_t j = 0; j < Fields.size(); ++j) {
+        const auto& field_mapper = mapper.*ContactCSVInputMap::Mappers[j];
+        if (!field_mapper.Index) this->*Fields[j] = field_mapper(entry);
+    }
+    for (size_t j = 0; j < Fields.size(); ++j) {
+        const auto& index = (mapper.*ContactCSVInputMap::Mappers[j]).Index;
+        if (!index || *index >= entry.size()) continue;
+
+        // a column mapped to more than one field is only taken once
+        size_t k = 0;
+        while (k < j && (mapper.*ContactCSVInputMap::Mappers[k]).Index != index) ++k;
+        this->*Fields[j] = (k < j) ? this->*Fields[k] : entry[*index].take();
+    }
+}
+
 void Contact::format()
 {
     // first name
@@ -200,11 +252,11 @@ void Contact::format()
     // display name
     util::format_as_1line_proper_noun_inplace(DisplayName);
 
-    // // email address 1
-    std::remove_if(EmailAddress1.begin(), EmailAddress1.end(), isspace);
-
     // email address 1
-    std::remove_if(EmailAddress2.begin(), EmailAddress2.end(), isspace);
+    util::remove_whitespace_inplace(EmailAddress1);
+
+    // email address 2
+    util::remove_whitespace_inplace(EmailAddress2);
 
     // mobile phone number
     util::format_as_phone_number_inplace(MobilePhoneNumber);
@@ -216,6 +268,16 @@ void Contact::format()
     util::format_as_phone_number_inplace(WorkPhoneNumber);
 }
 
+auto StableHash(const Contact& contact) -> uint64_t
+{
+    uint64_t hash = util::fnv1a_64({});
+    for (const auto field : Contact::Fields) {
+        hash = util::fnv1a_64(contact.*field, hash);
+        hash = util::fnv1a_64("\x1f", hash);
+    }
+    return hash;
+}
+
 bool operator==(const Contact& contact1, const Contact& contact2)
 {
     if (contact1.FirstName != contact2.FirstName) return false;
@@ -232,8 +294,18 @@ bool operator==(const Contact& contact1, const Contact& contact2)
 
 /******************************************************************************/
 /* AddressBook ****************************************************************/
+AddressBook::AddressBook(const ContactCSVInputMap& mapper)
+    : FieldMapper{mapper}
+{
+}
+
 AddressBook::AddressBook(const fileio::CSVTable& table)
-    : FieldMapper{ContactCSVInputMap{*table.cbegin()}}
+    : AddressBook{table, table.empty() ? ContactCSVInputMap{} : ContactCSVInputMap{table.front()}}
+{
+}
+
+AddressBook::AddressBook(const fileio::CSVTable& table, const ContactCSVInputMap& mapper)
+    : FieldMapper{mapper}
 {
     auto itr = table.cbegin();
     if (itr != table.cend()) {
@@ -241,59 +313,147 @@ AddressBook::AddressBook(const fileio::CSVTable& table)
             m_Contacts.insert(Contact{*itr, FieldMapper});
         }
     }
+    reindex();
+}
+
+AddressBook::AddressBook(fileio::CSVTable&& table)
+    : AddressBook{std::move(table), table.empty() ? ContactCSVInputMap{} : ContactCSVInputMap{table.front()}}
+{
+}
+
+AddressBook::AddressBook(fileio::CSVTable&& table, const ContactCSVInputMap& mapper)
+    : FieldMapper{mapper}
+{
+    auto itr = table.begin();
+    if (itr != table.end()) {
+        for (++itr; itr != table.end(); ++itr) {
+            m_Contacts.insert(Contact{std::move(*itr), FieldMapper});
+        }
+    }
+    table.clear();
+    reindex();
+}
+
+AddressBook::AddressBook(const AddressBook& other)
+    : FieldMapper{other.FieldMapper}
+    , m_Contacts{other.m_Contacts}
+    , m_Indexed{other.m_Indexed}
+{
+    reindex();
+}
+
+auto AddressBook::insert(Contact&& contact) -> bool
+{
+    const auto [itr, inserted] = m_Contacts.insert(std::move(contact));
+    if (inserted) {
+        m_Rows.push_back(&*itr);
+        if (m_Indexed) m_Index.add(*itr);
+    }
+    return inserted;
+}
+
+void AddressBook::reserve(size_t count)
+{
+    m_Contacts.reserve(count);
+    m_Rows.reserve(count);
 }
 
 void AddressBook::format_all()
 {
-    ContactSet contacts;
-    for (auto contact : m_Contacts) {
-        contact.format();
-        contacts.insert(contact);
+    // Contacts are moved between the sets node by node, formatted on the
+    // way, in the order a copy through a second set would visit them
+    ContactSet contacts{m_Contacts.get_allocator()};
+    while (!m_Contacts.empty()) {
+        auto node = m_Contacts.extract(m_Contacts.begin());
+        node.value().format();
+        contacts.insert(std::move(node));
     }
-    m_Contacts.clear();
-    for (auto& contact : contacts) {
-        m_Contacts.insert(std::move(contact));
+    while (!contacts.empty()) {
+        m_Contacts.insert(contacts.extract(contacts.begin()));
     }
+    reindex();
 }
 
-auto AddressBook::table_view() const -> bits::TableView<const std::string>
+void AddressBook::sort(const SortOrder& order, util::ThreadPool* pool)
 {
-    std::vector<std::vector<const std::string*>> string_table;
-    string_table.reserve(m_Contacts.size()+1);
-    {
-        std::vector<const std::string*> string_entry;
-        string_entry.reserve(8);
-        string_entry.push_back(&FieldMapper.MapFirstName.FieldName);
-        string_entry.push_back(&FieldMapper.MapLastName.FieldName);
-        string_entry.push_back(&FieldMapper.MapDisplayName.FieldName);
-        string_entry.push_back(&FieldMapper.MapEmailAddress1.FieldName);
-        string_entry.push_back(&FieldMapper.MapEmailAddress2.FieldName);
-        string_entry.push_back(&FieldMapper.MapMobilePhoneNumber.FieldName);
-        string_entry.push_back(&FieldMapper.MapHomePhoneNumber.FieldName);
-        string_entry.push_back(&FieldMapper.MapWorkPhoneNumber.FieldName);
-        string_table.push_back(std::move(string_entry));
+    SortContacts(m_Rows, order, pool);
+}
+
+void AddressBook::build_index()
+{
+    m_Indexed = true;
+    m_Index.clear();
+    for (const Contact* contact : m_Rows) m_Index.add(*contact);
+}
+
+auto AddressBook::find_email(std::string_view email) const -> const Contact*
+{
+    return m_Index.find_email(email);
+}
+
+auto AddressBook::find_phone(std::string_view phone) const -> const Contact*
+{
+    return m_Index.find_phone(phone);
+}
+
+void AddressBook::reindex()
+{
+    m_Rows.clear();
+    m_Rows.reserve(m_Contacts.size());
+    for (const auto& contact : m_Contacts) {
+        m_Rows.push_back(&contact);
     }
-    for (auto itr = m_Contacts.cbegin(); itr != m_Contacts.cend(); ++itr) {
-        std::vector<const std::string*> string_entry;
-        string_entry.reserve(8);
-        string_entry.push_back(&itr->FirstName);
-        string_entry.push_back(&itr->LastName);
-        string_entry.push_back(&itr->DisplayName);
-        string_entry.push_back(&itr->EmailAddress1);
-        string_entry.push_back(&itr->EmailAddress2);
-        string_entry.push_back(&itr->MobilePhoneNumber);
-        string_entry.push_back(&itr->HomePhoneNumber);
-        string_entry.push_back(&itr->WorkPhoneNumber);
-        string_table.push_back(std::move(string_entry));
+    if (m_Indexed) build_index();
+}
+
+auto AddressBook::table_view() const -> bits::TableView<const std::pmr::string>
+{
+    // row 0 is the header, every following row is a contact
+    return bits::TableView<const std::pmr::string>{m_Rows.size()+1, Contact::Fields.size(),
+        [this](size_t i, size_t j) -> const std::pmr::string* {
+            if (i == 0) return &(FieldMapper.*ContactCSVInputMap::Mappers[j]).FieldName;
+            return &(m_Rows[i-1]->*Contact::Fields[j]);
+        }};
+}
+
+auto AddressBook::to_table() && -> fileio::CSVTable
+{
+    fileio::CSVTable table;
+    table.reserve(m_Rows.size() + 1);
+    fileio::CSVRow header{{}, 0};
+    for (size_t j = 0; j < Contact::Fields.size(); ++j) {
+        header.emplace_back((FieldMapper.*ContactCSVInputMap::Mappers[j]).FieldName, 0, j);
+    }
+    table.push_back(std::move(header));
+
+    // The set is only cleared after this, so its elements may be emptied in
+    // place even though they are its keys
+    for (size_t i = 0; i < m_Rows.size(); ++i) {
+        auto& contact = const_cast<Contact&>(*m_Rows[i]);
+        fileio::CSVRow row{{}, i + 1};
+        row.reserve(Contact::Fields.size());
+        for (size_t j = 0; j < Contact::Fields.size(); ++j) {
+            row.emplace_back(std::move(contact.*Contact::Fields[j]), i + 1, j);
+        }
+        table.push_back(std::move(row));
     }
-    return bits::TableView<const std::string>{string_table};
+    m_Rows.clear();
+    m_Contacts.clear();
+    if (m_Indexed) m_Index.clear();
+    return table;
+}
+
+void AddressBook::print(std::ostream& ostr, const bits::TablePreview& preview) const
+{
+    const auto to_string = [](const std::pmr::string& str) -> std::string_view { return str; };
+    table_view().print(ostr, to_string, preview);
 }
 
 auto AddressBook::str() const -> std::string
 {
     if (m_Contacts.empty()) return "";
 
-    const auto to_string = [](const auto& str) { return str; };
+    const auto to_string = [](const std::pmr::string& str) -> std::string_view { return str; };
     return table_view().str(to_string);
 }
 /******************************************************************************/
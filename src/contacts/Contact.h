@@ -2,38 +2,61 @@
 #pragma once
 
 #include "fileio/CSV.h"
+#include "contacts/ContactIndex.h"
 #include "util/hash.h"
 #include "bits/table_view.h"
 
 #include <unordered_set>
+#include <atomic>
 #include <functional>
 #include <string>
+#include <string_view>
+#include <vector>
+#include <memory_resource>
+#include <array>
+#include <optional>
+#include <ostream>
+
+struct SortOrder;
+namespace util { class ThreadPool; }
 
 class ContactCSVInputMap
 {
 public:
 
-    using CSVMappingFunction = std::function<std::string(const fileio::CSVRow&)>;
+    using CSVMappingFunction = std::function<std::pmr::string(const fileio::CSVRow&)>;
     class CSVMapper
     {
     public:
         explicit CSVMapper(const std::string& name)
             : FieldName{name}
         {}
-        auto operator()(const fileio::CSVRow& row) const -> std::string
+        auto operator()(const fileio::CSVRow& row) const -> std::pmr::string
         {
             return MappingFunction(row);
         }
 
         inline static const CSVMappingFunction DefaultCSVMappingFunction =
-            [](const auto&) { return ""; };
+            [](const auto&) { return std::pmr::string{}; };
         CSVMappingFunction MappingFunction{ DefaultCSVMappingFunction };
-        std::string FieldName{};
+        std::pmr::string FieldName{};
+        // the source column of this field, if it has one
+        std::optional<size_t> Index{};
     };
 
     explicit ContactCSVInputMap() = default;
     ContactCSVInputMap(const fileio::CSVRow& header);
 
+    // rebuild every MappingFunction from the Index of each mapper and the
+    // display name fallback
+    void resolve();
+
+    // the source columns that the mappers read
+    auto columns() const -> std::vector<size_t>;
+    // a copy that reads rows of projected columns, in which each source
+    // column is at its slot
+    auto project(const fileio::CSVProjection&) const -> ContactCSVInputMap;
+
     CSVMapper MapFirstName{"First Name"};
     CSVMapper MapLastName{"Last Name"};
     CSVMapper MapDisplayName{"Display Name"};
@@ -42,6 +65,21 @@ public:
     CSVMapper MapMobilePhoneNumber{"Mobile Phone Number"};
     CSVMapper MapHomePhoneNumber{"Home Phone Number"};
     CSVMapper MapWorkPhoneNumber{"Work Phone Number"};
+
+    // without a display name column, compose display names from the other fields
+    bool ComposeDisplayName{false};
+
+    // when set, the columns the header heuristics match are reported here;
+    // the library leaves it unset, and the command line sets it for --verbose
+    inline static std::atomic<std::ostream*> MatchLog{nullptr};
+
+    // every mapper, in the same order as Contact::Fields
+    static constexpr std::array<CSVMapper ContactCSVInputMap::*, 8> Mappers {
+        &ContactCSVInputMap::MapFirstName, &ContactCSVInputMap::MapLastName,
+        &ContactCSVInputMap::MapDisplayName,
+        &ContactCSVInputMap::MapEmailAddress1, &ContactCSVInputMap::MapEmailAddress2,
+        &ContactCSVInputMap::MapMobilePhoneNumber, &ContactCSVInputMap::MapHomePhoneNumber,
+        &ContactCSVInputMap::MapWorkPhoneNumber };
 };
 
 class Contact
@@ -49,21 +87,35 @@ class Contact
 public:
     explicit Contact() = default;
     Contact(const fileio::CSVRow& entry, const ContactCSVInputMap& mapper);
+    // steals the strings of the mapped cells, rather than copying them
+    Contact(fileio::CSVRow&& entry, const ContactCSVInputMap& mapper);
 
     void format();
 
-    std::string FirstName{};
-    std::string LastName{};
-    std::string DisplayName{};
-    std::string EmailAddress1{};
-    std::string EmailAddress2{};
-    std::string MobilePhoneNumber{};
-    std::string HomePhoneNumber{};
-    std::string WorkPhoneNumber{};
+    std::pmr::string FirstName{};
+    std::pmr::string LastName{};
+    std::pmr::string DisplayName{};
+    std::pmr::string EmailAddress1{};
+    std::pmr::string EmailAddress2{};
+    std::pmr::string MobilePhoneNumber{};
+    std::pmr::string HomePhoneNumber{};
+    std::pmr::string WorkPhoneNumber{};
+
+    // every field, in output column order
+    static constexpr std::array<std::pmr::string Contact::*, 8> Fields {
+        &Contact::FirstName, &Contact::LastName, &Contact::DisplayName,
+        &Contact::EmailAddress1, &Contact::EmailAddress2,
+        &Contact::MobilePhoneNumber, &Contact::HomePhoneNumber, &Contact::WorkPhoneNumber };
 
     friend bool operator==(const Contact& contact1, const Contact& contact2);
 };
 
+/**
+ * A hash of every field of a contact that is stable across runs, platforms
+ * and library versions, for partitioning contacts between files or processes.
+ */
+auto StableHash(const Contact&) -> uint64_t;
+
 namespace std {
     template<>
     struct hash<Contact>
@@ -80,17 +132,53 @@ namespace std {
 
 class AddressBook
 {
-    using ContactSet = std::unordered_set<Contact>;
+    using ContactSet = std::pmr::unordered_set<Contact>;
 public:
     explicit AddressBook() = default;
+    explicit AddressBook(const ContactCSVInputMap& mapper);
     AddressBook(const fileio::CSVTable& table);
-
+    AddressBook(const fileio::CSVTable& table, const ContactCSVInputMap& mapper);
+    // consume a table, stealing its cells
+    AddressBook(fileio::CSVTable&& table);
+    AddressBook(fileio::CSVTable&& table, const ContactCSVInputMap& mapper);
+    AddressBook(const AddressBook&);
+    AddressBook(AddressBook&&) = default;
+
+    auto insert(Contact&& contact) -> bool;
+    // make room for this many contacts without rehashing
+    void reserve(size_t count);
     void format_all();
-    auto table_view() const -> bits::TableView<const std::string>;
+    // reorder the rows, in parallel when given a pool
+    void sort(const SortOrder&, util::ThreadPool* = nullptr);
+    inline auto size() const { return m_Contacts.size(); }
+    // the i-th contact in row order: the order of insert() and sort(), until
+    // building from a table, copying or format_all() takes the set's order
+    inline auto operator[](size_t i) const -> const Contact& { return *m_Rows[i]; }
+
+    // index the contacts by email address and phone number, and keep the
+    // indexes up to date from then on
+    void build_index();
+    inline auto indexed() const { return m_Indexed; }
+    // the first contact with this email address or phone number, once the
+    // book is indexed
+    auto find_email(std::string_view) const -> const Contact*;
+    auto find_phone(std::string_view) const -> const Contact*;
+
+    auto table_view() const -> bits::TableView<const std::pmr::string>;
+    // consume the book as a table, in row order, stealing the contacts' fields
+    auto to_table() && -> fileio::CSVTable;
+    void print(std::ostream&, const bits::TablePreview& = {}) const;
     auto str() const -> std::string;
 
     const ContactCSVInputMap FieldMapper{};
 
 protected:
+    void reindex();
+
     ContactSet m_Contacts{};
+    // stable row order over m_Contacts, so views are O(1) to create
+    std::pmr::vector<const Contact*> m_Rows{};
+
+    ContactIndex m_Index{};
+    bool m_Indexed{false};
 };
@@ -0,0 +1,361 @@
+#include "ContactFilter.h"
+
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <charconv>
+
+/******************************************************************************/
+/* Selection ******************************************************************/
+Selection::Selection(size_t size, bool value)
+    : m_Words((size + 63) / 64, value ? ~uint64_t{0} : 0)
+    , m_Size{size}
+{
+    // keep the bits past the end clear, so that count() can sum whole words
+    if (value && size % 64 != 0) m_Words.back() = (uint64_t{1} << (size % 64)) - 1;
+}
+
+auto Selection::count() const -> size_t
+{
+    size_t count = 0;
+    for (const auto word : m_Words) count += std::popcount(word);
+    return count;
+}
+
+auto Selection::operator&=(const Selection& other) -> Selection&
+{
+    for (size_t w = 0; w < m_Words.size(); ++w) m_Words[w] &= other.m_Words[w];
+    return *this;
+}
+
+auto Selection::operator|=(const Selection& other) -> Selection&
+{
+    for (size_t w = 0; w < m_Words.size(); ++w) m_Words[w] |= other.m_Words[w];
+    return *this;
+}
+
+void Selection::flip()
+{
+    for (auto& word : m_Words) word = ~word;
+    if (m_Size % 64 != 0) m_Words.back() &= (uint64_t{1} << (m_Size % 64)) - 1;
+}
+/******************************************************************************/
+
+/******************************************************************************/
+/* ContactFilter **************************************************************/
+namespace
+{
+    using Op = ContactFilter::Op;
+    using Instruction = ContactFilter::Instruction;
+
+    auto lower(char c) -> char
+    {
+        return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+    }
+
+    auto trim(std::string_view str) -> std::string_view
+    {
+        const auto first = str.find_first_not_of(' ');
+        if (first == std::string_view::npos) return {};
+        return str.substr(first, str.find_last_not_of(' ') - first + 1);
+    }
+
+    // whether str starts with prefix, which is already lower case
+    auto starts_with(std::string_view str, std::string_view prefix) -> bool
+    {
+        if (str.size() < prefix.size()) return false;
+        for (size_t i = 0; i < prefix.size(); ++i) {
+            if (lower(str[i]) != prefix[i]) return false;
+        }
+        return true;
+    }
+
+    auto ends_with(std::string_view str, std::string_view suffix) -> bool
+    {
+        return str.size() >= suffix.size() && starts_with(str.substr(str.size() - suffix.size()), suffix);
+    }
+
+    auto test(const Instruction& instruction, std::string_view value) -> bool
+    {
+        const std::string_view target = instruction.Value;
+        switch (instruction.Code) {
+            case Op::Eq:
+                return value.size() == target.size() && starts_with(value, target);
+            case Op::Prefix:
+                return starts_with(value, target);
+            case Op::Contains:
+                for (size_t i = 0; i + target.size() <= value.size(); ++i) {
+                    if (starts_with(value.substr(i), target)) return true;
+                }
+                return false;
+            case Op::Domain: {
+                const auto at = value.rfind('@');
+                if (at == std::string_view::npos) return false;
+                const auto domain = value.substr(at + 1);
+                if (domain.size() == target.size()) return starts_with(domain, target);
+                return domain.size() > target.size() && ends_with(domain, target)
+                    && domain[domain.size() - target.size() - 1] == '.';
+            }
+            case Op::Empty:
+                return value.empty();
+            default:
+                return false;
+        }
+    }
+
+    /**
+     * A recursive descent parser, emitting the program in postfix order:
+     *
+     *     expr  := and ("or" and)*
+     *     and   := unary ("and" unary)*
+     *     unary := "not" unary | "(" expr ")" | test
+     *     test  := name "(" column ["," string] ")"
+     */
+    class Parser
+    {
+    public:
+        Parser(std::string_view str, std::vector<Instruction>& program, std::string& error)
+            : m_Str{str}, m_Program{program}, m_Error{error}
+        {}
+
+        auto parse() -> bool
+        {
+            if (!parse_or()) return false;
+            skip_space();
+            if (m_Pos != m_Str.size()) return fail("unexpected \"" + std::string{m_Str.substr(m_Pos)} + "\"");
+            return true;
+        }
+
+    private:
+        auto fail(const std::string& message) -> bool
+        {
+            if (m_Error.empty()) m_Error = message;
+            return false;
+        }
+
+        void skip_space()
+        {
+            while (m_Pos < m_Str.size() && std::isspace(static_cast<unsigned char>(m_Str[m_Pos]))) ++m_Pos;
+        }
+
+        auto peek_word() -> std::string_view
+        {
+            skip_space();
+            size_t end = m_Pos;
+            while (end < m_Str.size() && (std::isalnum(static_cast<unsigned char>(m_Str[end])) || m_Str[end] == '_')) ++end;
+            return m_Str.substr(m_Pos, end - m_Pos);
+        }
+
+        auto accept(char c) -> bool
+        {
+            skip_space();
+            if (m_Pos < m_Str.size() && m_Str[m_Pos] == c) { ++m_Pos; return true; }
+            return false;
+        }
+
+        auto expect(char c) -> bool
+        {
+            return accept(c) || fail(std::string{"expected '"} + c + "'");
+        }
+
+        auto parse_string(std::string& str) -> bool
+        {
+            skip_space();
+            if (m_Pos >= m_Str.size() || (m_Str[m_Pos] != '"' && m_Str[m_Pos] != '\'')) {
+                return fail("expected a quoted string");
+            }
+            const char quote = m_Str[m_Pos++];
+            for (; m_Pos < m_Str.size() && m_Str[m_Pos] != quote; ++m_Pos) {
+                if (m_Str[m_Pos] == '\\' && m_Pos + 1 < m_Str.size()) ++m_Pos;
+                str += m_Str[m_Pos];
+            }
+            if (m_Pos >= m_Str.size()) return fail("unterminated string");
+            ++m_Pos;
+            return true;
+        }
+
+        auto parse_column(Instruction& instruction) -> bool
+        {
+            if (accept('$')) return parse_string(instruction.ColumnName);
+            if (accept('#')) {
+                const auto digits = peek_word();
+                if (digits.empty() || !std::all_of(digits.begin(), digits.end(), ::isdigit)) {
+                    return fail("expected a column index after '#'");
+                }
+                size_t column = 0;
+                const auto [end, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), column);
+                if (ec != std::errc{}) return fail("column index out of range");
+                instruction.Column = column;
+                m_Pos += digits.size();
+                return true;
+            }
+
+            static constexpr std::pair<std::string_view, std::pmr::string Contact::*> fields[] {
+                {"first", &Contact::FirstName}, {"last", &Contact::LastName},
+                {"display", &Contact::DisplayName},
+                {"email1", &Contact::EmailAddress1}, {"email2", &Contact::EmailAddress2},
+                {"mobile", &Contact::MobilePhoneNumber}, {"home", &Contact::HomePhoneNumber},
+                {"work", &Contact::WorkPhoneNumber} };
+            const auto name = peek_word();
+            for (const auto& [field_name, field] : fields) {
+                if (name == field_name) {
+                    instruction.Field = field;
+                    m_Pos += name.size();
+                    return true;
+                }
+            }
+            return fail("unknown field \"" + std::string{name} + "\"");
+        }
+
+        auto parse_test() -> bool
+        {
+            static constexpr std::pair<std::string_view, Op> tests[] {
+                {"eq", Op::Eq}, {"prefix", Op::Prefix}, {"contains", Op::Contains},
+                {"domain", Op::Domain}, {"empty", Op::Empty} };
+            const auto name = peek_word();
+            const auto itr = std::find_if(std::begin(tests), std::end(tests),
+                [&](const auto& test) { return test.first == name; });
+            if (itr == std::end(tests)) {
+                return fail(name.empty() ? "expected a test" : "unknown test \"" + std::string{name} + "\"");
+            }
+            m_Pos += name.size();
+
+            Instruction instruction;
+            instruction.Code = itr->second;
+            if (!expect('(') || !parse_column(instruction)) return false;
+            if (instruction.Code != Op::Empty) {
+                if (!expect(',') || !parse_string(instruction.Value)) return false;
+                std::string value{trim(instruction.Value)};
+                std::transform(value.begin(), value.end(), value.begin(), lower);
+                instruction.Value = std::move(value);
+            }
+            if (!expect(')')) return false;
+            m_Program.push_back(std::move(instruction));
+            return true;
+        }
+
+        auto parse_unary() -> bool
+        {
+            if (peek_word() == "not") {
+                m_Pos += 3;
+                if (!parse_unary()) return false;
+                m_Program.push_back(Instruction{Op::Not});
+                return true;
+            }
+            if (accept('(')) return parse_or() && expect(')');
+            return parse_test();
+        }
+
+        auto parse_and() -> bool
+        {
+            if (!parse_unary()) return false;
+            while (peek_word() == "and") {
+                m_Pos += 3;
+                if (!parse_unary()) return false;
+                m_Program.push_back(Instruction{Op::And});
+            }
+            return true;
+        }
+
+        auto parse_or() -> bool
+        {
+            if (!parse_and()) return false;
+            while (peek_word() == "or") {
+                m_Pos += 2;
+                if (!parse_and()) return false;
+                m_Program.push_back(Instruction{Op::Or});
+            }
+            return true;
+        }
+
+        std::string_view m_Str;
+        size_t m_Pos{};
+        std::vector<Instruction>& m_Program;
+        std::string& m_Error;
+    };
+}
+
+auto ContactFilter::Compile(std::string_view expression, std::string& error)
+    -> std::optional<ContactFilter>
+{
+    ContactFilter filter;
+    filter.m_Expression = expression;
+    if (!Parser{expression, filter.m_Program, error}.parse()) return std::nullopt;
+    for (const auto& instruction : filter.m_Program) {
+        if (instruction.Field != nullptr) filter.m_RawOnly = false;
+    }
+    return filter;
+}
+
+auto ContactFilter::bind(const fileio::CSVRow& header) const -> ContactFilter
+{
+    ContactFilter filter{*this};
+    for (auto& instruction : filter.m_Program) {
+        if (instruction.ColumnName.empty()) continue;
+        const auto itr = std::find_if(header.begin(), header.end(), [&](const auto& cell) {
+            return trim(cell.str()) == trim(instruction.ColumnName);
+        });
+        if (itr != header.end()) instruction.Column = itr->col();
+        else instruction.Column.reset();
+    }
+    return filter;
+}
+
+auto ContactFilter::columns() const -> std::vector<size_t>
+{
+    std::vector<size_t> columns;
+    for (const auto& instruction : m_Program) {
+        if (instruction.Column) columns.push_back(*instruction.Column);
+    }
+    return columns;
+}
+
+auto ContactFilter::project(const fileio::CSVProjection& projection) const -> ContactFilter
+{
+    ContactFilter filter{*this};
+    for (auto& instruction : filter.m_Program) {
+        if (!instruction.Column) continue;
+        const size_t slot = projection.slot(*instruction.Column);
+        if (slot != fileio::CSVProjection::npos) instruction.Column = slot;
+        else instruction.Column.reset();
+    }
+    return filter;
+}
+
+auto ContactFilter::select(const fileio::CSVRow* rows, size_t count,
+    const Contact* contacts) const -> Selection
+{
+    // each test reads its whole column before the next test runs
+    std::vector<Selection> stack;
+    std::vector<std::string_view> values(count);
+    for (const auto& instruction : m_Program) {
+        if (instruction.Code == Op::And || instruction.Code == Op::Or) {
+            Selection rhs = std::move(stack.back());
+            stack.pop_back();
+            if (instruction.Code == Op::And) stack.back() &= rhs;
+            else stack.back() |= rhs;
+            continue;
+        }
+        if (instruction.Code == Op::Not) {
+            stack.back().flip();
+            continue;
+        }
+
+        if (instruction.Field != nullptr) {
+            for (size_t i = 0; i < count; ++i) values[i] = trim(contacts[i].*instruction.Field);
+        } else {
+            // a column that is not in the input reads as empty
+            const size_t col = instruction.Column.value_or(static_cast<size_t>(-1));
+            for (size_t i = 0; i < count; ++i) {
+                values[i] = (col < rows[i].size()) ? trim(rows[i][col].str()) : std::string_view{};
+            }
+        }
+        Selection selection{count};
+        for (size_t i = 0; i < count; ++i) {
+            if (test(instruction, values[i])) selection.set(i);
+        }
+        stack.push_back(std::move(selection));
+    }
+    return stack.empty() ? Selection{count, true} : std::move(stack.back());
+}
+/******************************************************************************/
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "fileio/CSV.h"
+#include "contacts/Contact.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * A bitmap with one bit per row of a batch, marking the rows selected.
+ */
+class Selection
+{
+public:
+    explicit Selection(size_t size = 0, bool value = false);
+
+    inline auto size() const { return m_Size; }
+    inline auto test(size_t i) const -> bool { return (m_Words[i / 64] >> (i % 64)) & 1; }
+    inline void set(size_t i) { m_Words[i / 64] |= uint64_t{1} << (i % 64); }
+    auto count() const -> size_t;
+
+    auto operator&=(const Selection&) -> Selection&;
+    auto operator|=(const Selection&) -> Selection&;
+    void flip();
+
+private:
+    std::vector<uint64_t> m_Words{};
+    size_t m_Size{};
+};
+
+/**
+ * A predicate over contacts, compiled once from an expression such as
+ *
+ *     domain(email1, "example.com") and not empty(mobile)
+ *     prefix($"Last Name", "Mc") or eq(#3, "VIP")
+ *
+ * Tests are eq, prefix, contains, domain (the part of an address after its
+ * @, or a subdomain of it) and empty, combined with and, or, not and
+ * parentheses. A test reads either a formatted contact field (first, last,
+ * display, email1, email2, mobile, home or work) or a raw input column,
+ * named by its header ($"name") or index (#index). Comparisons ignore ASCII
+ * case and surrounding spaces.
+ *
+ * A filter is evaluated a test at a time over a whole batch of rows, each
+ * test producing a Selection. A filter that only reads raw columns can
+ * select rows before they are made into contacts.
+ */
+class ContactFilter
+{
+public:
+    static auto Compile(std::string_view expression, std::string& error)
+        -> std::optional<ContactFilter>;
+
+    // resolve the raw columns named in the filter against an input header;
+    // columns that it does not have read as empty
+    auto bind(const fileio::CSVRow& header) const -> ContactFilter;
+
+    inline auto raw_only() const { return m_RawOnly; }
+    // the raw columns that a bound filter reads
+    auto columns() const -> std::vector<size_t>;
+    // a copy of a bound filter that reads rows of projected columns, in
+    // which each raw column is at its slot
+    auto project(const fileio::CSVProjection&) const -> ContactFilter;
+    inline auto& expression() const { return m_Expression; }
+
+    // select from rows[0, count), and from the contacts made from them
+    // unless the filter is raw_only
+    auto select(const fileio::CSVRow* rows, size_t count,
+        const Contact* contacts = nullptr) const -> Selection;
+
+    enum class Op { Eq, Prefix, Contains, Domain, Empty, And, Or, Not };
+
+    struct Instruction
+    {
+        Op Code{};
+        // the contact field read, if not a raw column
+        std::pmr::string Contact::* Field{nullptr};
+        std::string ColumnName{};
+        std::optional<size_t> Column{};
+        std::string Value{};
+    };
+
+private:
+    std::string m_Expression{};
+    // the expression in postfix order
+    std::vector<Instruction> m_Program{};
+    bool m_RawOnly{true};
+};
@@ -0,0 +1,99 @@
+#include "ContactIndex.h"
+#include "Contact.h"
+
+/******************************************************************************/
+/* ContactIndex ***************************************************************/
+namespace
+{
+    // the canonical forms, written into a key whose capacity is reused
+    void canonical_email(std::string_view email, std::string& key)
+    {
+        key.clear();
+        const size_t begin = email.find_first_not_of(" \t");
+        if (begin == std::string_view::npos) return;
+        email = email.substr(begin, email.find_last_not_of(" \t") + 1 - begin);
+        key.resize(email.size());
+        for (size_t i = 0; i < email.size(); ++i) {
+            const char c = email[i];
+            key[i] = (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+        }
+    }
+
+    void normalized_phone(std::string_view phone, std::string& key)
+    {
+        key.clear();
+        for (const char c : phone) {
+            if (c >= '0' && c <= '9') key += c;
+            else if (c == '+' && key.empty()) key += c;
+        }
+        // a lone + is no number at all
+        if (key == "+") key.clear();
+    }
+
+    // lookups canonicalize into this, so that they do not allocate
+    thread_local std::string t_Key;
+}
+
+auto ContactIndex::CanonicalEmail(std::string_view email) -> std::string
+{
+    std::string key;
+    canonical_email(email, key);
+    return key;
+}
+
+auto ContactIndex::NormalizedPhone(std::string_view phone) -> std::string
+{
+    std::string key;
+    normalized_phone(phone, key);
+    return key;
+}
+
+void ContactIndex::CanonicalEmail(std::string_view email, std::string& key)
+{
+    canonical_email(email, key);
+}
+
+void ContactIndex::NormalizedPhone(std::string_view phone, std::string& key)
+{
+    normalized_phone(phone, key);
+}
+
+void ContactIndex::add(const Contact& contact)
+{
+    const auto index = [&](Map& map) {
+        if (!t_Key.empty() && map.find(std::string_view{t_Key}) == map.end()) {
+            map.emplace(std::pmr::string{t_Key}, &contact);
+        }
+    };
+    for (const auto field : { &Contact::EmailAddress1, &Contact::EmailAddress2 }) {
+        canonical_email(contact.*field, t_Key);
+        index(m_Emails);
+    }
+    for (const auto field : { &Contact::MobilePhoneNumber, &Contact::HomePhoneNumber,
+        &Contact::WorkPhoneNumber })
+    {
+        normalized_phone(contact.*field, t_Key);
+        index(m_Phones);
+    }
+}
+
+void ContactIndex::clear()
+{
+    m_Emails.clear();
+    m_Phones.clear();
+}
+
+auto ContactIndex::find_email(std::string_view email) const -> const Contact*
+{
+    canonical_email(email, t_Key);
+    const auto itr = m_Emails.find(std::string_view{t_Key});
+    return (itr != m_Emails.end()) ? itr->second : nullptr;
+}
+
+auto ContactIndex::find_phone(std::string_view phone) const -> const Contact*
+{
+    normalized_phone(phone, t_Key);
+    const auto itr = m_Phones.find(std::string_view{t_Key});
+    return (itr != m_Phones.end()) ? itr->second : nullptr;
+}
+/******************************************************************************/
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <functional>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+class Contact;
+
+/**
+ * Secondary indexes over a set of contacts, from each canonical email address
+ * and each normalized phone number to the first contact added that has it.
+ * The index holds pointers to the contacts, which must outlive it.
+ */
+class ContactIndex
+{
+public:
+    // an email address without surrounding spaces, in ASCII lower case
+    static auto CanonicalEmail(std::string_view) -> std::string;
+    // the digits of a phone number, after a leading + if it has one
+    static auto NormalizedPhone(std::string_view) -> std::string;
+    // the same, written into a key whose capacity is reused
+    static void CanonicalEmail(std::string_view, std::string& key);
+    static void NormalizedPhone(std::string_view, std::string& key);
+
+    void add(const Contact&);
+    void clear();
+
+    auto find_email(std::string_view email) const -> const Contact*;
+    auto find_phone(std::string_view phone) const -> const Contact*;
+
+    inline auto emails() const { return m_Emails.size(); }
+    inline auto phones() const { return m_Phones.size(); }
+
+private:
+    // hashes std::pmr::string keys and std::string_view lookups alike
+    struct KeyHash
+    {
+        using is_transparent = void;
+        inline auto operator()(std::string_view key) const noexcept -> size_t
+        {
+            return std::hash<std::string_view>{}(key);
+        }
+    };
+    using Map = std::pmr::unordered_map<std::pmr::string, const Contact*, KeyHash, std::equal_to<>>;
+
+    Map m_Emails{};
+    Map m_Phones{};
+};
@@ -0,0 +1,286 @@
+#include "ContactSort.h"
+
+#include "util/parallel_sort.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <numeric>
+#include <queue>
+#include <tuple>
+
+#include <unistd.h>
+
+/******************************************************************************/
+/* SortOrder ******************************************************************/
+auto SortOrder::Parse(std::string_view str) -> std::optional<SortOrder>
+{
+    SortOrder order;
+    order.Keys.clear();
+    while (!str.empty()) {
+        const auto comma = std::min(str.find(','), str.size());
+        const auto name = str.substr(0, comma);
+        if (name == "last") order.Keys.push_back(SortKey::LastName);
+        else if (name == "first") order.Keys.push_back(SortKey::FirstName);
+        else if (name == "display") order.Keys.push_back(SortKey::DisplayName);
+        else if (name == "email") order.Keys.push_back(SortKey::EmailAddress);
+        else return std::nullopt;
+        str.remove_prefix(std::min(comma + 1, str.size()));
+    }
+    if (order.Keys.empty()) return std::nullopt;
+    return order;
+}
+
+auto SortOrder::str() const -> std::string
+{
+    std::string str;
+    for (const auto sort_key : Keys) {
+        if (!str.empty()) str += ',';
+        switch (sort_key) {
+            case SortKey::LastName: str += "last"; break;
+            case SortKey::FirstName: str += "first"; break;
+            case SortKey::DisplayName: str += "display"; break;
+            case SortKey::EmailAddress: str += "email"; break;
+        }
+    }
+    return str;
+}
+
+auto SortOrder::key(const Contact& contact) const -> std::string
+{
+    std::string key;
+    const auto append_normalized = [&](std::string_view value) {
+        const auto first = value.find_first_not_of(' ');
+        const auto last = value.find_last_not_of(' ');
+        if (first == std::string_view::npos) {
+            // empty values sort after every other value
+            key += '\x02';
+        } else {
+            key += '\x01';
+            for (char c : value.substr(first, last - first + 1)) {
+                key += static_cast<char>((c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c);
+            }
+        }
+        key += '\0';
+    };
+
+    for (const auto sort_key : Keys) {
+        switch (sort_key) {
+            case SortKey::LastName: append_normalized(contact.LastName); break;
+            case SortKey::FirstName: append_normalized(contact.FirstName); break;
+            case SortKey::DisplayName: append_normalized(contact.DisplayName); break;
+            case SortKey::EmailAddress:
+                append_normalized(contact.EmailAddress1.find_first_not_of(' ') != std::string::npos
+                    ? contact.EmailAddress1 : contact.EmailAddress2);
+                break;
+        }
+    }
+    for (const auto field : Contact::Fields) {
+        key += contact.*field;
+        key += '\0';
+    }
+    return key;
+}
+/******************************************************************************/
+
+/******************************************************************************/
+/* SortContacts ***************************************************************/
+namespace
+{
+    // the order of the keys, as a permutation of their indices
+    auto sorted_order(const std::vector<std::string>& keys, util::ThreadPool* pool)
+        -> std::vector<size_t>
+    {
+        std::vector<size_t> order(keys.size());
+        std::iota(order.begin(), order.end(), 0);
+        const auto less = [&](size_t a, size_t b) { return keys[a] < keys[b]; };
+        if (pool) util::parallel_sort(order.begin(), order.end(), less, *pool);
+        else std::stable_sort(order.begin(), order.end(), less);
+        return order;
+    }
+}
+
+void SortContacts(std::pmr::vector<const Contact*>& contacts, const SortOrder& order,
+    util::ThreadPool* pool)
+{
+    std::vector<std::string> keys(contacts.size());
+    for (size_t i = 0; i < contacts.size(); ++i) keys[i] = order.key(*contacts[i]);
+
+    const auto permutation = sorted_order(keys, pool);
+    std::pmr::vector<const Contact*> sorted{contacts.get_allocator()};
+    sorted.reserve(contacts.size());
+    for (const size_t i : permutation) sorted.push_back(contacts[i]);
+    contacts = std::move(sorted);
+}
+
+auto ContactFootprint(const Contact& contact) -> size_t
+{
+    size_t bytes = sizeof(Contact);
+    for (const auto field : Contact::Fields) bytes += (contact.*field).size();
+    return bytes;
+}
+
+void WriteContactRecord(std::ostream& ostr, const Contact& contact)
+{
+    for (const auto field : Contact::Fields) {
+        const auto& value = contact.*field;
+        const auto length = static_cast<uint32_t>(value.size());
+        ostr.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        ostr.write(value.data(), length);
+    }
+}
+
+auto ReadContactRecord(std::istream& istr, Contact& contact) -> bool
+{
+    for (const auto field : Contact::Fields) {
+        uint32_t length = 0;
+        if (!istr.read(reinterpret_cast<char*>(&length), sizeof(length))) return false;
+        auto& value = contact.*field;
+        value.resize(length);
+        if (!istr.read(value.data(), length)) return false;
+    }
+    return true;
+}
+/******************************************************************************/
+
+/******************************************************************************/
+/* ContactSorter **************************************************************/
+namespace
+{
+    struct RunReader
+    {
+        std::ifstream Stream{};
+        Contact Current{};
+        std::string Key{};
+    };
+}
+
+ContactSorter::ContactSorter(const SortOrder& order, size_t max_memory, std::string spill_dir,
+    util::ThreadPool* pool)
+    : m_Order{order}
+    , m_MaxMemory{max_memory}
+    , m_SpillDir{spill_dir.empty() ? std::filesystem::temp_directory_path().string() : spill_dir}
+    , m_Pool{pool}
+{
+}
+
+ContactSorter::~ContactSorter()
+{
+    std::error_code error;
+    for (const auto& run : m_Runs) std::filesystem::remove(run, error);
+}
+
+void ContactSorter::add(Contact contact)
+{
+    m_Keys.push_back(m_Order.key(contact));
+    m_BufferBytes += ContactFootprint(contact) + sizeof(std::string) + m_Keys.back().size();
+    m_Contacts.push_back(std::move(contact));
+
+    if (m_MaxMemory != 0 && m_BufferBytes > m_MaxMemory && !m_SpillFailed && !spill()) {
+        // without anywhere to spill, keep sorting in memory
+        std::cerr << "Cannot spill sorted contacts to " << m_SpillDir << std::endl;
+        m_SpillFailed = true;
+    }
+}
+
+void ContactSorter::sort_buffer()
+{
+    const auto permutation = sorted_order(m_Keys, m_Pool);
+    std::vector<Contact> contacts;
+    std::vector<std::string> keys;
+    contacts.reserve(m_Contacts.size());
+    keys.reserve(m_Keys.size());
+    for (const size_t i : permutation) {
+        contacts.push_back(std::move(m_Contacts[i]));
+        keys.push_back(std::move(m_Keys[i]));
+    }
+    m_Contacts = std::move(contacts);
+    m_Keys = std::move(keys);
+}
+
+auto ContactSorter::spill() -> bool
+{
+    static std::atomic<size_t> s_NextRun{0};
+    const auto path = (std::filesystem::path{m_SpillDir} / ("contacts-sort-"
+        + std::to_string(getpid()) + "-" + std::to_string(s_NextRun++) + ".run")).string();
+
+    std::ofstream file{path, std::ios::binary};
+    if (!file) return false;
+
+    sort_buffer();
+    for (const auto& contact : m_Contacts) WriteContactRecord(file, contact);
+    file.close();
+    if (!file) {
+        std::error_code error;
+        std::filesystem::remove(path, error);
+        return false;
+    }
+    m_Runs.push_back(path);
+
+    m_Contacts.clear();
+    m_Keys.clear();
+    m_BufferBytes = 0;
+    return true;
+}
+
+void ContactSorter::merge(const std::function<void(const Contact&)>& emit, bool unique)
+{
+    sort_buffer();
+
+    // A k-way merge of the runs and the sorted buffer, which is the last
+    // source, taking the least key of any source each step
+    const size_t nruns = m_Runs.size();
+    std::vector<RunReader> readers(nruns);
+    size_t buffered = 0;
+    const auto key_of = [&](size_t k) -> const std::string& {
+        return (k < nruns) ? readers[k].Key : m_Keys[buffered];
+    };
+    const auto greater = [&](size_t a, size_t b) {
+        return std::tie(key_of(a), a) > std::tie(key_of(b), b);
+    };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(greater)> heap{greater};
+    const auto advance = [&](size_t k) {
+        if (k == nruns) {
+            if (++buffered < m_Contacts.size()) heap.push(k);
+            return;
+        }
+        if (!ReadContactRecord(readers[k].Stream, readers[k].Current)) return;
+        readers[k].Key = m_Order.key(readers[k].Current);
+        heap.push(k);
+    };
+
+    for (size_t k = 0; k < nruns; ++k) {
+        readers[k].Stream.open(m_Runs[k], std::ios::binary);
+        advance(k);
+    }
+    // equal contacts come out next to each other, so a duplicate only has
+    // to be compared with the contact before it, which is moved aside
+    // rather than copied
+    Contact previous;
+    bool emitted = false;
+    if (!m_Contacts.empty()) heap.push(nruns);
+    while (!heap.empty()) {
+        const size_t k = heap.top();
+        heap.pop();
+        auto& contact = (k < nruns) ? readers[k].Current : m_Contacts[buffered];
+        if (!unique) {
+            emit(contact);
+        } else if (!emitted || !(contact == previous)) {
+            emit(contact);
+            emitted = true;
+            previous = std::move(contact);
+        }
+        advance(k);
+    }
+
+    readers.clear();
+    std::error_code error;
+    for (const auto& run : m_Runs) std::filesystem::remove(run, error);
+    m_Runs.clear();
+    m_Contacts.clear();
+    m_Keys.clear();
+    m_BufferBytes = 0;
+}
+/******************************************************************************/
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "contacts/Contact.h"
+#include "util/thread_pool.h"
+
+#include <fstream>
+#include <functional>
+#include <istream>
+#include <memory_resource>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum class SortKey
+{
+    LastName,       // last
+    FirstName,      // first
+    DisplayName,    // display
+    EmailAddress,   // email, the first non-empty address
+};
+
+/**
+ * The keys that contacts are ordered by, most significant first. Keys are
+ * compared in ASCII lower case, ignoring surrounding spaces, with empty values
+ * last; other bytes, including those of non-ASCII letters, compare as they
+ * are. Ties are broken by every field in column order, so that the order of
+ * distinct contacts never depends on the order they were read in, and equal
+ * contacts sort next to each other.
+ */
+struct SortOrder
+{
+    std::vector<SortKey> Keys{SortKey::LastName, SortKey::FirstName, SortKey::EmailAddress};
+
+    // a comma separated list of key names, such as "last,first,email"
+    static auto Parse(std::string_view) -> std::optional<SortOrder>;
+    auto str() const -> std::string;
+
+    // the normalized key of a contact, compared bytewise
+    auto key(const Contact&) const -> std::string;
+};
+
+/**
+ * Sort contacts by precomputed normalized keys, with a parallel merge sort
+ * when given a pool.
+ */
+void SortContacts(std::pmr::vector<const Contact*>&, const SortOrder&,
+    util::ThreadPool* = nullptr);
+
+// the approximate number of bytes a contact occupies in memory
+auto ContactFootprint(const Contact&) -> size_t;
+
+/**
+ * Spill files hold each contact as its fields in column order, each a 32-bit
+ * length followed by that many bytes.
+ */
+void WriteContactRecord(std::ostream&, const Contact&);
+auto ReadContactRecord(std::istream&, Contact&) -> bool;
+
+/**
+ * Sorts contacts that are added one at a time, within a memory budget.
+ * Contacts are buffered and sorted in memory, but whenever the buffer
+ * outgrows the budget it is sorted and spilled to a run file, and the runs
+ * are merged k ways at the end.
+ */
+class ContactSorter
+{
+public:
+    // a max_memory of 0 never spills; runs are written to spill_dir, or to
+    // the system temporary directory
+    ContactSorter(const SortOrder&, size_t max_memory, std::string spill_dir = {},
+        util::ThreadPool* = nullptr);
+    ~ContactSorter();
+
+    ContactSorter(const ContactSorter&) = delete;
+    ContactSorter& operator=(const ContactSorter&) = delete;
+
+    void add(Contact contact);
+    // pass every contact added to emit, in order, and reset the sorter; when
+    // unique, only the first of equal contacts is passed
+    void merge(const std::function<void(const Contact&)>& emit, bool unique = false);
+
+    inline auto runs() const { return m_Runs.size(); }
+
+private:
+    void sort_buffer();
+    auto spill() -> bool;
+
+    const SortOrder m_Order;
+    const size_t m_MaxMemory;
+    const std::string m_SpillDir;
+    util::ThreadPool* m_Pool;
+
+    std::vector<Contact> m_Contacts{};
+    std::vector<std::string> m_Keys{};
+    size_t m_BufferBytes{};
+    std::vector<std::string> m_Runs{};
+    bool m_SpillFailed{false};
+};
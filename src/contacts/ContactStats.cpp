@@ -0,0 +1,144 @@
+#include "ContactStats.h"
+#include "ContactIndex.h"
+
+#include <cmath>
+#include <iomanip>
+
+/******************************************************************************/
+/* ContactStats ***************************************************************/
+namespace
+{
+    // the report's name for each field, in Contact::Fields order
+    constexpr std::array<std::string_view, Contact::Fields.size()> FieldKeys {
+        "first_name", "last_name", "display_name", "email_address_1", "email_address_2",
+        "mobile_phone_number", "home_phone_number", "work_phone_number" };
+
+    auto sketch_hash(std::string_view value) -> uint64_t
+    {
+        return util::mix64(util::fnv1a_64(value));
+    }
+
+    void write_json_string(std::ostream& ostr, std::string_view str)
+    {
+        ostr << '"';
+        for (const char c : str) {
+            switch (c) {
+                case '"': ostr << "\\\""; break;
+                case '\\': ostr << "\\\\"; break;
+                case '\n': ostr << "\\n"; break;
+                case '\r': ostr << "\\r"; break;
+                case '\t': ostr << "\\t"; break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        ostr << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+                            << static_cast<int>(c) << std::dec << std::setfill(' ');
+                    } else {
+                        ostr << c;
+                    }
+            }
+        }
+        ostr << '"';
+    }
+
+    auto rate(size_t count, size_t total) -> double
+    {
+        return total ? static_cast<double>(count) / static_cast<double>(total) : 0.0;
+    }
+}
+
+auto ContactStats::ValidEmail(std::string_view canonical) -> bool
+{
+    const size_t at = canonical.find('@');
+    if (at == 0 || at == std::string_view::npos || canonical.find('@', at + 1) != std::string_view::npos) {
+        return false;
+    }
+    const auto domain = canonical.substr(at + 1);
+    const size_t dot = domain.find('.');
+    return dot != 0 && dot != std::string_view::npos && domain.back() != '.'
+        && canonical.find_first_of(" \t,;<>") == std::string_view::npos;
+}
+
+auto ContactStats::ValidPhone(std::string_view normalized) -> bool
+{
+    const size_t digits = normalized.size() - (normalized.starts_with('+') ? 1 : 0);
+    return digits >= 7 && digits <= 15;
+}
+
+void ContactStats::add(const Contact& contact)
+{
+    m_Contacts += 1;
+    for (size_t j = 0; j < Contact::Fields.size(); ++j) {
+        const auto& value = contact.*Contact::Fields[j];
+        if (value.find_first_not_of(" \t") != std::string::npos) m_Filled[j] += 1;
+    }
+    if (!contact.DisplayName.empty()) m_Names.add(sketch_hash(contact.DisplayName));
+
+    for (const auto field : { &Contact::EmailAddress1, &Contact::EmailAddress2 }) {
+        ContactIndex::CanonicalEmail(contact.*field, m_Key);
+        if (m_Key.empty()) continue;
+        m_Emails.Present += 1;
+        m_Emails.Distinct.add(sketch_hash(m_Key));
+        if (!ValidEmail(m_Key)) continue;
+        m_Emails.Valid += 1;
+        const auto domain = std::string_view{m_Key}.substr(m_Key.find('@') + 1);
+        m_Domains.add(sketch_hash(domain));
+        m_TopDomains.add(domain);
+    }
+    for (const auto field : { &Contact::MobilePhoneNumber, &Contact::HomePhoneNumber,
+        &Contact::WorkPhoneNumber })
+    {
+        if ((contact.*field).find_first_not_of(" \t") == std::string::npos) continue;
+        m_Phones.Present += 1;
+        ContactIndex::NormalizedPhone(contact.*field, m_Key);
+        if (m_Key.empty()) continue;
+        m_Phones.Distinct.add(sketch_hash(m_Key));
+        if (ValidPhone(m_Key)) m_Phones.Valid += 1;
+    }
+}
+
+void ContactStats::write_json(std::ostream& ostr) const
+{
+    const auto estimate = [](const auto& sketch) {
+        return static_cast<size_t>(std::llround(sketch.estimate()));
+    };
+    const auto write_values = [&](const char* name, const ValueStats& values) {
+        ostr << "  \"" << name << "\": {\"present\": " << values.Present
+            << ", \"valid\": " << values.Valid
+            << ", \"invalid\": " << (values.Present - values.Valid)
+            << ", \"valid_rate\": " << rate(values.Valid, values.Present)
+            << ", \"distinct_estimate\": " << estimate(values.Distinct) << "},\n";
+    };
+
+    const auto flags = ostr.flags();
+    const auto precision = ostr.precision();
+    ostr << std::fixed << std::setprecision(4);
+    ostr << "{\n"
+        << "  \"contacts\": " << m_Contacts << ",\n"
+        << "  \"duplicates\": " << m_Duplicates << ",\n"
+        << "  \"duplicate_rate\": " << rate(m_Duplicates, m_Contacts + m_Duplicates) << ",\n"
+        << "  \"fields\": {\n";
+    for (size_t j = 0; j < FieldKeys.size(); ++j) {
+        ostr << "    \"" << FieldKeys[j] << "\": {\"filled\": " << m_Filled[j]
+            << ", \"fill_rate\": " << rate(m_Filled[j], m_Contacts) << "}"
+            << (j + 1 < FieldKeys.size() ? ",\n" : "\n");
+    }
+    ostr << "  },\n";
+    write_values("emails", m_Emails);
+    write_values("phones", m_Phones);
+    ostr << "  \"display_names\": {\"distinct_estimate\": " << estimate(m_Names) << "},\n"
+        << "  \"domains\": {\"distinct_estimate\": " << estimate(m_Domains) << ", \"top\": [";
+    const auto top = m_TopDomains.top(TopDomains);
+    for (size_t i = 0; i < top.size(); ++i) {
+        ostr << (i ? ",\n" : "\n") << "    {\"domain\": ";
+        write_json_string(ostr, top[i].Key);
+        ostr << ", \"count\": " << top[i].Count << ", \"error\": " << top[i].Error << "}";
+    }
+    ostr << (top.empty() ? "]},\n" : "\n  ]},\n");
+    const size_t sketch_bytes = m_Emails.Distinct.bytes() + m_Phones.Distinct.bytes()
+        + m_Domains.bytes() + m_Names.bytes() + m_TopDomains.bytes();
+    ostr << "  \"sketch_bytes\": " << sketch_bytes << "\n"
+        << "}\n";
+    ostr.flags(flags);
+    ostr.precision(precision);
+}
+/******************************************************************************/
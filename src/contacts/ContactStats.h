@@ -0,0 +1,59 @@
+#pragma once
+
+#include "contacts/Contact.h"
+#include "util/sketch.h"
+
+#include <array>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+/**
+ * Data quality statistics of the contacts of a translation, gathered as they
+ * are written so that no second pass over the data is needed: how many of
+ * each field are filled, how many email addresses and phone numbers are
+ * valid once normalized (see ContactIndex), estimates of their distinct
+ * counts by HyperLogLog, and the most common email domains by space-saving.
+ * Not safe to share between threads.
+ */
+class ContactStats
+{
+public:
+    // the number of most common domains kept and reported
+    static constexpr size_t TopDomains = 20;
+
+    // a contact written, once formatted
+    void add(const Contact&);
+    // contacts dropped as duplicates of ones written
+    inline void add_duplicates(size_t count = 1) { m_Duplicates += count; }
+
+    inline auto contacts() const { return m_Contacts; }
+    inline auto duplicates() const { return m_Duplicates; }
+
+    // a canonical email address has one @, with a dot inside the domain after it
+    static auto ValidEmail(std::string_view canonical) -> bool;
+    // a normalized phone number has between 7 and 15 digits
+    static auto ValidPhone(std::string_view normalized) -> bool;
+
+    void write_json(std::ostream&) const;
+
+private:
+    struct ValueStats
+    {
+        size_t Present{};
+        size_t Valid{};
+        util::HyperLogLog<> Distinct{};
+    };
+
+    size_t m_Contacts{};
+    size_t m_Duplicates{};
+    std::array<size_t, Contact::Fields.size()> m_Filled{};
+    ValueStats m_Emails{};
+    ValueStats m_Phones{};
+    util::HyperLogLog<> m_Domains{};
+    util::HyperLogLog<> m_Names{};
+    util::SpaceSaving m_TopDomains{4 * TopDomains};
+
+    // normalized values are written here, reusing its capacity
+    std::string m_Key{};
+};
@@ -0,0 +1,259 @@
+#include "MappingProfile.h"
+#include "util/hash.h"
+
+#include <charconv>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+/******************************************************************************/
+/* MappingProfile *************************************************************/
+namespace
+{
+    // column names may hold line breaks, which a profile escapes to keep
+    // one name per line
+    auto escape_name(const std::string& name) -> std::string
+    {
+        std::string escaped;
+        for (const char c : name) {
+            if (c == '\\') escaped += "\\\\";
+            else if (c == '\n') escaped += "\\n";
+            else if (c == '\r') escaped += "\\r";
+            else escaped += c;
+        }
+        return escaped;
+    }
+
+    auto unescape_name(const std::string& escaped) -> std::string
+    {
+        std::string name;
+        for (size_t i = 0; i < escaped.size(); ++i) {
+            if (escaped[i] != '\\' || i + 1 == escaped.size()) {
+                name += escaped[i];
+                continue;
+            }
+            const char c = escaped[++i];
+            name += (c == 'n') ? '\n' : (c == 'r') ? '\r' : c;
+        }
+        return name;
+    }
+}
+
+MappingProfile::MappingProfile(const fileio::CSVRow& header, const ContactCSVInputMap& mapper)
+    : HeaderFingerprint{Fingerprint(header)}
+    , ComposeDisplayName{mapper.ComposeDisplayName}
+{
+    Header.reserve(header.size());
+    for (const auto& cell : header) {
+        Header.emplace_back(cell.str());
+    }
+    for (size_t j = 0; j < Columns.size(); ++j) {
+        Columns[j] = (mapper.*ContactCSVInputMap::Mappers[j]).Index;
+    }
+}
+
+auto MappingProfile::Fingerprint(const fileio::CSVRow& header) -> uint64_t
+{
+    uint64_t hash = util::fnv1a_64("");
+    for (const auto& cell : header) {
+        hash = util::fnv1a_64(cell.str(), hash);
+        hash = util::fnv1a_64("\x1f", hash);
+    }
+    return hash;
+}
+
+auto MappingProfile::matches(const fileio::CSVRow& header) const -> bool
+{
+    if (header.size() != Header.size()) return false;
+    for (size_t j = 0; j < header.size(); ++j) {
+        if (std::string_view{header[j].str()} != Header[j]) return false;
+    }
+    return true;
+}
+
+auto MappingProfile::mapper() const -> ContactCSVInputMap
+{
+    ContactCSVInputMap mapper;
+    for (size_t j = 0; j < Columns.size(); ++j) {
+        (mapper.*ContactCSVInputMap::Mappers[j]).Index = Columns[j];
+    }
+    mapper.ComposeDisplayName = ComposeDisplayName;
+    mapper.resolve();
+    return mapper;
+}
+
+auto MappingProfile::set_field(const std::string& field, const std::string& value) -> bool
+{
+    const ContactCSVInputMap names;
+    for (size_t j = 0; j < Columns.size(); ++j) {
+        const bool is_display_name = (ContactCSVInputMap::Mappers[j] == &ContactCSVInputMap::MapDisplayName);
+        if (std::string_view{(names.*ContactCSVInputMap::Mappers[j]).FieldName} != field) continue;
+
+        if (value == "none" || (value == "compose" && is_display_name)) {
+            Columns[j].reset();
+            if (is_display_name) ComposeDisplayName = (value == "compose");
+            return true;
+        }
+        for (size_t col = 0; col < Header.size(); ++col) {
+            if (Header[col] == value) {
+                Columns[j] = col;
+                return true;
+            }
+        }
+        size_t col = 0;
+        const char* end = value.data() + value.size();
+        const auto [last, error] = std::from_chars(value.data(), end, col);
+        if (!value.empty() && error == std::errc{} && last == end && col < Header.size()) {
+            Columns[j] = col;
+            return true;
+        }
+        return false;
+    }
+    return false;
+}
+
+void MappingProfile::write(std::ostream& ostr) const
+{
+    const ContactCSVInputMap names;
+    ostr << "# Contacts Translator mapping profile\n"
+        << "# Edit the 'field' lines (or use 'profile pin') to correct a mapping;\n"
+        << "# values are a column index, \"none\", or \"compose\" for the display name.\n"
+        << "fingerprint = " << std::hex << std::setw(16) << std::setfill('0')
+        << HeaderFingerprint << std::dec << std::setfill(' ') << "\n"
+        << "heuristics = " << Heuristics << "\n"
+        << "pinned = " << (Pinned ? "true" : "false") << "\n";
+    for (size_t col = 0; col < Header.size(); ++col) {
+        ostr << "column " << col << " = " << escape_name(Header[col]) << "\n";
+    }
+    for (size_t j = 0; j < Columns.size(); ++j) {
+        const auto& field = (names.*ContactCSVInputMap::Mappers[j]).FieldName;
+        ostr << "field " << field << " = ";
+        if (Columns[j]) {
+            ostr << *Columns[j];
+            if (*Columns[j] < Header.size()) ostr << "  # " << escape_name(Header[*Columns[j]]);
+        } else if (ContactCSVInputMap::Mappers[j] == &ContactCSVInputMap::MapDisplayName
+            && ComposeDisplayName)
+        {
+            ostr << "compose";
+        } else {
+            ostr << "none";
+        }
+        ostr << "\n";
+    }
+}
+
+auto MappingProfile::Read(std::istream& istr) -> std::optional<MappingProfile>
+{
+    MappingProfile profile;
+    std::vector<std::pair<std::string, std::string>> fields;
+
+    std::string line;
+    while (std::getline(istr, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        const auto split = line.find(" = ");
+        if (split == std::string::npos) return std::nullopt;
+        const std::string key = line.substr(0, split);
+        std::string value = line.substr(split + 3);
+
+        // a corrupt or mistyped profile is ignored, and the heuristics rerun
+        try {
+            if (key == "fingerprint") {
+                profile.HeaderFingerprint = std::stoull(value, nullptr, 16);
+            } else if (key == "heuristics") {
+                profile.Heuristics = std::stoi(value);
+            } else if (key == "pinned") {
+                profile.Pinned = (value == "true");
+            } else if (key.rfind("column ", 0) == 0) {
+                if (std::stoull(key.substr(7)) != profile.Header.size()) return std::nullopt;
+                profile.Header.push_back(unescape_name(value));
+            } else if (key.rfind("field ", 0) == 0) {
+                value = value.substr(0, value.find("  #"));
+                fields.emplace_back(key.substr(6), value);
+            } else {
+                return std::nullopt;
+            }
+        } catch (const std::exception&) {
+            return std::nullopt;
+        }
+    }
+    for (const auto& [field, value] : fields) {
+        if (!profile.set_field(field, value)) return std::nullopt;
+    }
+    return profile;
+}
+/******************************************************************************/
+
+/******************************************************************************/
+/* ProfileCache ***************************************************************/
+ProfileCache::ProfileCache(fs::path directory)
+    : m_Directory{std::move(directory)}
+{
+}
+
+auto ProfileCache::DefaultDirectory() -> fs::path
+{
+    if (const char* dir = std::getenv("CONTACTS_PROFILE_DIR")) return dir;
+    if (const char* cache = std::getenv("XDG_CACHE_HOME")) {
+        return fs::path{cache} / "contacts-translator" / "profiles";
+    }
+    if (const char* home = std::getenv("HOME")) {
+        return fs::path{home} / ".cache" / "contacts-translator" / "profiles";
+    }
+    return fs::temp_directory_path() / "contacts-translator" / "profiles";
+}
+
+auto ProfileCache::path(uint64_t fingerprint) const -> fs::path
+{
+    std::ostringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << fingerprint << ".profile";
+    return m_Directory / name.str();
+}
+
+auto ProfileCache::load(const fileio::CSVRow& header) const -> std::optional<MappingProfile>
+{
+    std::ifstream file{path(MappingProfile::Fingerprint(header))};
+    if (!file) return std::nullopt;
+    auto profile = MappingProfile::Read(file);
+    if (!profile || !profile->matches(header)) return std::nullopt;
+    return profile;
+}
+
+auto ProfileCache::store(const MappingProfile& profile) const -> bool
+{
+    std::error_code error;
+    fs::create_directories(m_Directory, error);
+    if (error) return false;
+
+    // write to a temporary file and rename it over the profile, so readers
+    // never see a partial profile
+    const auto target = path(profile.HeaderFingerprint);
+    auto temporary = target;
+    temporary += ".tmp." + std::to_string(::getpid()) + "."
+        + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+    {
+        std::ofstream file{temporary};
+        profile.write(file);
+        if (!file) return false;
+    }
+    fs::rename(temporary, target, error);
+    return !error;
+}
+
+auto ProfileCache::resolve(const fileio::CSVRow& header) const -> MappingProfile
+{
+    if (auto profile = load(header)) {
+        if (profile->Pinned || profile->Heuristics == MappingProfile::HeuristicsVersion) {
+            return *profile;
+        }
+    }
+    MappingProfile profile{header, ContactCSVInputMap{header}};
+    store(profile);
+    return profile;
+}
+/******************************************************************************/
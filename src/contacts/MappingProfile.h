@@ -0,0 +1,71 @@
+#pragma once
+
+#include "fileio/CSV.h"
+#include "contacts/Contact.h"
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <istream>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * The resolved column mapping for one header layout, identified by a
+ * fingerprint of its header row. Profiles are cached on disk so that later
+ * files with the same layout skip the header heuristics, and a profile can be
+ * pinned to override what the heuristics chose.
+ */
+class MappingProfile
+{
+public:
+    // bumped whenever the header heuristics change, to invalidate the
+    // profiles they cached (pinned profiles are always kept)
+    static constexpr int HeuristicsVersion = 2;
+
+    explicit MappingProfile() = default;
+    MappingProfile(const fileio::CSVRow& header, const ContactCSVInputMap& mapper);
+
+    static auto Fingerprint(const fileio::CSVRow& header) -> uint64_t;
+
+    auto matches(const fileio::CSVRow& header) const -> bool;
+    auto mapper() const -> ContactCSVInputMap;
+
+    // map a field (by its FieldName) to a column index, a header name,
+    // "none", or "compose" for the display name
+    auto set_field(const std::string& field, const std::string& value) -> bool;
+
+    void write(std::ostream&) const;
+    static auto Read(std::istream&) -> std::optional<MappingProfile>;
+
+    uint64_t HeaderFingerprint{};
+    int Heuristics{HeuristicsVersion};
+    bool Pinned{false};
+    std::vector<std::string> Header{};
+    // the source column of each field, in Contact::Fields order
+    std::array<std::optional<size_t>, 8> Columns{};
+    bool ComposeDisplayName{false};
+};
+
+/**
+ * A directory of mapping profiles, one file per header fingerprint.
+ */
+class ProfileCache
+{
+public:
+    explicit ProfileCache(std::filesystem::path directory = DefaultDirectory());
+
+    static auto DefaultDirectory() -> std::filesystem::path;
+
+    auto path(uint64_t fingerprint) const -> std::filesystem::path;
+    auto load(const fileio::CSVRow& header) const -> std::optional<MappingProfile>;
+    auto store(const MappingProfile&) const -> bool;
+
+    // load the profile for a header, or run the heuristics and cache the result
+    auto resolve(const fileio::CSVRow& header) const -> MappingProfile;
+
+private:
+    std::filesystem::path m_Directory;
+};
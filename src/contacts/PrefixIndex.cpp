@@ -0,0 +1,218 @@
+#include "PrefixIndex.h"
+
+#include <algorithm>
+#include <cstdint>
+
+/******************************************************************************/
+/* PrefixIndex ****************************************************************/
+namespace
+{
+    constexpr char Magic[4] = {'C', 'T', 'P', 'X'};
+    constexpr uint32_t Version = 1;
+
+    // key text in ASCII lower case, cut short at the longest key
+    void lower_key(std::string_view text, std::string& key)
+    {
+        text = text.substr(0, PrefixIndex::MaxKeyLength);
+        key.resize(text.size());
+        for (size_t i = 0; i < text.size(); ++i) {
+            const char c = text[i];
+            key[i] = (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+        }
+    }
+
+    // queries lower case their prefix and decode keys into these
+    thread_local std::string t_Prefix;
+    thread_local std::string t_Key;
+
+    template <typename _Tp>
+    void write_array(std::ostream& ostr, const std::vector<_Tp>& array)
+    {
+        ostr.write(reinterpret_cast<const char*>(array.data()), array.size() * sizeof(_Tp));
+    }
+
+    template <typename _Tp>
+    auto read_array(std::istream& istr, std::vector<_Tp>& array, size_t size) -> bool
+    {
+        array.resize(size);
+        return static_cast<bool>(istr.read(reinterpret_cast<char*>(array.data()), size * sizeof(_Tp)));
+    }
+}
+
+void PrefixIndex::Builder::add(const Contact& contact, uint32_t row)
+{
+    const auto trimmed = [](std::string_view str) {
+        const size_t begin = str.find_first_not_of(' ');
+        if (begin == std::string_view::npos) return std::string_view{};
+        return str.substr(begin, str.find_last_not_of(' ') + 1 - begin);
+    };
+
+    // the whole display name, so that "jane d" finds "Jane Doe"
+    add_key(trimmed(contact.DisplayName), row);
+
+    for (const auto field : { &Contact::FirstName, &Contact::LastName, &Contact::DisplayName }) {
+        const std::string_view name = contact.*field;
+        for (size_t begin = 0; begin < name.size(); ) {
+            const size_t end = std::min(name.find(' ', begin), name.size());
+            add_key(name.substr(begin, end - begin), row);
+            begin = end + 1;
+        }
+    }
+
+    for (const auto field : { &Contact::EmailAddress1, &Contact::EmailAddress2 }) {
+        const auto email = trimmed(contact.*field);
+        add_key(email.substr(0, email.find('@')), row);
+    }
+}
+
+void PrefixIndex::Builder::add_key(std::string_view key, uint32_t row)
+{
+    if (key.empty()) return;
+    m_Keys.emplace_back(std::string{}, row);
+    lower_key(key, m_Keys.back().first);
+}
+
+auto PrefixIndex::Builder::finish() -> PrefixIndex
+{
+    std::sort(m_Keys.begin(), m_Keys.end());
+    m_Keys.erase(std::unique(m_Keys.begin(), m_Keys.end()), m_Keys.end());
+
+    PrefixIndex index;
+    index.m_Offsets.reserve(m_Keys.size() + 1);
+    index.m_Lcp.reserve(m_Keys.size());
+    index.m_Rows.reserve(m_Keys.size());
+    index.m_Offsets.push_back(0);
+    std::string_view previous;
+    for (size_t i = 0; i < m_Keys.size(); ++i) {
+        const std::string_view key = m_Keys[i].first;
+        size_t lcp = 0;
+        if (i % BlockSize != 0) {
+            const size_t limit = std::min(key.size(), previous.size());
+            while (lcp < limit && key[lcp] == previous[lcp]) ++lcp;
+        }
+        index.m_Suffixes.append(key.substr(lcp));
+        index.m_Offsets.push_back(static_cast<uint32_t>(index.m_Suffixes.size()));
+        index.m_Lcp.push_back(static_cast<uint8_t>(lcp));
+        index.m_Rows.push_back(m_Keys[i].second);
+        previous = key;
+    }
+    m_Keys.clear();
+    return index;
+}
+
+auto PrefixIndex::Build(const AddressBook& address_book) -> PrefixIndex
+{
+    Builder builder;
+    for (size_t i = 0; i < address_book.size(); ++i) {
+        builder.add(address_book[i], static_cast<uint32_t>(i));
+    }
+    return builder.finish();
+}
+
+void PrefixIndex::decode(size_t i, std::string& key) const
+{
+    key.resize(m_Lcp[i]);
+    key.append(m_Suffixes, m_Offsets[i], m_Offsets[i + 1] - m_Offsets[i]);
+}
+
+void PrefixIndex::complete(std::string_view prefix, size_t k, std::vector<uint32_t>& rows) const
+{
+    if (k == 0 || m_Rows.empty()) return;
+    lower_key(prefix, t_Prefix);
+    const std::string_view query = t_Prefix;
+
+    // The first key of each block is stored whole; find the last block that
+    // starts before the query, as the first match may be inside it
+    const size_t nblocks = (m_Rows.size() + BlockSize - 1) / BlockSize;
+    const auto head = [&](size_t block) {
+        const size_t i = block * BlockSize;
+        return std::string_view{m_Suffixes}.substr(m_Offsets[i], m_Offsets[i + 1] - m_Offsets[i]);
+    };
+    size_t lo = 0;
+    size_t hi = nblocks;
+    while (lo < hi) {
+        const size_t mid = (lo + hi) / 2;
+        if (head(mid) < query) lo = mid + 1;
+        else hi = mid;
+    }
+
+    // Decode forwards to the first match, then take matches until k rows
+    const size_t first = rows.size();
+    t_Key.clear();
+    for (size_t i = (lo > 0 ? lo - 1 : 0) * BlockSize; i < m_Rows.size(); ++i) {
+        decode(i, t_Key);
+        const std::string_view key = t_Key;
+        if (key < query) continue;
+        if (key.substr(0, query.size()) != query) break;
+        if (std::find(rows.begin() + first, rows.end(), m_Rows[i]) != rows.end()) continue;
+        rows.push_back(m_Rows[i]);
+        if (rows.size() - first == k) break;
+    }
+}
+
+auto PrefixIndex::complete(std::string_view prefix, size_t k) const -> std::vector<uint32_t>
+{
+    std::vector<uint32_t> rows;
+    complete(prefix, k, rows);
+    return rows;
+}
+
+void PrefixIndex::write(std::ostream& ostr) const
+{
+    const uint64_t counts[2] = {m_Rows.size(), m_Suffixes.size()};
+    ostr.write(Magic, sizeof(Magic));
+    ostr.write(reinterpret_cast<const char*>(&Version), sizeof(Version));
+    ostr.write(reinterpret_cast<const char*>(counts), sizeof(counts));
+    ostr.write(m_Suffixes.data(), m_Suffixes.size());
+    write_array(ostr, m_Offsets);
+    write_array(ostr, m_Lcp);
+    write_array(ostr, m_Rows);
+}
+
+auto PrefixIndex::Read(std::istream& istr) -> std::optional<PrefixIndex>
+{
+    char magic[sizeof(Magic)];
+    uint32_t version = 0;
+    uint64_t counts[2] = {};
+    istr.read(magic, sizeof(magic));
+    istr.read(reinterpret_cast<char*>(&version), sizeof(version));
+    istr.read(reinterpret_cast<char*>(counts), sizeof(counts));
+    if (!istr || !std::equal(magic, magic + sizeof(magic), Magic) || version != Version) {
+        return std::nullopt;
+    }
+
+    // the counts must fit in what is left of the stream, so that a corrupt
+    // file fails here rather than in an allocation
+    const auto start = istr.tellg();
+    if (start >= 0 && istr.seekg(0, std::ios::end)) {
+        const auto remaining = static_cast<uint64_t>(istr.tellg() - start);
+        istr.seekg(start);
+        const uint64_t entry_bytes = 2 * sizeof(uint32_t) + sizeof(uint8_t);
+        if (counts[1] > remaining || counts[0] > (remaining - counts[1]) / entry_bytes) {
+            return std::nullopt;
+        }
+    }
+    if (!istr || counts[1] > UINT32_MAX || counts[0] > UINT32_MAX) return std::nullopt;
+
+    PrefixIndex index;
+    index.m_Suffixes.resize(counts[1]);
+    if (!istr.read(index.m_Suffixes.data(), counts[1])
+        || !read_array(istr, index.m_Offsets, counts[0] + 1)
+        || !read_array(istr, index.m_Lcp, counts[0])
+        || !read_array(istr, index.m_Rows, counts[0])
+        || index.m_Offsets.front() != 0 || index.m_Offsets.back() != counts[1])
+    {
+        return std::nullopt;
+    }
+
+    // every suffix must lie within the suffixes, and every key share no more
+    // with the key before it than that key has
+    size_t previous = 0;
+    for (size_t i = 0; i < counts[0]; ++i) {
+        if (index.m_Offsets[i + 1] < index.m_Offsets[i]) return std::nullopt;
+        if (index.m_Lcp[i] > (i % BlockSize == 0 ? 0 : previous)) return std::nullopt;
+        previous = index.m_Lcp[i] + (index.m_Offsets[i + 1] - index.m_Offsets[i]);
+    }
+    return index;
+}
+/******************************************************************************/
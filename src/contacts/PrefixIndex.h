@@ -0,0 +1,72 @@
+#pragma once
+
+#include "contacts/Contact.h"
+
+#include <cstdint>
+#include <istream>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/**
+ * A typeahead index over the names and email addresses of a table of
+ * contacts, answering "which rows have a key starting with this prefix".
+ * The keys of a row are its display name, the words of its first, last and
+ * display names, and the local parts of its email addresses, in ASCII lower
+ * case and cut short at MaxKeyLength bytes.
+ *
+ * The keys are held sorted and front coded: each key is stored as its
+ * longest common prefix (LCP) with the key before it and the suffix after
+ * that. Every BlockSize-th key is stored whole, so that a query binary
+ * searches the whole keys and then decodes at most one block sequentially.
+ */
+class PrefixIndex
+{
+public:
+    static constexpr size_t BlockSize = 16;
+    static constexpr size_t MaxKeyLength = 255;
+
+    /**
+     * Collects the keys of rows one at a time, then sorts them into an index.
+     */
+    class Builder
+    {
+    public:
+        void add(const Contact&, uint32_t row);
+        auto finish() -> PrefixIndex;
+
+    private:
+        void add_key(std::string_view key, uint32_t row);
+
+        std::vector<std::pair<std::string, uint32_t>> m_Keys{};
+    };
+
+    // an index of the rows of an address book, in its current order
+    static auto Build(const AddressBook&) -> PrefixIndex;
+
+    inline auto size() const { return m_Rows.size(); }
+
+    /**
+     * The first k distinct rows with a key starting with prefix, in key order,
+     * appended to rows. The prefix is compared in ASCII lower case.
+     */
+    void complete(std::string_view prefix, size_t k, std::vector<uint32_t>& rows) const;
+    auto complete(std::string_view prefix, size_t k) const -> std::vector<uint32_t>;
+
+    void write(std::ostream&) const;
+    static auto Read(std::istream&) -> std::optional<PrefixIndex>;
+
+private:
+    // the key of entry i, given the key of entry i - 1 in key
+    void decode(size_t i, std::string& key) const;
+
+    // per entry: the suffix of its key in m_Suffixes, its LCP with the key
+    // before it (0 at the start of each block), and its row
+    std::string m_Suffixes{};
+    std::vector<uint32_t> m_Offsets{};
+    std::vector<uint8_t> m_Lcp{};
+    std::vector<uint32_t> m_Rows{};
+};
@@ -0,0 +1,350 @@
+#include "Arrow.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+/******************************************************************************/
+/* FlatBuilder ****************************************************************/
+namespace
+{
+    /*
+     * Arrow's metadata is flatbuffers, which this builds by hand for the few
+     * tables the writer needs. As in the flatbuffers library, a buffer is
+     * built back to front, so that every object is written before the tables
+     * that refer to it, and an object is addressed by its distance from the
+     * end of the buffer. The bytes are kept reversed until the buffer is done.
+     */
+    class FlatBuilder
+    {
+    public:
+        using Offset = uint32_t;
+
+        inline auto size() const { return static_cast<Offset>(m_Reversed.size()); }
+
+        // pad so that the next size bytes pushed end on a multiple of alignment
+        void align(size_t alignment, size_t size = 0)
+        {
+            m_MinAlign = std::max(m_MinAlign, alignment);
+            m_Reversed.append((alignment - (m_Reversed.size() + size) % alignment) % alignment, '\0');
+        }
+
+        void push(const void* data, size_t size)
+        {
+            const auto* bytes = static_cast<const char*>(data);
+            for (size_t i = size; i != 0; --i) m_Reversed.push_back(bytes[i - 1]);
+        }
+
+        template <typename _Tp>
+        auto scalar(_Tp value) -> Offset
+        {
+            align(sizeof(_Tp));
+            push(&value, sizeof(_Tp));
+            return size();
+        }
+
+        // offsets are unsigned, from where they are stored forward to the object
+        auto offset_to(Offset target) -> Offset
+        {
+            align(sizeof(Offset));
+            return scalar<Offset>(size() + sizeof(Offset) - target);
+        }
+
+        auto string(std::string_view str) -> Offset
+        {
+            align(sizeof(Offset), str.size() + 1);
+            m_Reversed.push_back('\0');
+            push(str.data(), str.size());
+            return scalar<uint32_t>(static_cast<uint32_t>(str.size()));
+        }
+
+        auto offsets(const std::vector<Offset>& targets) -> Offset
+        {
+            for (size_t i = targets.size(); i != 0; --i) offset_to(targets[i - 1]);
+            return scalar<uint32_t>(static_cast<uint32_t>(targets.size()));
+        }
+
+        template <typename _Tp>
+        auto structs(const std::vector<_Tp>& values) -> Offset
+        {
+            align(std::max(alignof(_Tp), sizeof(uint32_t)), values.size() * sizeof(_Tp));
+            push(values.data(), values.size() * sizeof(_Tp));
+            return scalar<uint32_t>(static_cast<uint32_t>(values.size()));
+        }
+
+        void start_table()
+        {
+            m_TableStart = size();
+            m_Fields.clear();
+        }
+
+        template <typename _Tp>
+        void field(uint16_t id, _Tp value)
+        {
+            m_Fields.emplace_back(id, scalar(value));
+        }
+
+        void field_offset(uint16_t id, Offset target)
+        {
+            m_Fields.emplace_back(id, offset_to(target));
+        }
+
+        // a table starts with the signed distance back to its vtable, which
+        // is written just before it and locates each field within the table
+        auto end_table() -> Offset
+        {
+            const Offset table = scalar<int32_t>(0);
+            uint16_t count = 0;
+            for (const auto& [id, at] : m_Fields) count = std::max<uint16_t>(count, id + 1);
+            std::vector<uint16_t> vtable(count);
+            for (const auto& [id, at] : m_Fields) vtable[id] = static_cast<uint16_t>(table - at);
+            for (size_t i = count; i != 0; --i) scalar<uint16_t>(vtable[i - 1]);
+            scalar<uint16_t>(static_cast<uint16_t>(table - m_TableStart));
+            const Offset vtable_at = scalar<uint16_t>(static_cast<uint16_t>(2 * (count + 2)));
+
+            const int32_t distance = static_cast<int32_t>(vtable_at - table);
+            char bytes[sizeof(distance)];
+            std::memcpy(bytes, &distance, sizeof(distance));
+            for (size_t k = 0; k < sizeof(distance); ++k) m_Reversed[table - 1 - k] = bytes[k];
+            return table;
+        }
+
+        auto finish(Offset root) -> std::string
+        {
+            align(m_MinAlign, sizeof(Offset));
+            offset_to(root);
+            return std::string{m_Reversed.rbegin(), m_Reversed.rend()};
+        }
+
+    private:
+        std::string m_Reversed{};
+        size_t m_MinAlign{1};
+        Offset m_TableStart{};
+        std::vector<std::pair<uint16_t, Offset>> m_Fields{};
+    };
+}
+/******************************************************************************/
+
+/******************************************************************************/
+/* ArrowFileWriter ************************************************************/
+namespace
+{
+    // from Schema.fbs and Message.fbs of the Arrow format
+    constexpr int16_t MetadataV5 = 4;
+    constexpr int16_t Endianness = (std::endian::native == std::endian::little) ? 0 : 1;
+    constexpr uint8_t TypeUtf8 = 5;
+    constexpr uint8_t HeaderSchema = 1;
+    constexpr uint8_t HeaderRecordBatch = 3;
+
+    constexpr char Magic[8] = {'A', 'R', 'R', 'O', 'W', '1', '\0', '\0'};
+    constexpr uint32_t Continuation = 0xffffffff;
+    // buffers and messages are padded to this many bytes
+    constexpr size_t Alignment = 8;
+    // a batch is written early rather than let a column's offsets overflow
+    constexpr size_t MaxBatchBytes = size_t{1} << 30;
+
+    // the structs of RecordBatch and Footer, laid out as flatbuffers lays them
+    struct FieldNode
+    {
+        int64_t Length{};
+        int64_t NullCount{};
+    };
+    struct Buffer
+    {
+        int64_t Offset{};
+        int64_t Length{};
+    };
+    struct FooterBlock
+    {
+        int64_t Offset{};
+        int32_t MetadataLength{};
+        int32_t Padding{};
+        int64_t BodyLength{};
+    };
+    static_assert(sizeof(FieldNode) == 16 && sizeof(Buffer) == 16 && sizeof(FooterBlock) == 24);
+
+    auto padding(size_t size) -> size_t
+    {
+        return (Alignment - size % Alignment) % Alignment;
+    }
+
+    auto build_schema(FlatBuilder& builder, const std::vector<std::string>& names)
+        -> FlatBuilder::Offset
+    {
+        std::vector<FlatBuilder::Offset> fields;
+        for (const auto& name : names) {
+            const auto name_at = builder.string(name);
+            builder.start_table();
+            const auto utf8 = builder.end_table();
+            // readers expect the children of every field, even when empty
+            const auto children = builder.offsets({});
+            builder.start_table();
+            builder.field_offset(0, name_at);
+            builder.field_offset(3, utf8);
+            builder.field_offset(5, children);
+            builder.field<uint8_t>(1, 1);
+            builder.field<uint8_t>(2, TypeUtf8);
+            fields.push_back(builder.end_table());
+        }
+        const auto fields_at = builder.offsets(fields);
+        builder.start_table();
+        builder.field_offset(1, fields_at);
+        builder.field<int16_t>(0, Endianness);
+        return builder.end_table();
+    }
+
+    auto build_message(FlatBuilder& builder, uint8_t header_type, FlatBuilder::Offset header,
+        int64_t body_length) -> std::string
+    {
+        builder.start_table();
+        builder.field<int64_t>(3, body_length);
+        builder.field_offset(2, header);
+        builder.field<int16_t>(0, MetadataV5);
+        builder.field<uint8_t>(1, header_type);
+        return builder.finish(builder.end_table());
+    }
+}
+
+fileio::ArrowFileWriter::ArrowFileWriter(std::ostream& ostr, std::vector<std::string> column_names,
+    size_t batch_rows)
+    : m_Stream{ostr}
+    , m_Names{std::move(column_names)}
+    , m_BatchRows{std::max<size_t>(batch_rows, 1)}
+    , m_Columns(m_Names.size())
+{
+    write(Magic, sizeof(Magic));
+    FlatBuilder builder;
+    write_message(build_message(builder, HeaderSchema, build_schema(builder, m_Names), 0));
+}
+
+fileio::ArrowFileWriter::~ArrowFileWriter()
+{
+    close();
+}
+
+void fileio::ArrowFileWriter::append(size_t column, std::string_view cell)
+{
+    auto& data = m_Columns[column];
+    if (m_BatchRowCount % 8 == 0) data.Validity.push_back(0);
+    if (cell.empty()) {
+        data.NullCount += 1;
+    } else {
+        data.Validity.back() |= static_cast<uint8_t>(1u << (m_BatchRowCount % 8));
+        data.Data.append(cell);
+    }
+    data.Offsets.push_back(static_cast<int32_t>(data.Data.size()));
+}
+
+void fileio::ArrowFileWriter::end_row(size_t cells)
+{
+    for (size_t j = cells; j < m_Columns.size(); ++j) append(j, {});
+    m_BatchRowCount += 1;
+    m_RowsWritten += 1;
+
+    const bool full = std::any_of(m_Columns.begin(), m_Columns.end(),
+        [](const Column& column) { return column.Data.size() >= MaxBatchBytes; });
+    if (m_BatchRowCount == m_BatchRows || full) write_batch();
+}
+
+void fileio::ArrowFileWriter::write_batch()
+{
+    // each column's buffers follow one another in the body: its validity
+    // bitmap, left out when it has no nulls, its offsets and its bytes
+    std::vector<FieldNode> nodes;
+    std::vector<Buffer> buffers;
+    int64_t body_length = 0;
+    const auto add_buffer = [&](size_t size) {
+        buffers.push_back(Buffer{body_length, static_cast<int64_t>(size)});
+        body_length += static_cast<int64_t>(size + padding(size));
+    };
+    for (const auto& column : m_Columns) {
+        nodes.push_back(FieldNode{static_cast<int64_t>(m_BatchRowCount),
+            static_cast<int64_t>(column.NullCount)});
+        add_buffer(column.NullCount ? column.Validity.size() : 0);
+        add_buffer(column.Offsets.size() * sizeof(int32_t));
+        add_buffer(column.Data.size());
+    }
+
+    FlatBuilder builder;
+    const auto nodes_at = builder.structs(nodes);
+    const auto buffers_at = builder.structs(buffers);
+    builder.start_table();
+    builder.field<int64_t>(0, static_cast<int64_t>(m_BatchRowCount));
+    builder.field_offset(1, nodes_at);
+    builder.field_offset(2, buffers_at);
+    const auto record_batch = builder.end_table();
+
+    const int64_t offset = m_Position;
+    const int32_t metadata_length = write_message(
+        build_message(builder, HeaderRecordBatch, record_batch, body_length));
+    // the buffers are written straight from the columns, which keep their
+    // capacity for the next batch
+    const char zeros[Alignment] = {};
+    const auto write_buffer = [&](const void* data, size_t size) {
+        write(data, size);
+        write(zeros, padding(size));
+    };
+    for (auto& column : m_Columns) {
+        write_buffer(column.Validity.data(), column.NullCount ? column.Validity.size() : 0);
+        write_buffer(column.Offsets.data(), column.Offsets.size() * sizeof(int32_t));
+        write_buffer(column.Data.data(), column.Data.size());
+        column.Data.clear();
+        column.Offsets.assign(1, 0);
+        column.Validity.clear();
+        column.NullCount = 0;
+    }
+    m_Blocks.push_back(Block{offset, metadata_length, body_length});
+    m_BatchRowCount = 0;
+}
+
+auto fileio::ArrowFileWriter::write_message(const std::string& metadata) -> int32_t
+{
+    // the continuation marker and the length come first, and together with
+    // the metadata make a multiple of Alignment bytes; any body follows
+    const uint32_t length = static_cast<uint32_t>(metadata.size() + padding(metadata.size()));
+    write(&Continuation, sizeof(Continuation));
+    write(&length, sizeof(length));
+    write(metadata.data(), metadata.size());
+    const char zeros[Alignment] = {};
+    write(zeros, padding(metadata.size()));
+    return static_cast<int32_t>(sizeof(Continuation) + sizeof(length) + length);
+}
+
+void fileio::ArrowFileWriter::close()
+{
+    if (m_Closed) return;
+    m_Closed = true;
+    if (m_BatchRowCount != 0 || m_Blocks.empty()) write_batch();
+
+    // the end of the stream of messages, then the footer that locates them
+    const uint32_t end_of_stream[2] = {Continuation, 0};
+    write(end_of_stream, sizeof(end_of_stream));
+
+    std::vector<FooterBlock> blocks;
+    for (const auto& block : m_Blocks) {
+        blocks.push_back(FooterBlock{block.Offset, block.MetadataLength, 0, block.BodyLength});
+    }
+    FlatBuilder builder;
+    const auto schema = build_schema(builder, m_Names);
+    const auto dictionaries = builder.structs(std::vector<FooterBlock>{});
+    const auto record_batches = builder.structs(blocks);
+    builder.start_table();
+    builder.field_offset(1, schema);
+    builder.field_offset(2, dictionaries);
+    builder.field_offset(3, record_batches);
+    builder.field<int16_t>(0, MetadataV5);
+    const auto footer = builder.finish(builder.end_table());
+
+    const int32_t footer_length = static_cast<int32_t>(footer.size());
+    write(footer.data(), footer.size());
+    write(&footer_length, sizeof(footer_length));
+    write(Magic, 6);
+    m_Stream.flush();
+}
+
+void fileio::ArrowFileWriter::write(const void* data, size_t size)
+{
+    m_Stream.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+    m_Position += static_cast<int64_t>(size);
+}
+/******************************************************************************/
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fileio
+{
+
+/**
+ * Writes a table of nullable UTF-8 string columns as an Arrow IPC file
+ * (Feather v2), which dataframe libraries can memory map and use without
+ * parsing. Rows are buffered into record batches of batch_rows rows, each
+ * column as a validity bitmap, 32-bit offsets and the bytes of its strings.
+ * Empty cells, which CSV cannot tell apart from missing ones, are nulls.
+ * The file is only complete once the writer is closed or destroyed.
+ */
+class ArrowFileWriter
+{
+public:
+    static constexpr size_t DefaultBatchRows = 65536;
+
+    ArrowFileWriter(std::ostream&, std::vector<std::string> column_names,
+        size_t batch_rows = DefaultBatchRows);
+    ~ArrowFileWriter();
+
+    ArrowFileWriter(const ArrowFileWriter&) = delete;
+    ArrowFileWriter& operator=(const ArrowFileWriter&) = delete;
+
+    // cells past the last column are ignored, and missing cells are nulls
+    template <typename Range>
+    void write_row(const Range& cells);
+    // write the last record batch and the footer
+    void close();
+
+    inline auto rows_written() const { return m_RowsWritten; }
+    inline auto batches_written() const { return m_Blocks.size(); }
+
+protected:
+    struct Column
+    {
+        std::string Data{};
+        std::vector<int32_t> Offsets{0};
+        std::vector<uint8_t> Validity{};
+        size_t NullCount{};
+    };
+    // where a record batch message is in the file, for the footer
+    struct Block
+    {
+        int64_t Offset{};
+        int32_t MetadataLength{};
+        int64_t BodyLength{};
+    };
+
+    void append(size_t column, std::string_view cell);
+    void end_row(size_t cells);
+    void write_batch();
+    // write the metadata of an encapsulated message, returning its length
+    auto write_message(const std::string& metadata) -> int32_t;
+    void write(const void* data, size_t size);
+
+    std::ostream& m_Stream;
+    std::vector<std::string> m_Names;
+    size_t m_BatchRows;
+    std::vector<Column> m_Columns;
+    size_t m_BatchRowCount{};
+    size_t m_RowsWritten{};
+    int64_t m_Position{};
+    std::vector<Block> m_Blocks{};
+    bool m_Closed{false};
+};
+
+} // namespace fileio
+
+/******************************************************************************/
+
+template <typename Range>
+void fileio::ArrowFileWriter::write_row(const Range& cells)
+{
+    size_t j = 0;
+    for (const auto& cell : cells) {
+        if (j == m_Columns.size()) break;
+        append(j++, std::string_view{cell});
+    }
+    end_row(j);
+}
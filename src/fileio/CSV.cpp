@@ -1,25 +1,51 @@
 
 #include "CSV.h"
+#include "CSVDialect.h"
 #include "util/string.h"
 
 #include <iostream>
 #include <sstream>
 #include <algorithm>
+#include <ranges>
 
 /******************************************************************************/
 /* CSVCell ********************************************************************/
-fileio::CSVCell::CSVCell(const std::string& str, size_t row, size_t col)
-    : m_String{str}
+fileio::CSVCell::CSVCell(std::string_view str, size_t row, size_t col,
+    const allocator_type& alloc)
+    : m_String{str, alloc}
     , m_Row{row}
     , m_Col{col}
 {
 }
+
+fileio::CSVCell::CSVCell(std::pmr::string&& str, size_t row, size_t col,
+    const allocator_type& alloc)
+    : m_String{std::move(str), alloc}
+    , m_Row{row}
+    , m_Col{col}
+{
+}
+
+fileio::CSVCell::CSVCell(const CSVCell& other, const allocator_type& alloc)
+    : m_String{other.m_String, alloc}
+    , m_Row{other.m_Row}
+    , m_Col{other.m_Col}
+{
+}
+
+fileio::CSVCell::CSVCell(CSVCell&& other, const allocator_type& alloc)
+    : m_String{std::move(other.m_String), alloc}
+    , m_Row{other.m_Row}
+    , m_Col{other.m_Col}
+{
+}
 /******************************************************************************/
 
 /******************************************************************************/
 /* CSVRow *********************************************************************/
-fileio::CSVRow::CSVRow(const std::vector<CSVCell>& cells, size_t row)
-    : std::vector<CSVCell>{cells}
+fileio::CSVRow::CSVRow(const std::pmr::vector<CSVCell>& cells, size_t row,
+    const allocator_type& alloc)
+    : std::pmr::vector<CSVCell>{cells, alloc}
     , m_Row{row}
 {
     for (size_t j = 0; j < size(); ++j) {
@@ -28,6 +54,18 @@ fileio::CSVRow::CSVRow(const std::vector<CSVCell>& cells, size_t row)
     }
 }
 
+fileio::CSVRow::CSVRow(const CSVRow& other, const allocator_type& alloc)
+    : std::pmr::vector<CSVCell>{other, alloc}
+    , m_Row{other.m_Row}
+{
+}
+
+fileio::CSVRow::CSVRow(CSVRow&& other, const allocator_type& alloc)
+    : std::pmr::vector<CSVCell>{std::move(other), alloc}
+    , m_Row{other.m_Row}
+{
+}
+
 auto fileio::CSVRow::ncols() const -> size_t
 {
     return empty() ? 0 : size();
@@ -47,22 +85,23 @@ auto fileio::CSVRow::str() const -> std::string
 
 /******************************************************************************/
 /* CSVTable *******************************************************************/
-fileio::CSVTable::CSVTable(const std::vector<CSVRow>& rows)
-    : std::vector<CSVRow>{rows}
+fileio::CSVTable::CSVTable(const std::pmr::vector<CSVRow>& rows)
+    : std::pmr::vector<CSVRow>{rows}
 {
     for (size_t i = 0; i < size(); ++i) {
         at(i).m_Row = i;
     }
 }
 
-fileio::CSVTable::CSVTable(const bits::TableView<const std::string>& tableview)
+fileio::CSVTable::CSVTable(const bits::TableView<const std::pmr::string>& tableview)
 {
     reserve(tableview.nrows());
     for (size_t i = 0; i < tableview.nrows(); ++i) {
         CSVRow row{{}, i};
         row.reserve(tableview.ncols());
         for (size_t j = 0; j < tableview.ncols(); ++j) {
-            row.push_back(CSVCell{*tableview.table()[i][j], i, j});
+            const auto* item = tableview.at(i, j);
+            row.push_back(CSVCell{item ? std::string_view{*item} : std::string_view{}, i, j});
         }
         push_back(std::move(row));
     }
@@ -83,59 +122,195 @@ auto fileio::CSVTable::ncols() const -> size_t
 
 auto fileio::CSVTable::table_view() const -> bits::TableView<const CSVCell>
 {
-    std::vector<std::vector<const CSVCell*>> table;
-    table.resize(nrows());
-    for (size_t i = 0; i < nrows(); ++i) {
-        table[i].resize(ncols());
-        for (size_t j = 0; j < ncols(); ++j) {
-            table[i][j] = &(*this)[i][j];
-        }
-    }
+    // the header row defines the columns of the table
+    const size_t ncols = empty() ? 0 : front().size();
+    return bits::TableView<const CSVCell>{nrows(), ncols,
+        [this](size_t i, size_t j) -> const CSVCell* {
+            const auto& row = (*this)[i];
+            return (j < row.size()) ? &row[j] : nullptr;
+        }};
+}
 
-    return bits::TableView<const CSVCell>{table};
+void fileio::CSVTable::print(std::ostream& ostr, const bits::TablePreview& preview) const
+{
+    const auto to_str = [](const CSVCell& cell) -> std::string_view { return cell.str(); };
+    table_view().print(ostr, to_str, preview);
 }
 
 auto fileio::CSVTable::str() const -> std::string
 {
     if (empty()) return "";
 
-    const auto to_str = [](const CSVCell& cell) { return cell.str(); };
+    const auto to_str = [](const CSVCell& cell) -> std::string_view { return cell.str(); };
     return table_view().str(to_str);
-#include <sstream>
+}
+/******************************************************************************/
+
+/******************************************************************************/
+/* CSVProjection **************************************************************/
+fileio::CSVProjection::CSVProjection(const std::vector<size_t>& columns)
+    : m_All{false}
+{
+    for (const size_t col : columns) {
+        if (col >= m_Slots.size()) m_Slots.resize(col + 1, npos);
+        m_Slots[col] = 0;
+    }
+    for (auto& slot : m_Slots) {
+        if (slot != npos) slot = m_Size++;
+    }
+}
+
+auto fileio::CSVProjection::apply(const CSVRow& row) const -> CSVRow
+{
+    if (m_All) return row;
+    CSVRow projected{{}, row.row()};
+    for (const auto& cell : row) {
+        if (contains(cell.col())) projected.push_back(cell);
+    }
+    return projected;
 }
 /******************************************************************************/
 
 /******************************************************************************/
 /* CSVReader ******************************************************************/
-auto fileio::CSVReader::ReadCSVTable(std::istream& istr, char delim)
-    -> fileio::CSVTable
+namespace
+{
+    /**
+     * Whether the first line of the buffer ends in \r\n, or false if there
+     * is no complete line in it.
+     */
+    auto ends_in_crlf(std::string_view buffer) -> bool
+    {
+        const size_t end = buffer.find('\n');
+        return end != std::string_view::npos && end > 0 && buffer[end - 1] == '\r';
+    }
+}
+
+auto fileio::CSVReader::FindRecordEnd(std::string_view buffer, size_t pos, bool quoted,
+    char quote) -> size_t
+{
+    for (; pos < buffer.size(); ++pos) {
+        if (buffer[pos] == quote) quoted = !quoted;
+        else if (buffer[pos] == '\n' && !quoted) return pos;
+    }
+    return buffer.size();
+}
+
+auto fileio::CSVReader::ReadCSVTable(std::istream& istr, char delim,
+    const CSVProjection& projection) -> fileio::CSVTable
+{
+    CSVStreamReader reader{istr, delim};
+    reader.project(projection);
+    return reader.read(static_cast<size_t>(-1));
+}
+
+auto fileio::CSVReader::ReadCSVTable(const std::string& str, char delim,
+    const CSVProjection& projection) -> CSVTable
 {
-    std::cout << "Trying to read from CSV table..." << std::endl;
+    return CSVReader::ReadCSVTable(std::string_view{str}, CSVFormat{delim}, projection);
+}
+
+auto fileio::CSVReader::ReadCSVTable(std::string_view str, const CSVFormat& format,
+    const CSVProjection& projection) -> CSVTable
+{
+    CSVFormat dialect = format;
+    dialect.CRLF = dialect.CRLF || ends_in_crlf(str);
+    const auto scan = SelectCSVScanner(dialect);
+
+    // one row per line, unless quoted fields span lines
     CSVTable table;
+    table.reserve(std::count(str.begin(), str.end(), '\n') + 1);
+    for (size_t pos = 0; ; ) {
+        CSVRow row{{}, table.size()};
+        if (!scan(dialect, str, pos, true, projection, row)) break;
+        table.push_back(std::move(row));
+    }
+    return table;
+}
+/******************************************************************************/
+
+/******************************************************************************/
+/* CSVStreamReader ************************************************************/
+fileio::CSVStreamReader::CSVStreamReader(std::istream& istr, char delim)
+    : CSVStreamReader{istr, CSVFormat{delim}}
+{
+}
 
-    std::string line;
-    for (size_t numrow = 0; std::getline(istr, line); ++numrow)
+fileio::CSVStreamReader::CSVStreamReader(std::istream& istr, const CSVFormat& format)
+    : m_Stream{istr}
+    , m_Format{format}
+{
+}
+
+auto fileio::CSVStreamReader::fill() -> bool
+{
+    static constexpr size_t ChunkSize = 1 << 16;
+
+    m_Buffer.erase(0, m_Pos);
+    m_BufferOffset += m_Pos;
+    m_Pos = 0;
+    const size_t size = m_Buffer.size();
+    m_Buffer.resize(size + ChunkSize);
+    m_Stream.read(m_Buffer.data() + size, ChunkSize);
+    const auto count = static_cast<size_t>(m_Stream.gcount());
+    m_Buffer.resize(size + count);
+    return count > 0;
+}
+
+auto fileio::CSVStreamReader::read(size_t max_rows) -> CSVTable
+{
+    CSVTable table;
+    table.reserve(std::min<size_t>(max_rows, 1 << 16));
+
+    // the dialect is settled by the first line
+    if (m_Scan == nullptr) {
+        while (m_Buffer.find('\n', m_Pos) == std::string::npos && !m_AtEnd) {
+            m_AtEnd = !fill();
+        }
+        m_Format.CRLF = m_Format.CRLF || ends_in_crlf(std::string_view{m_Buffer}.substr(m_Pos));
+        m_Scan = SelectCSVScanner(m_Format);
+    }
+
+    while (table.size() < max_rows)
     {
-        std::cout << "  => Reading row " << numrow << std::endl;
-        CSVRow row{{}, numrow};
-
-        std::string str;
-        std::stringstream line_stream{line};
-        for (size_t numcol = 0; std::getline(line_stream, str, delim); ++numcol)
-        {
-            CSVCell cell{str, numrow, numcol};
-            row.push_back(std::move(cell));
+        CSVRow row{{}, m_RowsRead};
+        if (!m_Projection.all()) row.reserve(m_Projection.size());
+        if (!m_Scan(m_Format, m_Buffer, m_Pos, m_AtEnd, m_Projection, row)) {
+            if (m_AtEnd) break;
+            m_AtEnd = !fill();
+            continue;
         }
         table.push_back(std::move(row));
+        m_RowsRead += 1;
     }
-    std::cout << "Done!" << std::endl;
     return table;
 }
+/******************************************************************************/
+
+/******************************************************************************/
+/* CSVStreamWriter ************************************************************/
+fileio::CSVStreamWriter::CSVStreamWriter(std::ostream& ostr, char delim, size_t rows_written)
+    : m_Stream{ostr}
+    , m_Delim{delim}
+    , m_RowsWritten{rows_written}
+{
+}
 
-auto fileio::CSVReader::ReadCSVTable(const std::string& str, char delim) -> CSVTable
+void fileio::CSVStreamWriter::write_cell(std::string_view cell)
 {
-    std::istringstream istr(str);
-    return CSVReader::ReadCSVTable(istr, delim);
+    const auto special = [this](char c) {
+        return c == m_Delim || c == '"' || c == '\n' || c == '\r';
+    };
+    if (std::none_of(cell.begin(), cell.end(), special)) {
+        m_Stream.write(cell.data(), cell.size());
+        return;
+    }
+    m_Stream.put('"');
+    for (const char c : cell) {
+        if (c == '"') m_Stream.put('"');
+        m_Stream.put(c);
+    }
+    m_Stream.put('"');
 }
 /******************************************************************************/
 
@@ -143,24 +318,16 @@ auto fileio::CSVReader::ReadCSVTable(const std::string& str, char delim) -> CSVT
 /* CSVWriter ******************************************************************/
 void fileio::CSVWriter::WriteCSVTable(const fileio::CSVTable& table, std::ostream& ostr)
 {
-    std::string str;
-    WriteCSVTable(table, str);
-    ostr << str;
+    CSVStreamWriter writer{ostr};
+    for (const auto& row : table) {
+        writer.write_row(row | std::views::transform(&CSVCell::str));
+    }
 }
 
 void fileio::CSVWriter::WriteCSVTable(const fileio::CSVTable& table, std::string& str)
 {
     std::ostringstream ostr;
-    for (size_t i = 0; i < table.nrows()-1; ++i) {
-        for (size_t j = 0; j < table.ncols()-1; ++j) {
-            ostr << table[i][j].str() << ',';
-        }
-        ostr << table[i][table.ncols()-1].str() << std::endl;
-    }
-    for (size_t j = 0; j < table.ncols()-1; ++j) {
-        ostr << table[table.nrows()-1][j].str() << ',';
-    }
-    ostr << table[table.nrows()-1][table.ncols()-1].str();
-    str = ostr.str();
+    WriteCSVTable(table, ostr);
+    str = std::move(ostr).str();
 }
 /******************************************************************************/
@@ -4,8 +4,11 @@
 #include "bits/table_view.h"
 
 #include <istream>
+#include <ostream>
 #include <string>
+#include <string_view>
 #include <vector>
+#include <memory_resource>
 #include <initializer_list>
 
 namespace fileio
@@ -15,29 +18,54 @@ class CSVCell;
 class CSVRow;
 class CSVTable;
 
+/*
+ * Tables are built from std::pmr containers, allocated from the default
+ * memory resource at the time they are constructed. Installing an arena as the
+ * default resource (see util/memory.h) lets a whole table be released at once.
+ */
+
 class CSVCell
 {
     friend CSVRow;
 
 public:
-    CSVCell(const std::string&, size_t row, size_t col);
+    using allocator_type = std::pmr::polymorphic_allocator<char>;
+
+    CSVCell(std::string_view, size_t row, size_t col, const allocator_type& = {});
+    CSVCell(std::pmr::string&&, size_t row, size_t col, const allocator_type& = {});
+    CSVCell(const CSVCell&) = default;
+    CSVCell(CSVCell&&) = default;
+    CSVCell(const CSVCell&, const allocator_type&);
+    CSVCell(CSVCell&&, const allocator_type&);
+    CSVCell& operator=(const CSVCell&) = default;
+    CSVCell& operator=(CSVCell&&) = default;
 
     inline auto row() const { return m_Row; }
     inline auto col() const { return m_Col; }
-    inline auto str() const -> const std::string& { return m_String; }
+    inline auto str() const -> const std::pmr::string& { return m_String; }
+    // move the string out of the cell, leaving it empty
+    inline auto take() -> std::pmr::string { return std::move(m_String); }
 
 protected:
-    std::string m_String{};
+    std::pmr::string m_String{};
     size_t m_Row{};
     size_t m_Col{};
 };
 
-class CSVRow : public std::vector<CSVCell>
+class CSVRow : public std::pmr::vector<CSVCell>
 {
     friend CSVTable;
 
 public:
-    CSVRow(const std::vector<CSVCell>&, size_t row);
+    using allocator_type = std::pmr::polymorphic_allocator<CSVCell>;
+
+    CSVRow(const std::pmr::vector<CSVCell>&, size_t row, const allocator_type& = {});
+    CSVRow(const CSVRow&) = default;
+    CSVRow(CSVRow&&) = default;
+    CSVRow(const CSVRow&, const allocator_type&);
+    CSVRow(CSVRow&&, const allocator_type&);
+    CSVRow& operator=(const CSVRow&) = default;
+    CSVRow& operator=(CSVRow&&) = default;
 
     inline auto row() const { return m_Row; }
     auto ncols() const -> size_t;
@@ -48,25 +76,157 @@ protected:
     size_t m_Row{};
 };
 
-class CSVTable : public std::vector<CSVRow>
+class CSVTable : public std::pmr::vector<CSVRow>
 {
 public:
     explicit CSVTable() = default;
-    CSVTable(const std::vector<CSVRow>&);
-    CSVTable(const bits::TableView<const std::string>&);
+    CSVTable(const std::pmr::vector<CSVRow>&);
+    CSVTable(const bits::TableView<const std::pmr::string>&);
 
     auto nrows() const -> size_t;
     auto ncols() const -> size_t;
 
     auto table_view() const -> bits::TableView<const CSVCell>;
+    void print(std::ostream&, const bits::TablePreview& = {}) const;
     auto str() const -> std::string;
 };
 
+/**
+ * The columns of a table that a reader materializes. Cells of the other
+ * columns are skipped over while scanning and not stored at all: a projected
+ * row holds only the projected cells, in column order, so a column is read
+ * from its slot() in the row. By default every column is kept.
+ */
+class CSVProjection
+{
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    explicit CSVProjection() = default;
+    explicit CSVProjection(const std::vector<size_t>& columns);
+
+    inline auto all() const { return m_All; }
+    inline auto contains(size_t col) const -> bool
+    {
+        return m_All || (col < m_Slots.size() && m_Slots[col] != npos);
+    }
+    // where a column is in a projected row, or npos if it is not projected
+    inline auto slot(size_t col) const -> size_t
+    {
+        return m_All ? col : (col < m_Slots.size() ? m_Slots[col] : npos);
+    }
+    // one past the last projected column
+    inline auto end() const { return m_All ? npos : m_Slots.size(); }
+    // the number of cells in a whole projected row
+    inline auto size() const { return m_All ? npos : m_Size; }
+
+    // the projected cells of a row read whole, such as a header
+    auto apply(const CSVRow&) const -> CSVRow;
+
+private:
+    bool m_All{true};
+    std::vector<size_t> m_Slots{};
+    size_t m_Size{};
+};
+
+/**
+ * The dialect of a CSV table. Quoted fields may contain delimiters, line
+ * breaks and doubled quotes. Readers detect CRLF line endings from the first
+ * line of their input.
+ */
+struct CSVFormat
+{
+    char Delimiter{','};
+    // the character fields may be quoted with, or '\0' for none
+    char Quote{'"'};
+    // whether lines end in \r\n rather than \n
+    bool CRLF{false};
+    // whether spaces around unquoted fields are dropped
+    bool Trim{false};
+};
+
+/**
+ * Scans the record starting at buffer[pos] into row, advancing pos past it.
+ * Returns false, leaving pos as it was, if there is no complete record left
+ * in the buffer; unless at_end, more input may complete it. One function is
+ * instantiated per dialect (see fileio/CSVDialect.h).
+ */
+using CSVScanFunction = bool (*)(const CSVFormat&, std::string_view buffer, size_t& pos,
+    bool at_end, const CSVProjection&, CSVRow& row);
+
+/**
+ * Reads a CSV table a batch of rows at a time, so that a table never has to
+ * be held in memory all at once.
+ */
+class CSVStreamReader
+{
+public:
+    CSVStreamReader(std::istream&, char delim);
+    CSVStreamReader(std::istream&, const CSVFormat&);
+
+    // read up to max_rows more rows; an empty table means the end of input
+    auto read(size_t max_rows) -> CSVTable;
+    inline auto rows_read() const { return m_RowsRead; }
+    // bytes of the stream taken up by the rows read so far
+    inline auto bytes_read() const { return m_BufferOffset + m_Pos; }
+
+    // materialize only these columns of the rows read from now on
+    inline void project(CSVProjection projection) { m_Projection = std::move(projection); }
+
+protected:
+    // read more of the stream into the buffer, returning false at its end
+    auto fill() -> bool;
+
+    std::istream& m_Stream;
+    CSVFormat m_Format;
+    // chosen once the first line has been seen
+    CSVScanFunction m_Scan{nullptr};
+    std::string m_Buffer{};
+    // the stream offset of the start of the buffer
+    size_t m_BufferOffset{};
+    size_t m_Pos{};
+    bool m_AtEnd{false};
+    size_t m_RowsRead{};
+    CSVProjection m_Projection{};
+};
+
+/**
+ * Writes a CSV table a row at a time, in the same layout as WriteCSVTable.
+ * Fields that hold a delimiter, quote or line break are quoted.
+ */
+class CSVStreamWriter
+{
+public:
+    // rows_written counts rows already in the stream, when appending to it
+    explicit CSVStreamWriter(std::ostream&, char delim = ',', size_t rows_written = 0);
+
+    template <typename Range>
+    void write_row(const Range& cells);
+    inline auto rows_written() const { return m_RowsWritten; }
+
+protected:
+    void write_cell(std::string_view);
+
+    std::ostream& m_Stream;
+    char m_Delim;
+    size_t m_RowsWritten{};
+};
+
 namespace CSVReader
 {
-    auto ReadCSVTable(std::istream&, char delim)
+    /**
+     * The position of the line break that ends the record around buffer[pos],
+     * or buffer.size() if there is none. Line breaks inside quoted fields do
+     * not end a record; quoted says whether buffer[pos] is inside one.
+     */
+    auto FindRecordEnd(std::string_view buffer, size_t pos, bool quoted = false,
+        char quote = '"') -> size_t;
+
+    auto ReadCSVTable(std::istream&, char delim, const CSVProjection& = CSVProjection{})
         -> CSVTable;
-    auto ReadCSVTable(const std::string&, char delim)
+    auto ReadCSVTable(const std::string&, char delim, const CSVProjection& = CSVProjection{})
+        -> CSVTable;
+    auto ReadCSVTable(std::string_view, const CSVFormat&, const CSVProjection& = CSVProjection{})
         -> CSVTable;
 }
 
@@ -77,3 +237,18 @@ namespace CSVWriter
 }
 
 } // namespace fileio
+
+/******************************************************************************/
+
+template <typename Range>
+void fileio::CSVStreamWriter::write_row(const Range& cells)
+{
+    // rows are separated, rather than terminated, by newlines
+    if (m_RowsWritten++ > 0) m_Stream.put('\n');
+    bool first = true;
+    for (const auto& cell : cells) {
+        if (!first) m_Stream.put(m_Delim);
+        write_cell(std::string_view{cell});
+        first = false;
+    }
+}
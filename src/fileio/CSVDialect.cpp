@@ -0,0 +1,30 @@
+#include "CSVDialect.h"
+
+/******************************************************************************/
+/* CSVScanner *****************************************************************/
+template struct fileio::CSVScanner<fileio::CSVDialect<','>>;
+template struct fileio::CSVScanner<fileio::CSVDialect<',', '"', true>>;
+template struct fileio::CSVScanner<fileio::CSVDialect<';'>>;
+template struct fileio::CSVScanner<fileio::CSVDialect<';', '"', true>>;
+template struct fileio::CSVScanner<fileio::CSVDialect<'\t'>>;
+template struct fileio::CSVScanner<fileio::CSVDialect<'\t', '"', true>>;
+template struct fileio::CSVScanner<fileio::CSVRuntimeDialect>;
+
+auto fileio::SelectCSVScanner(const CSVFormat& format) -> CSVScanFunction
+{
+    if (format.Quote == '"' && !format.Trim) {
+        switch (format.Delimiter) {
+            case ',': return format.CRLF
+                ? &CSVScanner<CSVDialect<',', '"', true>>::scan
+                : &CSVScanner<CSVDialect<','>>::scan;
+            case ';': return format.CRLF
+                ? &CSVScanner<CSVDialect<';', '"', true>>::scan
+                : &CSVScanner<CSVDialect<';'>>::scan;
+            case '\t': return format.CRLF
+                ? &CSVScanner<CSVDialect<'\t', '"', true>>::scan
+                : &CSVScanner<CSVDialect<'\t'>>::scan;
+        }
+    }
+    return &CSVScanner<CSVRuntimeDialect>::scan;
+}
+/******************************************************************************/
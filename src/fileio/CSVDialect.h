@@ -0,0 +1,141 @@
+#pragma once
+
+#include "fileio/CSV.h"
+
+#include <string_view>
+#include <type_traits>
+
+namespace fileio
+{
+
+/**
+ * A CSV dialect fixed at compile time, so that the scanner's comparisons
+ * against it are comparisons against constants.
+ */
+template <char _Delim, char _Quote = '"', bool _CRLF = false, bool _Trim = false>
+struct CSVDialect
+{
+    static constexpr char Delimiter = _Delim;
+    static constexpr char Quote = _Quote;
+    static constexpr bool CRLF = _CRLF;
+    static constexpr bool Trim = _Trim;
+};
+
+/**
+ * The generic fallback, for dialects only known at runtime.
+ */
+struct CSVRuntimeDialect : CSVFormat
+{
+};
+
+/**
+ * Scans CSV records of one dialect; see CSVScanFunction.
+ */
+template <typename _Dialect>
+struct CSVScanner
+{
+    static auto scan(const CSVFormat&, std::string_view buffer, size_t& pos, bool at_end,
+        const CSVProjection&, CSVRow& row) -> bool;
+};
+
+/**
+ * The scanner for a format: an explicit instantiation for the common
+ * dialects, or else the generic fallback.
+ */
+auto SelectCSVScanner(const CSVFormat&) -> CSVScanFunction;
+
+// the common dialects, instantiated in CSVDialect.cpp
+extern template struct CSVScanner<CSVDialect<','>>;
+extern template struct CSVScanner<CSVDialect<',', '"', true>>;
+extern template struct CSVScanner<CSVDialect<';'>>;
+extern template struct CSVScanner<CSVDialect<';', '"', true>>;
+extern template struct CSVScanner<CSVDialect<'\t'>>;
+extern template struct CSVScanner<CSVDialect<'\t', '"', true>>;
+extern template struct CSVScanner<CSVRuntimeDialect>;
+
+} // namespace fileio
+
+/******************************************************************************/
+
+template <typename _Dialect>
+auto fileio::CSVScanner<_Dialect>::scan(const CSVFormat& format, std::string_view buffer,
+    size_t& pos, bool at_end, const CSVProjection& projection, CSVRow& row) -> bool
+{
+    // the fixed dialects ignore the runtime format
+    const _Dialect dialect = [&]() {
+        if constexpr (std::is_same_v<_Dialect, CSVRuntimeDialect>) return _Dialect{format};
+        else return _Dialect{};
+    }();
+    const char delim = dialect.Delimiter;
+    const char quote = dialect.Quote;
+
+    const size_t size = buffer.size();
+    const char* data = buffer.data();
+    if (pos >= size) return false;
+
+    const size_t numrow = row.row();
+    const size_t ncols = projection.end();
+    std::pmr::string quoted{row.get_allocator()};
+    size_t i = pos;
+
+    // an empty line is an empty row
+    if (data[i] == '\n' || (dialect.CRLF && data[i] == '\r' && i + 1 < size && data[i + 1] == '\n')) {
+        pos = i + (data[i] == '\n' ? 1 : 2);
+        return true;
+    }
+
+    for (size_t numcol = 0; ; ++numcol) {
+        if (dialect.Trim) while (i < size && data[i] == ' ') ++i;
+
+        // a field is a quoted part, if any, and the unquoted rest up to
+        // the next delimiter or line break
+        bool is_quoted = false;
+        if (quote != '\0' && i < size && data[i] == quote) {
+            is_quoted = true;
+            quoted.clear();
+            for (size_t j = i + 1; ; ) {
+                size_t k = j;
+                while (k < size && data[k] != quote) ++k;
+                if (k >= size) {
+                    if (!at_end) { row.clear(); return false; }
+                    quoted.append(data + j, k - j);
+                    i = k;
+                    break;
+                }
+                quoted.append(data + j, k - j);
+                if (k + 1 < size && data[k + 1] == quote) {
+                    quoted += quote;
+                    j = k + 2;
+                    continue;
+                }
+                if (k + 1 >= size && !at_end) { row.clear(); return false; }
+                i = k + 1;
+                break;
+            }
+        }
+
+        const size_t begin = i;
+        while (i < size && data[i] != delim && data[i] != '\n') ++i;
+        if (i >= size && !at_end) { row.clear(); return false; }
+
+        size_t end = i;
+        const bool end_of_line = (i >= size || data[i] == '\n');
+        if (dialect.CRLF && end_of_line && end > begin && data[end - 1] == '\r') --end;
+        if (dialect.Trim) while (end > begin && data[end - 1] == ' ') --end;
+
+        if (numcol < ncols && projection.contains(numcol)) {
+            if (is_quoted) {
+                quoted.append(data + begin, end - begin);
+                row.push_back(CSVCell{quoted, numrow, numcol});
+            } else {
+                row.push_back(CSVCell{std::string_view{data + begin, end - begin}, numrow, numcol});
+            }
+        }
+
+        if (end_of_line) {
+            pos = std::min(i + 1, size);
+            return true;
+        }
+        i += 1;
+    }
+}
@@ -1,29 +1,175 @@
-
 #include "fileio/CSV.h"
 #include "contacts/Contact.h"
+#include "contacts/ContactStats.h"
 #include "util/collection.h"
+#include "util/memory.h"
+#include "app/Options.h"
+#include "app/Translate.h"
+#include "app/Pipeline.h"
+#include "app/OutOfCore.h"
+#include "app/Checkpoint.h"
+#include "app/Shard.h"
+#include "app/Server.h"
+#include "app/Batch.h"
+#include "app/Profile.h"
+#include "app/Lookup.h"
 
 #include <cstring>
+#include <filesystem>
 #include <iostream>
 #include <fstream>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <thread>
 
-int main(int argc, char** argv)
+#include <unistd.h>
+
+namespace
 {
-    if (argc != 3) return -1;
+    void translate_file(const app::Options& options, ContactStats* contact_stats)
+    {
+        const auto profiles = app::MakeProfileCache(options);
+        app::MappingCache mappings{profiles.get()};
+        app::TranslateOptions translate_options;
+        translate_options.Mappings = &mappings;
+        if (options.ShowPreview.value_or(isatty(STDOUT_FILENO))) {
+            translate_options.PreviewStream = &std::cout;
+            translate_options.Preview = options.Preview;
+        }
+
+        translate_options.Filter = options.Filter ? &*options.Filter : nullptr;
+        translate_options.Order = options.Order;
+        translate_options.MaxMemory = options.MaxMemory;
+        translate_options.SpillDir = options.SpillDir;
+        translate_options.Stats = contact_stats;
+        translate_options.ArrowOutput = options.ArrowOutput;
+
+        // sorting and out-of-core partitions are the parts of a single
+        // translation that run in parallel, and shards are always sorted
+        std::unique_ptr<util::ThreadPool> pool;
+        if (options.Order || options.OutOfCore || options.ShardCount != 0) {
+            pool = std::make_unique<util::ThreadPool>(options.Threads
+                ? options.Threads : std::thread::hardware_concurrency());
+            translate_options.Pool = pool.get();
+        }
+
+        // a checkpointed run manages its own files, committing the output
+        // only once it is complete
+        if (options.CheckpointInterval != 0) {
+            app::CheckpointOptions checkpoint;
+            checkpoint.Interval = options.CheckpointInterval;
+            checkpoint.Resume = options.Resume;
+            checkpoint.BatchSize = options.BatchSize;
+            const auto stats = app::TranslateCheckpointed(options.Source, options.Destination,
+                checkpoint, translate_options);
+            if (options.ShowStats) {
+                std::cerr << "checkpointed: " << stats.RowsIn << " rows in, " << stats.RowsOut
+                    << " rows out, " << stats.Checkpoints << " checkpoints";
+                if (stats.ResumedAt) std::cerr << ", resumed at byte " << stats.ResumedAt;
+                std::cerr << (stats.Complete ? "" : ", incomplete") << std::endl;
+            }
+            return;
+        }
 
-    std::string contacts_src = argv[1];
-    std::string contacts_dst = argv[2];
+        // as is a shard, which is written whole or not at all
+        if (options.ShardCount != 0) {
+            app::ShardOptions shard;
+            shard.Index = options.ShardIndex;
+            shard.Count = options.ShardCount;
+            shard.BatchSize = options.BatchSize;
+            const auto stats = app::TranslateShard(options.Source, options.Destination,
+                shard, translate_options);
+            if (options.ShowStats) {
+                std::cerr << "shard " << shard.Index << "/" << shard.Count << ": " << stats.RowsIn
+                    << " rows in, " << stats.RowsOut << " rows out"
+                    << (stats.Complete ? "" : ", incomplete") << std::endl;
+            }
+            return;
+        }
 
-    auto file_in = std::ifstream{contacts_src};
-    auto table_in = fileio::CSVReader::ReadCSVTable(file_in, ',');
-    std::cout << table_in.str() << std::endl;
+        auto file_in = std::ifstream{options.Source};
+        auto file_out = std::ofstream{options.Destination,
+            options.ArrowOutput ? std::ios::out | std::ios::binary : std::ios::out};
+        if (options.OutOfCore) {
+            app::OutOfCoreOptions out_of_core;
+            out_of_core.Partitions = options.Partitions;
+            out_of_core.BatchSize = options.BatchSize;
+            std::error_code error;
+            out_of_core.InputBytes = static_cast<size_t>(std::filesystem::file_size(options.Source, error));
+            if (error) out_of_core.InputBytes = 0;
+            const auto stats = app::TranslateOutOfCore(file_in, file_out, *pool,
+                out_of_core, translate_options);
+            if (options.ShowStats) {
+                std::cerr << "out-of-core: " << stats.RowsIn << " rows in, " << stats.RowsOut
+                    << " rows out, " << stats.Partitions << " partitions, "
+                    << stats.SpilledBytes << " bytes spilled" << std::endl;
+            }
+        } else if (options.UsePipeline) {
+            app::PipelineOptions pipeline_options;
+            pipeline_options.BatchSize = options.BatchSize;
+            const auto stats = app::TranslatePipelined(file_in, file_out,
+                pipeline_options, translate_options);
+            if (options.ShowStats) app::PrintPipelineStats(std::cerr, stats);
+        } else {
+            app::Translate(file_in, file_out, translate_options);
+        }
+        file_out.close();
+    }
+
+    void translate(const app::Options& options)
+    {
+        std::optional<ContactStats> contact_stats;
+        if (!options.QualityReport.empty()) contact_stats.emplace();
+        translate_file(options, contact_stats ? &*contact_stats : nullptr);
+        if (contact_stats) {
+            std::ofstream report{options.QualityReport};
+            contact_stats->write_json(report);
+            if (!report) std::cerr << "Cannot write quality report " << options.QualityReport << std::endl;
+        }
+        if (options.WritePrefixIndex
+            && !app::WritePrefixIndex(options.Destination, options.Destination + ".prefix"))
+        {
+            std::cerr << "Cannot write prefix index " << options.Destination << ".prefix" << std::endl;
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const auto options = app::ParseOptions(argc, argv);
+    if (!options) {
+        app::PrintUsage(std::cerr, argv[0]);
+        return -1;
+    }
+    if (options->Verbose) ContactCSVInputMap::MatchLog = &std::cerr;
+    if (options->Mode == app::Command::Serve) return app::RunServer(*options);
+    if (options->Mode == app::Command::Client) return app::RunClient(*options);
+    if (options->Mode == app::Command::Batch) return app::RunBatch(*options);
+    if (options->Mode == app::Command::Profile) return app::RunProfile(*options);
+    if (options->Mode == app::Command::Lookup) return app::RunLookup(*options);
+    if (options->Mode == app::Command::Complete) return app::RunComplete(*options);
+    if (options->Mode == app::Command::Merge) return app::RunMerge(*options);
 
-    auto address_book = AddressBook{table_in};
-    address_book.format_all();
-    std::cout << address_book.str() << std::endl;
+    // Every table and contact of the run is allocated through these resources,
+    // and released in one go when the arena goes out of scope
+    util::CountingResource arena_upstream{std::pmr::new_delete_resource()};
+    std::pmr::monotonic_buffer_resource arena{&arena_upstream};
+    util::LockedResource locked_arena{&arena};
+    util::CountingResource counter{options->UseArena
+        ? static_cast<std::pmr::memory_resource*>(&locked_arena)
+        : std::pmr::new_delete_resource()};
+    {
+        util::ScopedDefaultResource scope{&counter};
+        translate(*options);
+    }
 
-    auto file_out = std::ofstream{contacts_dst};
-    auto table_out = fileio::CSVTable{address_book.table_view()};
-    fileio::CSVWriter::WriteCSVTable(table_out, file_out);
-    file_out.close();
+    if (options->ShowStats) {
+        std::cerr << "memory: ";
+        util::print_memory_stats(std::cerr, counter);
+        if (options->UseArena) {
+            std::cerr << ", arena reserved bytes: " << arena_upstream.total_bytes();
+        }
+        std::cerr << std::endl;
+    }
 }
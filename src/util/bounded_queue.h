@@ -0,0 +1,91 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+namespace util
+{
+
+    /**
+     * A blocking FIFO queue of bounded capacity between pipeline stages.
+     * Records how long producers waited for room (backpressure), how long
+     * consumers waited for items, and the deepest the queue got.
+     */
+    template <typename _Tp>
+    class BoundedQueue
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        explicit BoundedQueue(size_t capacity)
+            : m_Capacity{std::max<size_t>(capacity, 1)}
+        {}
+
+        // returns false if the queue was closed before the item fit
+        auto push(_Tp item) -> bool
+        {
+            std::unique_lock lock{m_Mutex};
+            if (m_Items.size() >= m_Capacity && !m_Closed) {
+                const auto start = Clock::now();
+                m_NotFull.wait(lock, [this]() { return m_Items.size() < m_Capacity || m_Closed; });
+                m_PushWait += Clock::now() - start;
+            }
+            if (m_Closed) return false;
+            m_Items.push_back(std::move(item));
+            m_MaxDepth = std::max(m_MaxDepth, m_Items.size());
+            lock.unlock();
+            m_NotEmpty.notify_one();
+            return true;
+        }
+
+        // returns nullopt once the queue is closed and drained
+        auto pop() -> std::optional<_Tp>
+        {
+            std::unique_lock lock{m_Mutex};
+            if (m_Items.empty() && !m_Closed) {
+                const auto start = Clock::now();
+                m_NotEmpty.wait(lock, [this]() { return !m_Items.empty() || m_Closed; });
+                m_PopWait += Clock::now() - start;
+            }
+            if (m_Items.empty()) return std::nullopt;
+            _Tp item = std::move(m_Items.front());
+            m_Items.pop_front();
+            lock.unlock();
+            m_NotFull.notify_one();
+            return item;
+        }
+
+        void close()
+        {
+            {
+                std::lock_guard lock{m_Mutex};
+                m_Closed = true;
+            }
+            m_NotFull.notify_all();
+            m_NotEmpty.notify_all();
+        }
+
+        inline auto capacity() const { return m_Capacity; }
+        auto max_depth() const { std::lock_guard lock{m_Mutex}; return m_MaxDepth; }
+        auto push_wait() const { std::lock_guard lock{m_Mutex}; return m_PushWait; }
+        auto pop_wait() const { std::lock_guard lock{m_Mutex}; return m_PopWait; }
+
+    private:
+        const size_t m_Capacity;
+        std::deque<_Tp> m_Items{};
+        bool m_Closed{false};
+
+        mutable std::mutex m_Mutex{};
+        std::condition_variable m_NotFull{};
+        std::condition_variable m_NotEmpty{};
+
+        size_t m_MaxDepth{};
+        Clock::duration m_PushWait{};
+        Clock::duration m_PopWait{};
+    };
+
+}
@@ -2,6 +2,8 @@
 #pragma once
 
 #include <functional>
+#include <cstdint>
+#include <string_view>
 
 namespace util
 {
@@ -12,7 +14,7 @@ namespace util
     }
 
     template <typename _Tp, typename... _Targs>
-    inline size_t hash_combine(size_t& seed, const _Tp& v, _Targs... rest)
+    inline size_t hash_combine(size_t& seed, const _Tp& v, const _Targs&... rest)
     {
         std::hash<_Tp> hasher;
         seed ^= hasher(v) + 0x9e3779b9 + (seed<<6) + (seed>>2);
@@ -20,9 +22,22 @@ namespace util
     }
 
     template <typename... _Targs>
-    inline size_t hash_combine(size_t seed, _Targs... rest)
+    inline size_t hash_combine(size_t seed, const _Targs&... rest)
     {
         return hash_combine(seed, rest...);
     }
 
+    /**
+     * 64-bit FNV-1a, stable across platforms and library versions, for
+     * hashes that are persisted.
+     */
+    constexpr uint64_t fnv1a_64(std::string_view str, uint64_t hash = 0xcbf29ce484222325ull)
+    {
+        for (char c : str) {
+            hash ^= static_cast<uint8_t>(c);
+            hash *= 0x100000001b3ull;
+        }
+        return hash;
+    }
+
 }
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory_resource>
+#include <mutex>
+#include <ostream>
+
+namespace util
+{
+
+    /**
+     * A memory resource that forwards to an upstream resource, counting the
+     * allocations made through it and the peak number of bytes outstanding.
+     * Byte-aligned allocations are also counted on their own; for pmr
+     * strings, these are the buffers of strings too long for their inline
+     * storage, so they count how much string data is copied.
+     */
+    class CountingResource : public std::pmr::memory_resource
+    {
+    public:
+        explicit CountingResource(std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+            : m_Upstream{upstream}
+        {}
+
+        inline auto allocations() const { return m_Allocations.load(); }
+        inline auto deallocations() const { return m_Deallocations.load(); }
+        inline auto bytes_in_use() const { return m_BytesInUse.load(); }
+        inline auto peak_bytes() const { return m_PeakBytes.load(); }
+        inline auto total_bytes() const { return m_TotalBytes.load(); }
+        inline auto byte_aligned_bytes() const { return m_ByteAlignedBytes.load(); }
+
+    protected:
+        void* do_allocate(size_t bytes, size_t alignment) override
+        {
+            void* ptr = m_Upstream->allocate(bytes, alignment);
+            m_Allocations += 1;
+            m_TotalBytes += bytes;
+            if (alignment == 1) m_ByteAlignedBytes += bytes;
+            const size_t in_use = (m_BytesInUse += bytes);
+            size_t peak = m_PeakBytes.load();
+            while (in_use > peak && !m_PeakBytes.compare_exchange_weak(peak, in_use)) {}
+            return ptr;
+        }
+
+        void do_deallocate(void* ptr, size_t bytes, size_t alignment) override
+        {
+            m_Upstream->deallocate(ptr, bytes, alignment);
+            m_Deallocations += 1;
+            m_BytesInUse -= bytes;
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+        {
+            return this == &other;
+        }
+
+    private:
+        std::pmr::memory_resource* m_Upstream;
+        std::atomic<size_t> m_Allocations{};
+        std::atomic<size_t> m_Deallocations{};
+        std::atomic<size_t> m_BytesInUse{};
+        std::atomic<size_t> m_PeakBytes{};
+        std::atomic<size_t> m_TotalBytes{};
+        std::atomic<size_t> m_ByteAlignedBytes{};
+    };
+
+    /**
+     * A memory resource that serialises access to an upstream resource which
+     * is not itself thread-safe, such as a monotonic_buffer_resource.
+     */
+    class LockedResource : public std::pmr::memory_resource
+    {
+    public:
+        explicit LockedResource(std::pmr::memory_resource* upstream)
+            : m_Upstream{upstream}
+        {}
+
+    protected:
+        void* do_allocate(size_t bytes, size_t alignment) override
+        {
+            std::lock_guard lock{m_Mutex};
+            return m_Upstream->allocate(bytes, alignment);
+        }
+
+        void do_deallocate(void* ptr, size_t bytes, size_t alignment) override
+        {
+            std::lock_guard lock{m_Mutex};
+            m_Upstream->deallocate(ptr, bytes, alignment);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+        {
+            return this == &other;
+        }
+
+    private:
+        std::pmr::memory_resource* m_Upstream;
+        std::mutex m_Mutex{};
+    };
+
+    /**
+     * Installs a memory resource as the default for as long as it is in
+     * scope. Containers constructed in that scope keep using the resource,
+     * so they must be destroyed before it is.
+     */
+    class ScopedDefaultResource
+    {
+    public:
+        explicit ScopedDefaultResource(std::pmr::memory_resource* resource)
+            : m_Previous{std::pmr::set_default_resource(resource)}
+        {}
+        ~ScopedDefaultResource()
+        {
+            std::pmr::set_default_resource(m_Previous);
+        }
+
+        ScopedDefaultResource(const ScopedDefaultResource&) = delete;
+        ScopedDefaultResource& operator=(const ScopedDefaultResource&) = delete;
+
+    private:
+        std::pmr::memory_resource* m_Previous;
+    };
+
+    inline void print_memory_stats(std::ostream& ostr, const CountingResource& counter)
+    {
+        ostr << "allocations: " << counter.allocations()
+            << ", deallocations: " << counter.deallocations()
+            << ", allocated bytes: " << counter.total_bytes()
+            << ", peak bytes: " << counter.peak_bytes();
+    }
+
+}
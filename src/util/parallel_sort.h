@@ -0,0 +1,34 @@
+#pragma once
+
+#include "util/thread_pool.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace util
+{
+
+    /**
+     * A stable merge sort that sorts the two halves of each range as tasks on
+     * the pool before merging them. Ranges of up to grain elements are sorted
+     * on the calling thread.
+     */
+    template <typename _Iter, typename _Compare>
+    void parallel_sort(_Iter first, _Iter last, _Compare comp, ThreadPool& pool,
+        size_t grain = 1 << 14)
+    {
+        const auto size = static_cast<size_t>(std::distance(first, last));
+        if (size <= std::max<size_t>(grain, 2) || pool.size() < 2) {
+            std::stable_sort(first, last, comp);
+            return;
+        }
+
+        const _Iter middle = std::next(first, size / 2);
+        TaskGroup group;
+        pool.submit(group, [=, &pool]() { parallel_sort(first, middle, comp, pool, grain); });
+        parallel_sort(middle, last, comp, pool, grain);
+        pool.wait(group);
+        std::inplace_merge(first, middle, last, comp);
+    }
+
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+namespace util
+{
+
+    /**
+     * The 64-bit finalizer of MurmurHash3, which spreads every bit of a weaker
+     * hash, such as FNV-1a, over the whole result.
+     */
+    constexpr auto mix64(uint64_t hash)
+        -> uint64_t
+    {
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdull;
+        hash ^= hash >> 33;
+        hash *= 0xc4ceb9fe1a85ec53ull;
+        hash ^= hash >> 33;
+        return hash;
+    }
+
+    /**
+     * Estimates the number of distinct items added, from their hashes, in
+     * 2^_Precision one-byte registers. The standard error is 1.04 / sqrt(2^_Precision),
+     * about 1.6% at the default precision, in 4 KiB. Hashes must be well
+     * mixed, as from mix64.
+     */
+    template <size_t _Precision = 12>
+    class HyperLogLog
+    {
+    public:
+        static constexpr size_t Registers = size_t{1} << _Precision;
+
+        void add(uint64_t hash)
+        {
+            const size_t index = hash >> (64 - _Precision);
+            const uint64_t rest = hash << _Precision;
+            const auto rank = static_cast<uint8_t>(rest == 0
+                ? 64 - _Precision + 1 : std::countl_zero(rest) + 1);
+            m_Registers[index] = std::max(m_Registers[index], rank);
+        }
+
+        auto estimate() const -> double
+        {
+            constexpr double m = Registers;
+            double sum = 0;
+            size_t zeros = 0;
+            for (const uint8_t rank : m_Registers) {
+                sum += std::ldexp(1.0, -rank);
+                if (rank == 0) zeros += 1;
+            }
+            const double estimate = (0.7213 / (1 + 1.079 / m)) * m * m / sum;
+            // few items leave registers empty, and counting them is closer
+            if (estimate <= 2.5 * m && zeros != 0) return m * std::log(m / zeros);
+            return estimate;
+        }
+
+        inline auto bytes() const { return sizeof(m_Registers); }
+
+    private:
+        std::array<uint8_t, Registers> m_Registers{};
+    };
+
+    /**
+     * The most frequent keys of a stream, by the space-saving algorithm of
+     * Metwally et al. At most capacity keys are counted; a new key takes over
+     * the counter of the least counted key, inheriting its count as the
+     * error. Any key counted more than total / capacity times is kept, and
+     * each count overestimates the key's true count by at most its error.
+     */
+    class SpaceSaving
+    {
+    public:
+        struct Counter
+        {
+            std::string Key{};
+            size_t Count{};
+            size_t Error{};
+        };
+
+        explicit SpaceSaving(size_t capacity = 64)
+            : m_Capacity{std::max<size_t>(capacity, 1)}
+        {
+            m_Counters.reserve(m_Capacity);
+        }
+
+        void add(std::string_view key, size_t count = 1)
+        {
+            if (const auto itr = m_Index.find(key); itr != m_Index.end()) {
+                m_Counters[itr->second].Count += count;
+                return;
+            }
+            if (m_Counters.size() < m_Capacity) {
+                m_Index.emplace(std::string{key}, m_Counters.size());
+                m_Counters.push_back(Counter{std::string{key}, count, 0});
+                return;
+            }
+            const auto least = std::min_element(m_Counters.begin(), m_Counters.end(),
+                [](const Counter& a, const Counter& b) { return a.Count < b.Count; });
+            const size_t k = least - m_Counters.begin();
+            m_Index.erase(least->Key);
+            least->Key.assign(key);
+            least->Error = least->Count;
+            least->Count += count;
+            m_Index.emplace(least->Key, k);
+        }
+
+        // the k most counted keys, most counted first
+        auto top(size_t k) const -> std::vector<Counter>
+        {
+            std::vector<Counter> counters = m_Counters;
+            std::sort(counters.begin(), counters.end(), [](const Counter& a, const Counter& b) {
+                return std::tie(b.Count, a.Key) < std::tie(a.Count, b.Key);
+            });
+            counters.resize(std::min(k, counters.size()));
+            return counters;
+        }
+
+        inline auto capacity() const { return m_Capacity; }
+        auto bytes() const -> size_t
+        {
+            size_t bytes = m_Counters.capacity() * sizeof(Counter);
+            for (const auto& counter : m_Counters) bytes += 2 * counter.Key.capacity();
+            return bytes + m_Index.bucket_count() * sizeof(void*)
+                + m_Index.size() * (sizeof(std::string) + 2 * sizeof(size_t));
+        }
+
+    private:
+        // hashes std::string keys and std::string_view lookups alike
+        struct KeyHash
+        {
+            using is_transparent = void;
+            inline auto operator()(std::string_view key) const noexcept -> size_t
+            {
+                return std::hash<std::string_view>{}(key);
+            }
+        };
+
+        size_t m_Capacity;
+        std::vector<Counter> m_Counters{};
+        std::unordered_map<std::string, size_t, KeyHash, std::equal_to<>> m_Index{};
+    };
+
+}
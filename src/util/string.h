@@ -1,185 +1,339 @@
-
 #pragma once
 
-#include "util/collection.h"
-
-#include <cstring>
-#include <string>
-#include <sstream>
 #include <algorithm>
+#include <string>
+#include <string_view>
 
 namespace util
 {
 
-    template <typename _Tp>
-    bool is_number(const std::basic_string<_Tp>& str)
+    /*
+     * The formatters below read a string_view and write their result to a
+     * caller's buffer, returning its length, so that formatting a field never
+     * allocates. Each says how much room its output needs. Those that may
+     * write over their own input also have an _inplace form for strings, and
+     * each has a form that appends to a reusable string instead.
+     *
+     * Characters are classified as in the "C" locale, bytes of UTF-8
+     * sequences being neither spaces nor letters.
+     */
+
+    constexpr auto is_space(char c)
+        -> bool
     {
-        return std::find_if_not(str.begin(), str.end(), isdigit) == str.end();
+        return c == ' ' || (c >= '\t' && c <= '\r');
     }
 
-    template <typename _Tp>
-    auto pad_string_inplace(std::basic_string<_Tp>& str, size_t size, _Tp pad = ' ')
-        -> std::basic_string<_Tp>&
+    constexpr auto is_digit(char c)
+        -> bool
     {
-        if (str.size() > size) return str;
-        size_t pad_size = size - str.size();
-        return str.append(pad_size, pad);
+        return c >= '0' && c <= '9';
     }
 
-    template <typename _Tp>
-    auto pad_string(const std::basic_string<_Tp>& str, size_t size, _Tp pad = ' ')
-        -> std::basic_string<_Tp>
+    constexpr auto to_upper(char c)
+        -> char
     {
-        if (str.size() > size) return str;
-        size_t pad_size = size - str.size();
-        return str + std::basic_string<_Tp>(pad_size, pad);
+        return (c >= 'a' && c <= 'z') ? static_cast<char>(c - 'a' + 'A') : c;
     }
 
-    template <typename _Tp>
-    auto pad_string(const _Tp* str, size_t size, _Tp pad = ' ')
-        -> std::basic_string<_Tp>
+    constexpr auto to_lower(char c)
+        -> char
     {
-        auto result = std::basic_string<_Tp>(str);
-        if (strlen(str) > size) result;
-        size_t pad_size = size - strlen(str);
-        return result += std::basic_string<_Tp>(pad_size, pad);
+        return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
     }
 
-    template <typename _Tp>
-    auto repeat_string(const std::basic_string<_Tp>& str, size_t n)
-        -> std::basic_string<_Tp>
+    constexpr auto is_number(std::string_view str)
+        -> bool
     {
-        std::basic_string<_Tp> result;
-        result.reserve(str.size() * n);
-        for (size_t i = 0; i < n; ++i) result.append(str);
-        return result;
+        return std::find_if_not(str.begin(), str.end(), is_digit) == str.end();
     }
 
-    template <typename _Tp>
-    auto repeat_string(const _Tp* str, size_t n)
-        -> std::basic_string<_Tp>
+    /**
+     * The string without its leading and trailing ' ' characters.
+     */
+    constexpr auto trim_string(std::string_view str)
+        -> std::string_view
     {
-        std::basic_string<_Tp> result;
-        result.reserve(strlen(str) * n + 1);
-        for (size_t i = 0; i < n; ++i) result.append(str);
-        return result;
+        const auto first = str.find_first_not_of(' ');
+        if (first == std::string_view::npos) return {};
+        return str.substr(first, str.find_last_not_of(' ') + 1 - first);
     }
 
-    template <typename _Tp>
-    auto trim_string_inplace(std::basic_string<_Tp>& str)
-        -> std::basic_string<_Tp>&
+    /**
+     * Append the output of format, which writes at most size characters to
+     * the pointer it is given and returns how many it wrote.
+     */
+    template <typename _Traits, typename _Alloc, typename _Format>
+    auto append_formatted(std::basic_string<char, _Traits, _Alloc>& buffer, size_t size,
+        _Format&& format)
+        -> size_t
     {
-        str.erase(str.begin(), std::find_if(str.begin(), str.end(),
-            std::bind1st(std::not_equal_to<_Tp>(), ' ') ));
-        str.erase(std::find_if(str.rbegin(), str.rend(),
-            std::bind1st(std::not_equal_to<_Tp>(), ' ')).base(), str.end());
-        return str;
+        const size_t offset = buffer.size();
+        buffer.resize(offset + size);
+        const size_t length = format(buffer.data() + offset);
+        buffer.resize(offset + length);
+        return length;
+    }
+
+    /**
+     * The string padded on the right to size characters; needs room for the
+     * larger of size and the string.
+     */
+    constexpr auto pad_string(std::string_view str, size_t size, char* out, char pad = ' ')
+        -> size_t
+    {
+        std::copy(str.begin(), str.end(), out);
+        if (str.size() >= size) return str.size();
+        std::fill(out + str.size(), out + size, pad);
+        return size;
     }
 
-    template <typename _Tp>
-    auto trim_string(const std::basic_string<_Tp>& str)
-        -> std::basic_string<_Tp>
+    template <typename _Traits, typename _Alloc>
+    auto pad_string(std::string_view str, size_t size,
+        std::basic_string<char, _Traits, _Alloc>& buffer, char pad = ' ')
+        -> size_t
     {
-        const auto first = std::find_if(str.begin(), str.end(),
-            std::bind1st(std::not_equal_to<_Tp>(), ' ') );
-        const auto last = std::find_if(str.rbegin(), str.rend(),
-            std::bind1st(std::not_equal_to<_Tp>(), ' ')).base();
-        return std::basic_string<_Tp>(first, last);
+        return append_formatted(buffer, std::max(str.size(), size),
+            [&](char* out) { return pad_string(str, size, out, pad); });
     }
 
-    template <typename _Tp>
-    auto format_as_proper_noun_inplace(std::basic_string<_Tp>& str)
-        -> std::basic_string<_Tp>&
+    /**
+     * The string n times over; needs room for n times the string.
+     */
+    constexpr auto repeat_string(std::string_view str, size_t n, char* out)
+        -> size_t
     {
-        if (str.empty()) return str;
-        str[0] = toupper(str[0]);
-        for (size_t i = 1; i < str.size(); ++i) {
-            str[i] = isspace(str[i-1]) ? toupper(str[i]) : tolower(str[i]);
+        for (size_t i = 0; i < n; ++i) {
+            std::copy(str.begin(), str.end(), out + i * str.size());
         }
+        return str.size() * n;
+    }
+
+    template <typename _Traits, typename _Alloc>
+    auto repeat_string(std::string_view str, size_t n,
+        std::basic_string<char, _Traits, _Alloc>& buffer)
+        -> size_t
+    {
+        return append_formatted(buffer, str.size() * n,
+            [&](char* out) { return repeat_string(str, n, out); });
+    }
+
+    /**
+     * The string without any whitespace; needs room for the string, and may
+     * write over it.
+     */
+    constexpr auto remove_whitespace(std::string_view str, char* out)
+        -> size_t
+    {
+        size_t length = 0;
+        for (const char c : str) {
+            if (!is_space(c)) out[length++] = c;
+        }
+        return length;
+    }
+
+    template <typename _Traits, typename _Alloc>
+    auto remove_whitespace_inplace(std::basic_string<char, _Traits, _Alloc>& str)
+        -> std::basic_string<char, _Traits, _Alloc>&
+    {
+        str.resize(remove_whitespace(str, str.data()));
         return str;
     }
 
-    template <typename _Tp>
-    auto format_as_proper_noun(const std::basic_string<_Tp>& str)
-        -> std::basic_string<_Tp>
+    /**
+     * Each word of the string capitalized and the rest of it in lower case,
+     * where a word follows any whitespace; needs room for the string, and may
+     * write over it.
+     */
+    constexpr auto format_as_proper_noun(std::string_view str, char* out)
+        -> size_t
     {
-        if (str.empty()) return str;
-        std::basic_string<_Tp> result;
-        result.reserve(str.size());
-        result.push_back(toupper(str[0]));
-        for (size_t i = 1; i < str.size(); ++i) {
-            _Tp c = isspace(str[i-1]) ? toupper(str[i]) : tolower(str[i]);
-            result.push_back(c);
+        for (size_t i = 0; i < str.size(); ++i) {
+            const bool initial = (i == 0 || is_space(str[i - 1]));
+            out[i] = initial ? to_upper(str[i]) : to_lower(str[i]);
         }
-        return result;
+        return str.size();
     }
 
-    template <typename _Tp>
-    auto format_as_1line_proper_noun_inplace(std::basic_string<_Tp>& str)
-        -> std::basic_string<_Tp>&
+    template <typename _Traits, typename _Alloc>
+    auto format_as_proper_noun(std::string_view str,
+        std::basic_string<char, _Traits, _Alloc>& buffer)
+        -> size_t
     {
-        if (str.empty()) return str;
-        std::replace_if(str.begin(), str.end(), isspace, ' ');
-        util::trim_string_inplace(str);
-        str.erase(std::unique(str.begin(), str.end(),
-            [](_Tp a, _Tp b){ return a == ' ' && b == ' '; } ), str.end());
-        util::format_as_proper_noun_inplace(str);
+        return append_formatted(buffer, str.size(),
+            [&](char* out) { return format_as_proper_noun(str, out); });
+    }
+
+    template <typename _Traits, typename _Alloc>
+    auto format_as_proper_noun_inplace(std::basic_string<char, _Traits, _Alloc>& str)
+        -> std::basic_string<char, _Traits, _Alloc>&
+    {
+        format_as_proper_noun(str, str.data());
         return str;
     }
 
-    template <typename _Tp>
-    auto format_as_1line_proper_noun(const std::basic_string<_Tp>& str)
-        -> std::basic_string<_Tp>
+    /**
+     * The string as a proper noun on one line: runs of whitespace become one
+     * space, and leading and trailing whitespace is dropped. Needs room for
+     * the string, and may write over it.
+     */
+    constexpr auto format_as_1line_proper_noun(std::string_view str, char* out)
+        -> size_t
     {
-        if (str.empty()) return str;
-        std::basic_string<_Tp> newstr {str};
-        return format_as_1line_proper_noun_inplace(newstr);
+        size_t length = 0;
+        bool space = false;
+        for (const char c : str) {
+            if (is_space(c)) {
+                space = true;
+                continue;
+            }
+            if (space && length != 0) out[length++] = ' ';
+            out[length] = (length == 0 || out[length - 1] == ' ') ? to_upper(c) : to_lower(c);
+            length += 1;
+            space = false;
+        }
+        return length;
     }
 
-    template <typename _Tp>
-    auto format_as_phone_number_inplace(std::basic_string<_Tp>& str)
-        -> std::basic_string<_Tp>&
+    template <typename _Traits, typename _Alloc>
+    auto format_as_1line_proper_noun(std::string_view str,
+        std::basic_string<char, _Traits, _Alloc>& buffer)
+        -> size_t
     {
-        if (str.empty()) return str;
+        return append_formatted(buffer, str.size(),
+            [&](char* out) { return format_as_1line_proper_noun(str, out); });
+    }
 
-        // remove all whitespace
-        std::remove_if(str.begin(), str.end(), isspace);
+    template <typename _Traits, typename _Alloc>
+    auto format_as_1line_proper_noun_inplace(std::basic_string<char, _Traits, _Alloc>& str)
+        -> std::basic_string<char, _Traits, _Alloc>&
+    {
+        str.resize(format_as_1line_proper_noun(str, str.data()));
+        return str;
+    }
+
+    /**
+     * The length of the country calling code, with its +, at the start of a
+     * phone number without whitespace, or 0 if it has none.
+     */
+    constexpr auto phone_calling_code_length(std::string_view str)
+        -> size_t
+    {
+        if (str.size() < 3 || str[0] != '+' || !is_digit(str[1])) return 0;
 
-        // place iterator at the end of the country calling code
-        auto stritr = str.begin();
-        if (str.at(0) == '+' && str.size() >= 3)
+        // the second digits that make a three digit code, after each first digit
+        constexpr std::string_view long_codes[10] = {
+            "", "", "1234569", "578", "2", "09", "789", "", "0578", "679" };
+        const bool long_code = long_codes[str[1] - '0'].find(str[2]) != std::string_view::npos;
+        return std::min<size_t>(long_code ? 4 : 3, str.size());
+    }
+
+    namespace detail
+    {
+        // space out a phone number without whitespace, in out[0, length),
+        // working backwards so that nothing is overwritten before it is moved
+        constexpr auto space_phone_number(char* out, size_t length)
+            -> size_t
         {
-            const std::unordered_map<_Tp,std::initializer_list<_Tp>> long_callcode_map {
-                {'0', { } },
-                {'1', { } },
-                {'2', { '1', '2', '3', '4', '5', '6', '9' } },
-                {'3', { '5', '7', '8' } },
-                {'4', { '2' } },
-                {'5', { '0', '9' } },
-                {'6', { '7', '8', '9' } },
-                {'7', { } },
-                {'8', { '0', '5', '7', '8' } },
-                {'9', { '6', '7', '9' } }
-            };
-            if (util::multi_compare_or(str.at(2),
-                long_callcode_map.at(str.at(1)) ))
-            {
-                stritr += 4;
-            } else {
-                stritr += 3;
+            // a space after the calling code and another after the next five
+            // digits, or one after the first six digits without a code
+            const size_t code = phone_calling_code_length({out, length});
+            const size_t group = (code != 0) ? code + 5 : 6;
+            size_t spaces[2] = {};
+            size_t count = 0;
+            if (code != 0 && code < length) spaces[count++] = code;
+            if (group < length) spaces[count++] = group;
+
+            const size_t spaced = length + count;
+            for (size_t i = length, end = spaced; count != 0; --count) {
+                while (i > spaces[count - 1]) out[--end] = out[--i];
+                out[--end] = ' ';
             }
+            return spaced;
         }
+    }
 
-        // Insert spaces where formatting requires
-        if (stritr != str.begin()) {
-            str.insert(stritr, ' ');
-        }
-        if (stritr + 6 < str.end()) {
-            stritr += 6;
-            str.insert(stritr, ' ');
-        }
+    /**
+     * A phone number without whitespace, with a space after its country
+     * calling code, if it has one, and after the five digits that follow it.
+     * Without a calling code, the space is after the first six digits. Needs
+     * room for the string and two more characters, and may write over it.
+     */
+    constexpr auto format_as_phone_number(std::string_view str, char* out)
+        -> size_t
+    {
+        return detail::space_phone_number(out, remove_whitespace(str, out));
+    }
+
+    template <typename _Traits, typename _Alloc>
+    auto format_as_phone_number(std::string_view str,
+        std::basic_string<char, _Traits, _Alloc>& buffer)
+        -> size_t
+    {
+        return append_formatted(buffer, str.size() + 2,
+            [&](char* out) { return format_as_phone_number(str, out); });
+    }
 
+    template <typename _Traits, typename _Alloc>
+    auto format_as_phone_number_inplace(std::basic_string<char, _Traits, _Alloc>& str)
+        -> std::basic_string<char, _Traits, _Alloc>&
+    {
+        // the spaces only need room past the end once whitespace is removed
+        const size_t length = remove_whitespace(str, str.data());
+        str.resize(length + 2);
+        str.resize(detail::space_phone_number(str.data(), length));
         return str;
     }
 
+    /*
+     * The formatters are constexpr, so these cases are checked whenever the
+     * header is compiled: each formats the input to a fresh buffer, and then
+     * over the input itself where the formatter allows it.
+     */
+    namespace detail
+    {
+        using Formatter = size_t(*)(std::string_view, char*);
+
+        constexpr auto formats_as(Formatter format, std::string_view input,
+            std::string_view expected, bool inplace = true)
+            -> bool
+        {
+            char out[64]{};
+            if (std::string_view{out, format(input, out)} != expected) return false;
+            if (!inplace) return true;
+            char buffer[64]{};
+            std::copy(input.begin(), input.end(), buffer);
+            return std::string_view{buffer, format({buffer, input.size()}, buffer)} == expected;
+        }
+
+        static_assert(is_number("0123") && is_number("") && !is_number("12a"));
+        static_assert(trim_string("  a b  ") == "a b" && trim_string("   ").empty());
+
+        static_assert(formats_as([](std::string_view str, char* out) {
+            return pad_string(str, 4, out, '.'); }, "ab", "ab..", false));
+        static_assert(formats_as([](std::string_view str, char* out) {
+            return pad_string(str, 4, out); }, "abcdef", "abcdef", false));
+        static_assert(formats_as([](std::string_view str, char* out) {
+            return repeat_string(str, 3, out); }, "\u2500", "\u2500\u2500\u2500", false));
+        static_assert(formats_as([](std::string_view str, char* out) {
+            return repeat_string(str, 0, out); }, "ab", "", false));
+
+        static_assert(formats_as(remove_whitespace, " a\tb\r\nc ", "abc"));
+        static_assert(formats_as(format_as_proper_noun, "hELLO wORLD", "Hello World"));
+        static_assert(formats_as(format_as_proper_noun, "o'neil\tmCdONALD", "O'neil\tMcdonald"));
+        static_assert(formats_as(format_as_1line_proper_noun, "  jOHN \t\n smith  ", "John Smith"));
+        static_assert(formats_as(format_as_1line_proper_noun, " \t ", ""));
+        static_assert(formats_as(format_as_1line_proper_noun, "\xc3\xa9mile zOLA", "\xc3\xa9mile Zola"));
+
+        static_assert(formats_as(format_as_phone_number, "+44 7700 900123", "+44 77009 00123"));
+        static_assert(formats_as(format_as_phone_number, "+353 87 123 4567", "+353 87123 4567"));
+        static_assert(formats_as(format_as_phone_number, "+4477009", "+44 77009"));
+        static_assert(formats_as(format_as_phone_number, "+4477", "+44 77"));
+        static_assert(formats_as(format_as_phone_number, "0412 345 678", "041234 5678"));
+        static_assert(formats_as(format_as_phone_number, "123456", "123456"));
+        static_assert(formats_as(format_as_phone_number, "+12", "+12"));
+        static_assert(formats_as(format_as_phone_number, "+(1)5", "+(1)5"));
+        static_assert(formats_as(format_as_phone_number, "", ""));
+    }
+
 }
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace util
+{
+
+    /**
+     * Counts the outstanding tasks submitted to a ThreadPool as one group, so
+     * that they can be waited on together, and keeps the first exception any
+     * of them threw.
+     */
+    class TaskGroup
+    {
+        friend class ThreadPool;
+
+    public:
+        inline auto done() const { return m_Remaining.load() == 0; }
+
+    private:
+        void fail(std::exception_ptr error)
+        {
+            std::lock_guard lock{m_ErrorMutex};
+            if (!m_Error) m_Error = std::move(error);
+        }
+
+        std::atomic<size_t> m_Remaining{};
+        std::mutex m_ErrorMutex{};
+        std::exception_ptr m_Error{};
+    };
+
+    /**
+     * A work-stealing pool of worker threads. Each worker owns a deque of
+     * tasks: tasks submitted from a worker go to the front of its own deque
+     * and are run newest first, while idle workers steal the oldest tasks
+     * from the back of other deques. Tasks may submit and wait on subtasks.
+     * Tasks submitted without a group must not throw. Destroying the pool
+     * waits for every queued task to finish.
+     */
+    class ThreadPool
+    {
+    public:
+        using Task = std::function<void()>;
+
+        explicit ThreadPool(size_t nthreads = std::thread::hardware_concurrency())
+        {
+            nthreads = std::max<size_t>(nthreads, 1);
+            for (size_t i = 0; i < nthreads; ++i) {
+                m_Queues.push_back(std::make_unique<Queue>());
+            }
+            m_Workers.reserve(nthreads);
+            for (size_t i = 0; i < nthreads; ++i) {
+                m_Workers.emplace_back([this, i]() { run(i); });
+            }
+        }
+
+        ~ThreadPool()
+        {
+            {
+                std::lock_guard lock{m_SleepMutex};
+                m_Stopping = true;
+            }
+            m_Wakeup.notify_all();
+            for (auto& worker : m_Workers) worker.join();
+        }
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        inline auto size() const { return m_Workers.size(); }
+
+        void submit(Task task)
+        {
+            push(Entry{std::move(task), nullptr});
+        }
+
+        void submit(TaskGroup& group, Task task)
+        {
+            group.m_Remaining += 1;
+            push(Entry{[&group, task = std::move(task)]() {
+                try {
+                    task();
+                } catch (...) {
+                    group.fail(std::current_exception());
+                }
+                group.m_Remaining -= 1;
+            }, &group});
+        }
+
+        /**
+         * Run queued tasks of the group on the calling thread until every
+         * task of the group has finished, then rethrow the first exception
+         * any of them threw. Tasks of other groups are left to the workers,
+         * so that a wait never runs unrelated work.
+         */
+        void wait(TaskGroup& group)
+        {
+            while (!group.done()) {
+                if (!try_run(current_index(), &group)) std::this_thread::yield();
+            }
+            std::lock_guard lock{group.m_ErrorMutex};
+            if (group.m_Error) std::rethrow_exception(std::exchange(group.m_Error, nullptr));
+        }
+
+    private:
+        struct Entry
+        {
+            Task Run{};
+            const TaskGroup* Group{nullptr};
+        };
+
+        struct Queue
+        {
+            std::deque<Entry> Tasks{};
+            std::mutex Mutex{};
+        };
+
+        // the pool and worker index of the calling thread, if it is a worker
+        static inline thread_local const ThreadPool* t_Pool{nullptr};
+        static inline thread_local size_t t_Index{0};
+
+        auto current_index() const -> size_t
+        {
+            return (t_Pool == this) ? t_Index : m_NextQueue.load() % m_Queues.size();
+        }
+
+        void push(Entry entry)
+        {
+            const size_t index = (t_Pool == this) ? t_Index : m_NextQueue++ % m_Queues.size();
+            {
+                std::lock_guard lock{m_SleepMutex};
+                m_Pending += 1;
+            }
+            {
+                auto& queue = *m_Queues[index];
+                std::lock_guard lock{queue.Mutex};
+                queue.Tasks.push_front(std::move(entry));
+            }
+            m_Wakeup.notify_one();
+        }
+
+        // pop the newest task of a deque, or steal its oldest; given a group,
+        // only a task of that group
+        auto try_pop(size_t index, bool steal, const TaskGroup* group, Task& task) -> bool
+        {
+            auto& queue = *m_Queues[index];
+            std::lock_guard lock{queue.Mutex};
+            const auto matches = [group](const Entry& entry) { return !group || entry.Group == group; };
+            auto itr = queue.Tasks.end();
+            if (steal) {
+                const auto found = std::find_if(queue.Tasks.rbegin(), queue.Tasks.rend(), matches);
+                if (found != queue.Tasks.rend()) itr = std::prev(found.base());
+            } else {
+                itr = std::find_if(queue.Tasks.begin(), queue.Tasks.end(), matches);
+            }
+            if (itr == queue.Tasks.end()) return false;
+            task = std::move(itr->Run);
+            queue.Tasks.erase(itr);
+            return true;
+        }
+
+        auto try_run(size_t self, const TaskGroup* group = nullptr) -> bool
+        {
+            Task task;
+            bool found = try_pop(self, false, group, task);
+            for (size_t k = 1; !found && k < m_Queues.size(); ++k) {
+                found = try_pop((self + k) % m_Queues.size(), true, group, task);
+            }
+            if (!found) return false;
+            {
+                std::lock_guard lock{m_SleepMutex};
+                m_Pending -= 1;
+            }
+            task();
+            return true;
+        }
+
+        void run(size_t index)
+        {
+            t_Pool = this;
+            t_Index = index;
+            for (;;) {
+                if (try_run(index)) continue;
+                std::unique_lock lock{m_SleepMutex};
+                m_Wakeup.wait(lock, [this]() { return m_Stopping || m_Pending > 0; });
+                if (m_Stopping && m_Pending == 0) return;
+            }
+        }
+
+        std::vector<std::unique_ptr<Queue>> m_Queues{};
+        std::vector<std::thread> m_Workers{};
+        std::atomic<size_t> m_NextQueue{};
+
+        std::mutex m_SleepMutex{};
+        std::condition_variable m_Wakeup{};
+        size_t m_Pending{};
+        bool m_Stopping{false};
+    };
+
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+namespace util
+{
+
+    /**
+     * Decode the UTF-8 code point starting at str[pos], advancing pos past it.
+     * Invalid or truncated sequences decode as a single byte.
+     */
+    inline auto utf8_decode(std::string_view str, size_t& pos)
+        -> char32_t
+    {
+        const auto byte = [&](size_t i) { return static_cast<uint8_t>(str[i]); };
+        const uint8_t lead = byte(pos);
+        size_t length = (lead < 0x80) ? 1
+            : ((lead >> 5) == 0x6) ? 2
+            : ((lead >> 4) == 0xE) ? 3
+            : ((lead >> 3) == 0x1E) ? 4 : 1;
+        if (pos + length > str.size()) length = 1;
+
+        char32_t cp = (length == 1) ? lead
+            : (length == 2) ? (lead & 0x1F)
+            : (length == 3) ? (lead & 0x0F) : (lead & 0x07);
+        for (size_t i = 1; i < length; ++i) {
+            if ((byte(pos + i) & 0xC0) != 0x80) { length = 1; cp = lead; break; }
+            cp = (cp << 6) | (byte(pos + i) & 0x3F);
+        }
+        pos += length;
+        return cp;
+    }
+
+    /**
+     * The number of terminal columns a code point occupies: 0 for combining
+     * marks and control characters, 2 for East Asian wide and emoji, else 1.
+     */
+    constexpr auto codepoint_width(char32_t cp)
+        -> size_t
+    {
+        if (cp == 0 || cp < 0x20 || (cp >= 0x7F && cp < 0xA0)) return 0;
+        if ((cp >= 0x0300 && cp <= 0x036F) || (cp >= 0x1AB0 && cp <= 0x1AFF)
+            || (cp >= 0x1DC0 && cp <= 0x1DFF) || (cp >= 0x20D0 && cp <= 0x20FF)
+            || (cp >= 0xFE20 && cp <= 0xFE2F) || cp == 0x200B || cp == 0x200D
+            || (cp >= 0xFE00 && cp <= 0xFE0F))
+        {
+            return 0;
+        }
+        if ((cp >= 0x1100 && cp <= 0x115F) || (cp >= 0x2E80 && cp <= 0x303E)
+            || (cp >= 0x3041 && cp <= 0x33FF) || (cp >= 0x3400 && cp <= 0x4DBF)
+            || (cp >= 0x4E00 && cp <= 0x9FFF) || (cp >= 0xA000 && cp <= 0xA4CF)
+            || (cp >= 0xAC00 && cp <= 0xD7A3) || (cp >= 0xF900 && cp <= 0xFAFF)
+            || (cp >= 0xFE30 && cp <= 0xFE4F) || (cp >= 0xFF00 && cp <= 0xFF60)
+            || (cp >= 0xFFE0 && cp <= 0xFFE6) || (cp >= 0x1F300 && cp <= 0x1F64F)
+            || (cp >= 0x1F900 && cp <= 0x1F9FF) || (cp >= 0x20000 && cp <= 0x3FFFD))
+        {
+            return 2;
+        }
+        return 1;
+    }
+
+    /**
+     * The number of terminal columns a UTF-8 string occupies.
+     */
+    inline auto display_width(std::string_view str)
+        -> size_t
+    {
+        size_t width = 0;
+        for (size_t pos = 0; pos < str.size(); ) {
+            width += codepoint_width(utf8_decode(str, pos));
+        }
+        return width;
+    }
+
+    /**
+     * The byte length of the longest prefix of a UTF-8 string that fits
+     * within the given number of terminal columns.
+     */
+    inline auto display_prefix(std::string_view str, size_t width)
+        -> size_t
+    {
+        size_t used = 0;
+        size_t pos = 0;
+        while (pos < str.size()) {
+            size_t next = pos;
+            const size_t cp_width = codepoint_width(utf8_decode(str, next));
+            if (used + cp_width > width) break;
+            used += cp_width;
+            pos = next;
+        }
+        return pos;
+    }
+
+}